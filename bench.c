@@ -0,0 +1,527 @@
+/* bench.c
+ *
+ * Description:
+ * Benchmark of the coil generator library (libs/CoilGen). It sweeps the resolution, the turns,
+ * the layers and the count of the coils around a base coil for each generation mode (uniform steps,
+ * adaptive steps and arcs) and measures every configuration twice: generating the items only
+ * (points/s, segments/s) and generating them with the KiCAD records written into a file, the same
+ * way coil.c does (MB/s). Every configuration runs in its own process, so its peak memory is its own.
+ * The field map (coilField) of the base coil is measured on square grids of points: the points are
+ * the points of the grid, the segments are the current elements times the points (Biot-Savart pairs)
+ * and the MB/s are the ones of the CSV of the map (coilFieldFormat).
+ * The results are written as a table with one line per configuration, which can be compared with the
+ * results of another version to catch performance regressions (make bench).
+ *
+ * Parameters:
+ *  -   -o:         Determines the file address to write the results into
+ *  -   -c:         Determines the results of another version to compare with
+ *  -   -r:         Determines the minimum number of runs of each configuration (the fastest is kept, at least 5 with -c)
+ *  -   -j:         Determines the number of threads generating the layers
+ *  -   -m:         Determines the generation modes to run (uniform, adaptive, arcs, field or all)
+ */
+
+
+/* --- IMPORTS --- */
+#define _XOPEN_SOURCE 700       // getrusage and fork with -std=c99
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "./libs/CoilGen/coilGen.h"
+/* --- End of IMPORTS --- */
+
+/* --- DEFINITIONS --- */
+#define WRITER_SIZE (1<<20) // Size of the output buffer, flushed into the file in blocks of this size
+#define REGRESSION 0.10     // Slowdown reported as a regression by the comparison (10%)
+#define MIN_TIME 0.2        // Minimum time of a measurement, short configurations run more often (seconds)
+#define COMPARE_RUNS 5      // Fewest runs of a comparison, the fastest of fewer runs is mostly noise
+#define RUNS_KEPT 256       // Times of the runs kept for the noise of a measurement
+
+/* Config
+ * A single configuration of the benchmark.
+ */
+typedef struct {
+    char name[64];          // Name of the configuration (mode/resolution/turns/layers/count)
+    double resolution;      // Resolution of the uniform steps
+    double turns;           // Amount of turns around the center
+    int layers;             // Amount of copper layers
+    int count;              // Number of coils
+    int mode;               // Generation mode (0 uniform, 1 adaptive, 2 arcs, 3 field map)
+    int grid;               // Points on each side of the grid of the field map
+} Config;
+
+/* Measure
+ * Results of a configuration, sent by the process running it.
+ */
+typedef struct {
+    long points;            // Points on the layers
+    long segments;          // Wire segments and arcs generated
+    size_t bytes;           // Bytes written into the file
+    double timeGenerate;    // Time of the generation without writing (seconds)
+    double timeWrite;       // Time of the generation with the records written (seconds)
+    long peakMemory;        // Peak resident memory of the process (KiB)
+    double noise;           // Spread of the runs: the median time over the fastest one, minus 1
+    int error;              // Set when the configuration failed
+} Measure;
+/* --- End of DEFINITIONS --- */
+
+/* --- FUNCTIONS --- */
+
+/* countWrite
+ * Sink of the generation without writing, the items are only counted.
+ *
+ * Parameters:
+ *  -   context:    Number of items
+ *  -   unit:       Items of the unit
+ */
+static int countWrite(void *context, const CoilUnit *unit) {
+    *(long *)context += unit->count;
+    return 0;
+}
+
+/* fileWrite
+ * Sink of the generation with the records written: appends the records of a unit to the
+ * output buffer of the file, like the sink of coil.c.
+ *
+ * Parameters:
+ *  -   context:    Output buffer of the file
+ *  -   unit:       Items of the unit with their records
+ */
+static int fileWrite(void *context, const CoilUnit *unit) {
+    CoilWriter *writer = context;
+    coilWriterAppend(writer, unit->text);
+    return writer->error;
+}
+
+/* timeCompare
+ * Orders the times of the runs, fastest first (qsort).
+ *
+ * Parameters:
+ *  -   a, b:       Times to compare
+ */
+static int timeCompare(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* timesSpread
+ * Spread of the runs of a measurement: how much slower the median run is than the fastest one.
+ * A change of the rates within the spread of the runs can not be told from noise.
+ * Returns the spread as a fraction of the fastest time.
+ *
+ * Parameters:
+ *  -   times:      Times of the runs (sorted in place)
+ *  -   count:      Number of runs
+ */
+static double timesSpread(double *times, int count) {
+    qsort(times, count, sizeof(double), timeCompare);
+    return count > 0 && times[0] > 0 ? times[count/2] / times[0] - 1 : 0;
+}
+
+/* fieldRun
+ * Measures the field map of a configuration: the fastest of the runs of coilField on a square
+ * grid of points over the coil, 1 above the front layer, and the fastest of the runs writing the
+ * map as CSV into a temporary file.
+ *
+ * Parameters:
+ *  -   params:     Parameters of the coils
+ *  -   config:     Configuration to measure
+ *  -   runs:       Number of runs of each measurement
+ *  -   measure:    Returned results
+ */
+static void fieldRun(const CoilParams *params, const Config *config, int runs, Measure *measure) {
+    CoilBuffers buffers = {NULL, 0};
+    CoilStats stats;
+    CoilList list = {NULL, 0, 0};
+    CoilSink sink = {&list, NULL, coilListWrite};
+    measure->error = coilGenerate(params, &sink, &buffers, &stats);
+
+    // Grid over the whole coil
+    double radius = stats.outerRadius;
+    double step = config->grid > 1 ? 2*radius/(config->grid - 1) : 0;
+    CoilGrid grid = {{params->startX - radius, params->startY - radius, 1}, {step, step, 0}, {config->grid, config->grid, 1}};
+    double current = 1;
+    CoilField field = {0, NULL, 0, 0};
+    coilStatsFree(&stats);
+    coilBuffersFree(&buffers);
+
+    double total = 0, times[RUNS_KEPT];
+    int kept = 0;
+    for (int r = 0; (r < runs || total < MIN_TIME) && !measure->error; r++) {
+        coilFieldFree(&field);
+        measure->error = coilField(list.items, list.count, params->layers, 1.6, &current, 1, &grid, params->threads, &field);
+        total += field.time;
+        kept < RUNS_KEPT ? times[kept++] = field.time : 0;
+
+        if (r == 0 || field.time < measure->timeGenerate) {
+            measure->timeGenerate = field.time;
+        }
+        measure->points = field.points;
+        measure->segments = field.elements * field.points;
+    }
+    measure->noise = timesSpread(times, kept);
+
+    // Field map written as CSV into a file
+    char file[] = "/tmp/coil_bench_XXXXXX";
+    int fd = mkstemp(file);
+    FILE *fp = fd >= 0 ? fdopen(fd, "w") : NULL;
+    char *buffer = malloc(WRITER_SIZE);
+    fp == NULL || buffer == NULL ? measure->error = 1 : 0;
+    fp != NULL ? setvbuf(fp, NULL, _IONBF, 0) : 0;
+
+    total = 0;
+    kept = 0;
+    for (int r = 0; (r < runs || total < MIN_TIME) && !measure->error; r++) {
+        rewind(fp);
+        CoilWriter writer = {fp, buffer, WRITER_SIZE, 0, 0, params->precision, params->trimZeros, 0, 0};
+        double begin = coilNow();
+        coilFieldFormat(&writer, &grid, &field);
+        coilWriterFlush(&writer);
+        double time = coilNow() - begin;
+        total += time;
+        kept < RUNS_KEPT ? times[kept++] = time : 0;
+
+        if (r == 0 || time < measure->timeWrite) {
+            measure->timeWrite = time;
+        }
+        measure->bytes = writer.written;
+        writer.error ? measure->error = 1 : 0;
+    }
+
+    measure->noise = fmax(measure->noise, timesSpread(times, kept));
+
+    fp != NULL ? fclose(fp) : 0;
+    fd >= 0 ? remove(file) : 0;
+    free(buffer);
+    coilFieldFree(&field);
+    free(list.items);
+}
+
+/* configRun
+ * Measures a configuration: the fastest of the runs generating the items only and the fastest
+ * of the runs writing the records into a temporary file. Each measurement runs at least the given
+ * number of times and at least for MIN_TIME, so short configurations are not only noise.
+ *
+ * Parameters:
+ *  -   config:     Configuration to measure
+ *  -   runs:       Number of runs of each measurement
+ *  -   threads:    Number of threads generating the layers
+ *  -   measure:    Returned results
+ */
+static void configRun(const Config *config, int runs, int threads, Measure *measure) {
+    CoilParams params;
+    coilDefaults(&params);
+    params.resolution = config->resolution;
+    params.turns = config->turns;
+    params.layers = config->layers;
+    params.count = config->count;
+    params.threads = threads;
+    config->mode == 1 ? params.tolerance = 0.001 : 0;
+    config->mode == 2 ? params.arcTolerance = 0.001 : 0;
+
+    memset(measure, 0, sizeof(Measure));
+    CoilBuffers buffers = {NULL, 0};
+    CoilStats stats;
+
+    // Field map of the coil instead of the generation
+    if (config->mode == 3) fieldRun(&params, config, runs, measure);
+
+    // Generation of the items only
+    double total = 0, times[RUNS_KEPT];
+    int kept = 0;
+    for (int r = 0; (r < runs || total < MIN_TIME) && !measure->error && config->mode != 3; r++) {
+        long items = 0;
+        CoilSink sink = {&items, NULL, countWrite};
+        double begin = coilNow();
+        measure->error = coilGenerate(&params, &sink, &buffers, &stats);
+        double time = coilNow() - begin;
+        total += time;
+        kept < RUNS_KEPT ? times[kept++] = time : 0;
+
+        if (r == 0 || time < measure->timeGenerate) {
+            measure->timeGenerate = time;
+        }
+        measure->points = 0;
+        for (int i = 0; i < config->layers; i++) {
+            measure->points += stats.layerPoints[i];
+        }
+        measure->segments = stats.segments + stats.arcs;
+        coilStatsFree(&stats);
+    }
+    config->mode != 3 ? measure->noise = timesSpread(times, kept) : 0;
+
+    // Generation with the records written into a file
+    char file[] = "/tmp/coil_bench_XXXXXX";
+    int fd = mkstemp(file);
+    FILE *fp = fd >= 0 ? fdopen(fd, "w") : NULL;
+    char *buffer = malloc(WRITER_SIZE);
+    fp == NULL || buffer == NULL ? measure->error = 1 : 0;
+    fp != NULL ? setvbuf(fp, NULL, _IONBF, 0) : 0;
+
+    total = 0;
+    kept = 0;
+    for (int r = 0; (r < runs || total < MIN_TIME) && !measure->error && config->mode != 3; r++) {
+        rewind(fp);
+        CoilWriter writer = {fp, buffer, WRITER_SIZE, 0, 0, params.precision, params.trimZeros, 0, 0};
+        CoilSink sink = {&writer, coilKicadFormat, fileWrite};
+        double begin = coilNow();
+        measure->error = coilGenerate(&params, &sink, &buffers, &stats);
+        coilWriterFlush(&writer);
+        double time = coilNow() - begin;
+        total += time;
+        kept < RUNS_KEPT ? times[kept++] = time : 0;
+
+        if (r == 0 || time < measure->timeWrite) {
+            measure->timeWrite = time;
+        }
+        measure->bytes = writer.written;
+        writer.error ? measure->error = 1 : 0;
+        coilStatsFree(&stats);
+    }
+    config->mode != 3 ? measure->noise = fmax(measure->noise, timesSpread(times, kept)) : 0;
+
+    fp != NULL ? fclose(fp) : 0;
+    fd >= 0 ? remove(file) : 0;
+    free(buffer);
+    coilBuffersFree(&buffers);
+
+    // Peak resident memory of this process (KiB)
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    measure->peakMemory = usage.ru_maxrss / 1024;   // Bytes on macOS
+#else
+    measure->peakMemory = usage.ru_maxrss;          // KiB on Linux
+#endif
+}
+
+/* configMeasure
+ * Runs a configuration in its own process, so the peak memory is the one of the configuration only.
+ * Returns 1 when the process could not be run.
+ *
+ * Parameters:
+ *  -   config:     Configuration to measure
+ *  -   runs:       Number of runs of each measurement
+ *  -   threads:    Number of threads generating the layers
+ *  -   measure:    Returned results
+ */
+static int configMeasure(const Config *config, int runs, int threads, Measure *measure) {
+    int channel[2];
+    if (pipe(channel)) {
+        return 1;
+    }
+
+    pid_t child = fork();
+    if (child == 0) {
+        // Process of the configuration, sends its results back
+        close(channel[0]);
+        configRun(config, runs, threads, measure);
+        _exit(write(channel[1], measure, sizeof(Measure)) == sizeof(Measure) ? 0 : 1);
+    }
+
+    close(channel[1]);
+    int received = child > 0 && read(channel[0], measure, sizeof(Measure)) == sizeof(Measure);
+    close(channel[0]);
+    child > 0 ? waitpid(child, NULL, 0) : 0;
+
+    return !received;
+}
+
+/* resultsCompare
+ * Compares the results with the results of another version, configuration by configuration,
+ * and prints the change of each rate. Slowdowns over REGRESSION plus the noise of the runs of both
+ * versions are marked as regressions, results without the noise column count as without noise.
+ * Returns the number of regressions.
+ *
+ * Parameters:
+ *  -   file:       Results of the other version (-o of bench)
+ *  -   configs:    Configurations of this run
+ *  -   measures:   Results of this run
+ *  -   total:      Number of configurations
+ */
+static int resultsCompare(const char *file, const Config *configs, const Measure *measures, int total) {
+    FILE *fp = fopen(file, "r");
+    if (fp == NULL) {
+        printf("Error opening the results to compare with!\n\r");
+        return 0;
+    }
+
+    int regressions = 0, compared = 0;
+    char line[512], name[64];
+    double pointsRate, segmentsRate, writeRate, noise;
+
+    printf("\n --- Compared with %s --- \n", file);
+    printf("%-28s %10s %10s %10s\n", "configuration", "points/s", "segments/s", "MB/s");
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        // Skip the header and the lines of another format
+        noise = 0;
+        if (line[0] == '#' || sscanf(line, "%63s %*s %*s %*s %*s %*s %lf %lf %lf %*s %lf", name, &pointsRate, &segmentsRate, &writeRate, &noise) < 4) {
+            continue;
+        }
+
+        for (int c = 0; c < total; c++) {
+            if (strcmp(configs[c].name, name) || measures[c].error) {
+                continue;
+            }
+
+            // Change of each rate (positive is faster)
+            const Measure *m = &measures[c];
+            double changes[3] = {m->points / m->timeGenerate / pointsRate - 1, m->segments / m->timeGenerate / segmentsRate - 1, m->bytes / m->timeWrite / 1e6 / writeRate - 1};
+            double threshold = REGRESSION + m->noise + noise;
+            int regression = changes[0] < -threshold || changes[1] < -threshold || changes[2] < -threshold;
+            printf("%-28s %+9.1f%% %+9.1f%% %+9.1f%%%s\n", name, 100*changes[0], 100*changes[1], 100*changes[2], regression ? "  REGRESSION" : "");
+            regressions += regression;
+            compared++;
+        }
+    }
+    fclose(fp);
+
+    printf(" --------------------------- \n");
+    printf("%d configurations compared, %d regressions (slower than %.0f%% plus the noise of the runs)\n\r", compared, regressions, 100*REGRESSION);
+    return regressions;
+}
+/* --- End of FUNCTIONS --- */
+
+/* --- MAIN --- */
+int main(int argc, char *argv[]) {
+
+    /* --- FAILSAFE --- */
+    // Check if correct amount of arguments entered
+    if (argc % 2 == 0) {
+        printf("Usage: %s flags parameters\n\r", argv[0]);
+        printf(" --------------------------------------------- \n");
+        printf("\t-o results\t(Default ./bench_output.txt)\n\t-c results\t(Default none, compare with other results)\n\t-r runs\t\t(Default 3, 5 with -c, fastest kept)\n\t-j threads\t(Default 1, 0 uses all cores)\n\t-m mode\t\t(Default all, uniform, adaptive, arcs or field)\n\r");
+        printf(" --------------------------------------------- \n");
+        return 1;
+    }
+    /* --- End of FAILSAFE --- */
+
+    /* --- CONSTANTS --- */
+    char* output = "./bench_output.txt";    // Results of this run
+    char* compare = NULL;           // Default (none) results of another version
+    int runs = 0;                   // Default (3, 5 with -c) runs of each configuration
+    int threads = 1;                // Default (1) generates serially
+    int modes = 15;                 // Default (15) all modes, bit per mode
+    /* --- End of CONSTANTS --- */
+
+    /* --- ARGUMENTS --- */
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i],"-o")) {
+            output = argv[i+1];                                         // Update the results file
+        } else if (!strcmp(argv[i],"-c")) {
+            compare = argv[i+1];                                        // Update the results to compare with
+        } else if (!strcmp(argv[i],"-r")) {
+            runs = atoi(argv[i+1]);                                     // Update the runs
+            runs < 1 ? runs = 1 : runs;                                 // Failsafe for runs
+        } else if (!strcmp(argv[i],"-j")) {
+            threads = atoi(argv[i+1]);                                  // Update the threads
+            threads < 1 ? threads = sysconf(_SC_NPROCESSORS_ONLN) : threads;   // All cores Failsafe
+            threads < 1 ? threads = 1 : threads;                        // Lower Boundary Failsafe
+        } else if (!strcmp(argv[i],"-m")) {
+            modes = !strcmp(argv[i+1],"uniform") ? 1 : (!strcmp(argv[i+1],"adaptive") ? 2 : (!strcmp(argv[i+1],"arcs") ? 4 : (!strcmp(argv[i+1],"field") ? 8 : 15)));   // Update the modes
+        }
+    }
+
+    // A comparison needs enough runs to keep the noise out of the regressions
+    runs == 0 ? runs = (compare != NULL ? COMPARE_RUNS : 3) : runs;
+    if (compare != NULL && runs < COMPARE_RUNS) {
+        printf("Error: comparing results needs at least %d runs (-r)!\n\r", COMPARE_RUNS);
+        return 1;
+    }
+    /* --- End of ARGUMENTS --- */
+
+    /* --- CONFIGURATIONS --- */
+    /* Each parameter is swept on its own around the base coil (resolution 0.01, 20 turns,
+     * 2 layers, 1 coil), for each of the generation modes. The resolution only changes the
+     * uniform steps, so it is only swept for them. The field map of the base coil is measured
+     * on grids of growing size.
+     */
+    static const char *modeNames[4] = {"uniform", "adaptive", "arcs", "field"};
+    static const double resolutions[] = {0.01, 0.02, 0.05, 0.1};
+    static const double turnCounts[] = {10, 50, 100};
+    static const int layerCounts[] = {1, 4, 8};
+    static const int coilCounts[] = {4, 8};
+    static const int gridSides[] = {32, 100};
+
+    Config configs[64];
+    int total = 0;
+    for (int mode = 0; mode < 3; mode++) {
+        if (!(modes & (1 << mode))) {
+            continue;
+        }
+
+        Config base = {"", 0.01, 20, 2, 1, mode, 0};
+        for (int n = 0; n < 4 && mode == 0; n++) {
+            configs[total] = base;
+            configs[total++].resolution = resolutions[n];
+        }
+        if (mode != 0) {
+            configs[total++] = base;
+        }
+        for (int n = 0; n < 3; n++) {
+            configs[total] = base;
+            configs[total++].turns = turnCounts[n];
+        }
+        for (int n = 0; n < 3; n++) {
+            configs[total] = base;
+            configs[total++].layers = layerCounts[n];
+        }
+        for (int n = 0; n < 2; n++) {
+            configs[total] = base;
+            configs[total++].count = coilCounts[n];
+        }
+    }
+    for (int n = 0; n < 2 && (modes & 8); n++) {
+        Config field = {"", 0.01, 20, 2, 1, 3, gridSides[n]};
+        configs[total++] = field;
+    }
+    for (int c = 0; c < total; c++) {
+        Config *config = &configs[c];
+        int length = snprintf(config->name, sizeof(config->name), "%s/p%g/t%g/l%d/c%d", modeNames[config->mode], config->resolution, config->turns, config->layers, config->count);
+        config->grid ? snprintf(config->name + length, sizeof(config->name) - length, "/g%d", config->grid) : 0;
+    }
+    /* --- End of CONFIGURATIONS --- */
+
+    /* --- MEASURE --- */
+    FILE *fp = fopen(output, "w");
+    if (fp == NULL) {
+        printf("Error opening the results file!\n\r");
+        return 1;
+    }
+
+    Measure measures[64];
+    int failed = 0;
+    const char *header = "# configuration\tpoints\tsegments\tbytes\tgenerate_s\twrite_s\tpoints/s\tsegments/s\tMB/s\tpeakMemoryKiB\tnoise\n";
+    fputs(header, fp);
+    printf("\n --- Benchmark: %d configurations, %d runs, %d threads --- \n", total, runs, threads);
+    printf("%-28s %10s %12s %12s %8s %10s\n", "configuration", "points", "points/s", "segments/s", "MB/s", "peak KiB");
+
+    for (int c = 0; c < total; c++) {
+        Measure *m = &measures[c];
+        if (configMeasure(&configs[c], runs, threads, m) || m->error) {
+            m->error = 1;
+            failed++;
+            printf("%-28s FAILED\n", configs[c].name);
+            continue;
+        }
+
+        double pointsRate = m->points / m->timeGenerate, segmentsRate = m->segments / m->timeGenerate, writeRate = m->bytes / m->timeWrite / 1e6;
+        printf("%-28s %10ld %12.0f %12.0f %8.1f %10ld\n", configs[c].name, m->points, pointsRate, segmentsRate, writeRate, m->peakMemory);
+        fprintf(fp, "%s\t%ld\t%ld\t%zu\t%.6f\t%.6f\t%.0f\t%.0f\t%.3f\t%ld\t%.3f\n", configs[c].name, m->points, m->segments, m->bytes, m->timeGenerate, m->timeWrite, pointsRate, segmentsRate, writeRate, m->peakMemory, m->noise);
+        fflush(stdout);
+    }
+    fclose(fp);
+
+    printf(" --------------------------- \n");
+    printf("Results written into %s, %d failed\n\r", output, failed);
+    /* --- End of MEASURE --- */
+
+    // Compare with the results of another version
+    int regressions = compare != NULL ? resultsCompare(compare, configs, measures, total) : 0;
+
+    return failed || regressions ? 1 : 0;
+}
+/* --- End of MAIN --- */
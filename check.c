@@ -0,0 +1,154 @@
+/* check.c
+ *
+ * Description:
+ * Checks of the coil generator library (libs/CoilGen). The same coils are generated with uniform
+ * steps, adaptive steps (-e) and arcs (-a) and their clearance is checked (coilClearance): every
+ * mode has to report the same violations as the uniform steps, with the same smallest clearance
+ * at the same place, however finely the tracks are split. The coils whose turns are further apart
+ * than the clearance must not report any violation: the vias and the tracks they sit on are the
+ * same copper. Prints one line per check and returns 1 when any of them fails (make check).
+ */
+
+
+/* --- IMPORTS --- */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include "./libs/CoilGen/coilGen.h"
+/* --- End of IMPORTS --- */
+
+/* --- DEFINITIONS --- */
+#define MODE_TOLERANCE 0.001    // Deviation of the adaptive steps and the arcs from the spiral
+#define LOCATION 0.05           // Distance between the places of the same violation in two modes
+#define LISTED 256              // Violations listed by each check
+
+/* Config
+ * A single coil of the checks.
+ */
+typedef struct {
+    char name[32];          // Name of the coil
+    double turns;           // Amount of turns around the center (0 default)
+    double spacing;         // Spacing between each curl (0 default)
+    int layers;             // Amount of copper layers
+    int count;              // Number of coils
+    double clean;           // Largest clearance the coil has no violations at (0 none)
+} Config;
+/* --- End of DEFINITIONS --- */
+
+/* --- FUNCTIONS --- */
+
+/* clearanceRun
+ * Generates a coil in a mode and checks its clearance.
+ * Returns 1 when the coil could not be generated or checked.
+ *
+ * Parameters:
+ *  -   config:     Coil to generate
+ *  -   mode:       Generation mode (0 uniform, 1 adaptive, 2 arcs)
+ *  -   clearance:  Minimum clearance
+ *  -   check:      Returned results (freed by coilClearanceFree)
+ */
+static int clearanceRun(const Config *config, int mode, double clearance, CoilClearance *check) {
+    CoilParams params;
+    coilDefaults(&params);
+    config->turns > 0 ? params.turns = config->turns : 0;
+    config->spacing > 0 ? params.spacing = config->spacing : 0;
+    params.layers = config->layers;
+    params.count = config->count;
+    mode == 1 ? params.tolerance = MODE_TOLERANCE : 0;
+    mode == 2 ? params.arcTolerance = MODE_TOLERANCE : 0;
+
+    CoilList list = {NULL, 0, 0};
+    CoilSink sink = {&list, NULL, coilListWrite};
+    CoilBuffers buffers = {NULL, 0};
+    CoilStats stats;
+    int error = coilGenerate(&params, &sink, &buffers, &stats) != 0;
+    coilStatsFree(&stats);
+    coilBuffersFree(&buffers);
+
+    memset(check, 0, sizeof(CoilClearance));
+    error = error || coilClearance(list.items, list.count, params.layers, clearance, LISTED, check);
+    free(list.items);
+    return error;
+}
+
+/* violationFound
+ * Returns 1 when the smallest violation of a check is one of the listed violations of another
+ * check: on the same layer, at the same place and with the same clearance.
+ *
+ * Parameters:
+ *  -   check:      Check with the violation
+ *  -   other:      Check listing the violations
+ *  -   tolerance:  Largest difference of the clearances
+ */
+static int violationFound(const CoilClearance *check, const CoilClearance *other, double tolerance) {
+    const CoilViolation *v = &check->list[0];
+    for (int i = 0; i < other->listed; i++) {
+        const CoilViolation *w = &other->list[i];
+        if (w->layer == v->layer && hypot(w->at[0] - v->at[0], w->at[1] - v->at[1]) <= LOCATION && fabs(w->clearance - v->clearance) <= tolerance) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* clearanceCompare
+ * Compares the clearance check of a mode with the one of the uniform steps: both find violations
+ * or none, with the same smallest clearance at the same place. The clearances may differ by the
+ * deviation of both modes from the spiral and by the widening of the tracks in the check.
+ * Returns 1 when they differ.
+ *
+ * Parameters:
+ *  -   check:      Check of the mode
+ *  -   uniform:    Check of the uniform steps
+ *  -   clearance:  Minimum clearance of the checks
+ */
+static int clearanceCompare(const CoilClearance *check, const CoilClearance *uniform, double clearance) {
+    double tolerance = 2*(MODE_TOLERANCE + fmax(clearance, 1e-3)/100);
+    if ((check->violations > 0) != (uniform->violations > 0)) {
+        return 1;
+    }
+    if (check->violations == 0) {
+        return 0;
+    }
+    return fabs(check->smallest - uniform->smallest) > tolerance || !violationFound(check, uniform, tolerance) || !violationFound(uniform, check, tolerance);
+}
+/* --- End of FUNCTIONS --- */
+
+/* --- MAIN --- */
+int main(void) {
+    const Config configs[] = {
+        {"2 layers", 0, 0, 2, 1, 0.2},
+        {"4 layers", 0, 0, 4, 1, 0},
+        {"2 layers, 2 coils", 0, 0, 2, 2, 0.2},
+        {"4 layers, 8 turns", 8, 0.2, 4, 1, 0},
+    };
+    const double clearances[] = {0.05, 0.1, 0.2, 0.25, 0.3};
+    const char *modes[3] = {"uniform", "adaptive", "arcs"};
+    int total = sizeof(configs)/sizeof(configs[0]), failed = 0;
+
+    for (int c = 0; c < total; c++) {
+        for (int k = 0; k < (int)(sizeof(clearances)/sizeof(clearances[0])); k++) {
+            CoilClearance checks[3];
+            int error = 0;
+            for (int m = 0; m < 3; m++) {
+                error |= clearanceRun(&configs[c], m, clearances[k], &checks[m]);
+            }
+
+            for (int m = 1; m < 3; m++) {
+                int differs = error || clearanceCompare(&checks[m], &checks[0], clearances[k]) || (clearances[k] <= configs[c].clean && checks[0].violations > 0);
+                printf("%s clearance %.2f %s: %ld violations, smallest %.4f (uniform %ld, %.4f) %s\n", configs[c].name, clearances[k], modes[m],
+                    checks[m].violations, checks[m].violations ? checks[m].smallest : 0, checks[0].violations, checks[0].violations ? checks[0].smallest : 0, differs ? "FAILED" : "ok");
+                failed += differs;
+            }
+
+            for (int m = 0; m < 3; m++) {
+                coilClearanceFree(&checks[m]);
+            }
+        }
+    }
+
+    printf("%d checks failed\n", failed);
+    return failed > 0;
+}
+/* --- End of MAIN --- */
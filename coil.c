@@ -7,6 +7,8 @@
  * This script allows users to enter the coil parameters while running the script on the
  * terminal window (command prompt) and generates coils by creating really small straight wire segments.
  * This script creates a new file that contains the KiCAD Footprint code, from where the user can copy and paste it into the .kicad_pcb file.
+ * The coils are generated by the coil generator library (libs/CoilGen), this script only reads the parameters
+ * and writes the footprint records of the library into the file or the board.
  * 
  * Parameters:
  *  -   -f:         Determines the file address to write footprint code into
@@ -21,19 +23,817 @@
  *  -   -w:         Determines the width of the wire segments making up the coil
  *  -   -n:         Determines the netID of the footprint file
  *  -   -v:         Determines the via size
+ *  -   -e:         Determines the maximum deviation of the segments from the spiral (adaptive step size)
+ *  -   -a:         Determines the maximum deviation of native KiCAD arcs from the spiral (arc output)
+ *  -   -q:         Determines the number of decimal digits of the coordinates
+ *  -   -z:         Determines if the trailing zeros of the coordinates are removed
+ *  -   --stats:    Determines the run report printed at the end (json)
+ *  -   --progress: Determines if the progress is printed
+ *  -   -j:         Determines the number of threads generating the layers (or running the jobs of -b)
+ *  -   -b:         Determines the job file with the parameters of one coil per line (batch)
+ *  -   -k:         Determines the kicad_pcb board to write the coils into, replacing the coils generated before
+ *  -   -g:         Determines the tag of the generated items (group name and start of their uuids)
+ *  -   --layout:   Determines the layout of the coils (circle motor, linear row or grid)
+ *  -   --cols:     Determines the number of columns of the grid layout
+ *  -   --pitch-x:  Determines the distance between the columns of the linear and grid layouts
+ *  -   --pitch-y:  Determines the distance between the rows of the grid layout
+ *  -   --alternate: Determines if every other coil turns the other way
+ *  -   --cache:    Determines the cache directory of the generated coils
+ *  -   --sides:    Determines the number of sides of the polygon coils (mode 1)
+ *  -   --chamfer:  Determines the length cut off each side of the corners of the polygon coils
+ *  -   --fillet:   Determines the radius of the rounded corners of the polygon coils
+ *  -   --copper:   Determines the copper thickness of the length, resistance and inductance analysis
+ *  -   --clearance: Determines the minimum clearance checked between the tracks and vias
+ *  -   --strict:   Determines if the run fails on clearance violations (the board is not patched)
+ *  -   --sweep:    Determines the ranges of -t, -w, -s, -l and -i evaluated to find the best coil (only the winner is written)
+ *  -   --max-radius: Determines the largest outer radius of the candidates of the sweep
+ *  -   --target-l: Determines the inductance the sweep aims for (uH)
+ *  -   --target-r: Determines the resistance the sweep aims for (ohm)
+ *  -   --footprint: Determines the .kicad_mod footprint file written from the same items, with pads at the terminals
+ *  -   --svg:      Determines the SVG preview file written from the same items
+ *  -   --dxf:      Determines the DXF drawing file written from the same items
+ *  -   --nm:       Determines if the coordinates are calculated in double and snapped to whole nanometers
+ *  -   --server:   Determines the Unix socket the generation server listens on (- for the standard input)
+ *  -   --outline:  Determines if each layer of a coil is written as one copper polygon instead of its tracks
+ *  -   --field:    Determines the grid of the magnetic field map of the coils, with their current, phases and angle
+ *  -   --field-out: Determines the file of the field map (CSV, or binary for a .bin file)
  */
 
 
 /* --- IMPORTS --- */
+#define _XOPEN_SOURCE 700       // getrusage, mmap and mkstemp with -std=c99
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
 #include <string.h>
+#include <sys/resource.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
 #include "./libs/TextToMath/textMath.h"
+#include "./libs/CoilGen/coilGen.h"
 /* --- End of IMPORTS --- */
 
-/* --- MAIN --- */
-int main(int argc, char *argv[]) {
+/* --- DEFINITIONS --- */
+#define WRITER_SIZE (1<<20) // Size of the output buffer, flushed into the file in blocks of this size
+#define BOARD_THICKNESS 1.6 // Thickness of the board the copper layers are spread over (analysis)
+#define VIOLATIONS 10       // Clearance violations listed (the smallest clearances)
+#define SWEEP_COPPER 0.035  // Copper thickness of the sweep without --copper (1 oz)
+#define SWEEP_GENERATED 16  // Best candidates of the estimate generated by the sweep
+#define SWEEP_CANDIDATES 1000000    // Largest number of candidates of a sweep
+#define SERVER_REQUEST 4096 // Longest request (line) of the server
+#define SERVER_WORDS 256    // Largest number of flags and parameters of a request
+#define SERVER_RECENT 32    // Responses of recent requests kept by the server
+#define SERVER_RECENT_SIZE (4<<20)  // Largest response kept by the server
+#define SERVER_BACKLOG 64   // Connections waiting for the threads of the server
+#define FIELD_POINTS 10000000   // Largest number of points of a field map
+#define TOLERANCE_FRACTION 1e-3 // Smallest tolerance of -e and -a as a fraction of the resolution of -p
+
+/* Buffers
+ * Output buffer and work units of a run. A batch keeps them between the jobs of a thread,
+ * so they are only allocated once instead of once per job.
+ */
+typedef struct {
+    char *buffer;           // Output buffer of the file (WRITER_SIZE)
+    CoilBuffers coil;       // Work units of the generator
+} Buffers;
+
+/* Output
+ * Context of the sink of the command line: the footprint records of each unit are appended
+ * to the output buffer of the file while the progress is printed.
+ */
+typedef struct {
+    CoilWriter *writer;     // Output buffer of the file
+    CoilWriter *cache;      // Copy of the records kept in the cache (NULL without a cache)
+    CoilList *list;         // Items kept for the analysis and the clearance check (NULL without them)
+    int listCoils;          // Coils of the items kept (1 for the analysis, all for the clearance check)
+    int listFailed;         // Set when the items could not be kept (no analysis and check)
+    int verbose;            // Print the coil being generated (1) or not (0)
+    int showProgress;       // Print the progress of each layer (1) or not (0)
+    int lastPercent;        // Percentage of the current layer printed last
+} Output;
+
+/* Formats
+ * Other formats written from the items of the same generation (--footprint, --svg and --dxf).
+ */
+typedef struct {
+    const char *files[3];   // Files of the footprint, the SVG preview and the DXF drawing (NULL when not written)
+    FILE *fp[3];            // Opened files
+    CoilWriter writers[3];  // Output buffers of the files
+    CoilOutput outputs[3];  // Outputs of the fan-out sink (coilFanoutWrite)
+    int count;              // Number of outputs
+    CoilBounds bounds;      // Bounds of the SVG preview
+} Formats;
+
+/* Result
+ * Counters of a run reported by the batch, or the coil evaluated by the sweep.
+ */
+typedef struct {
+    double time;            // Time of the run (seconds)
+    int segments, arcs, vias;
+    size_t bytes;           // Bytes written into the file
+    double deviation;       // Largest deviation from the spiral
+    const char *cache;      // Result of the cache (off, miss, geometry or file)
+    int evaluate;           // Only evaluate the coil, nothing is written (1 estimate, 2 generated items)
+    double outerRadius;     // Total radius of the coil (evaluated)
+    double length;          // Length of the tracks of one coil (evaluated)
+    double resistance;      // DC resistance of one coil (evaluated, ohm)
+    double inductance;      // Inductance of one coil (evaluated, henry)
+    long violations;        // Copper closer than the clearance (evaluated)
+    FILE *stream;           // Stream the records are written into instead of the file (server, closed by the run)
+    CoilList *items;        // Returned items of every coil (server, NULL when not needed)
+} Result;
+
+/* Job
+ * A single line of the job file: the arguments of one coil and its result.
+ */
+typedef struct {
+    int line;               // Line of the job file
+    int argc;               // Number of arguments (including the program name)
+    char **argv;            // Arguments of the job
+    char file[32];          // Default file of the job (./coil_text_N)
+    int status;             // Exit status of the job
+    Result result;          // Counters of the job
+} Job;
+
+/* Batch
+ * Jobs of a job file (or candidates of a sweep), taken in order by the threads of the batch.
+ */
+typedef struct {
+    Job *jobs;              // Jobs of the job file
+    int total;              // Number of jobs
+    int next;               // Next job to run
+    pthread_mutex_t lock;   // Protects next
+} Batch;
+
+/* Rank
+ * Place of a candidate of the sweep, the best score first.
+ */
+typedef struct {
+    int job;                // Index of the candidate
+    int fits;               // Meets the constraints (1) or not (0)
+    double score;           // Distance from the targets (lower is better)
+} Rank;
+
+/* Response
+ * Response of a recent request kept by the server.
+ */
+typedef struct {
+    char *key;              // Flags and format of the request (NULL for an empty place)
+    char *body;             // Body of the response
+    size_t size;            // Size of the body
+    Result result;          // Counters of the run
+    unsigned long used;     // Last use of the response (the least recently used one is replaced)
+} Response;
+
+/* Server
+ * Generation server (--server): the connections are served by a pool of threads keeping their
+ * buffers between the requests, and the responses of recent requests are kept in memory.
+ */
+typedef struct {
+    int argc;               // Number of default arguments (including the program name)
+    char **argv;            // Defaults of every request, the command line without the flags of the server
+    int listener;           // Listening socket (-1 for the standard input and output)
+    Response recent[SERVER_RECENT];     // Responses of recent requests
+    unsigned long uses;     // Number of uses of the recent responses
+    pthread_mutex_t lock;   // Protects the recent responses
+} Server;
+
+/* Board
+ * Board file patched in place (-k). The board is mapped into memory and copied once into a
+ * temporary file without the items generated before, the new items are written before its closing
+ * parenthesis and the temporary file replaces the board at the end.
+ */
+typedef struct {
+    const char *file;       // Address of the board file
+    char *temp;             // Address of the temporary file
+    char *data;             // Board mapped into memory
+    size_t size;            // Size of the board
+    size_t end;             // Position of the closing parenthesis of the board
+    int removed;            // Number of items generated before and removed
+    FILE *fp;               // Temporary file
+} Board;
+/* --- End of DEFINITIONS --- */
+
+/* --- FUNCTIONS --- */
+
+/* peakMemory
+ * Returns the peak resident memory of the process in KiB.
+ */
+static long peakMemory(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;      // Bytes on macOS
+#else
+    return usage.ru_maxrss;             // KiB on Linux
+#endif
+}
+
+/* progressPrint
+ * Prints the progress of the current layer. The terminal is only written when the shown
+ * percentage changes, instead of once for every point.
+ *
+ * Parameters:
+ *  -   show:           Print the progress (1) or not (0)
+ *  -   layer:          Index of the copper layer
+ *  -   index:          Index of the current point
+ *  -   fraction:       Fraction of the layer done
+ *  -   lastPercent:    Percentage printed last, updated when printing
+ */
+static void progressPrint(int show, int layer, int index, double fraction, int *lastPercent) {
+    int percent = (int)round(fraction * 100);
+    if (show && percent != *lastPercent) {
+        printf(" %d %2d (%.2f%%)\e[u", layer+1, index, (float)percent);
+        *lastPercent = percent;
+    }
+}
+
+/* listWrite
+ * Keeps the items of the coils of the analysis (--copper) and the clearance check (--clearance).
+ * Also the sink replaying the items when the records were copied from the cache.
+ *
+ * Parameters:
+ *  -   context:    Output of the run
+ *  -   unit:       Items of the unit
+ */
+static int listWrite(void *context, const CoilUnit *unit) {
+    Output *output = context;
+    return output->list != NULL && unit->coil < output->listCoils ? coilListWrite(output->list, unit) : 0;
+}
+
+/* outputWrite
+ * Sink of the command line. Appends the footprint records of a unit (coilKicadFormat) to the
+ * output buffer of the file and prints the progress of the layer.
+ * Returns 1 when the file could not be written, which stops the generation.
+ *
+ * Parameters:
+ *  -   context:    Output of the run
+ *  -   unit:       Items of the unit with their records
+ */
+static int outputWrite(void *context, const CoilUnit *unit) {
+    Output *output = context;
+
+    // Print out the coil and the progress tag at the start of each layer
+    if (unit->layer >= 0 && unit->chunk == 0) {
+        if (output->verbose && unit->layer == 0) printf("Coil: %d ...\n", unit->coil+1);
+        if (output->showProgress) printf(" - Progress:\e[s");
+        output->lastPercent = -1;
+    }
+
+    coilWriterAppend(output->writer, unit->text);
+    if (output->cache != NULL) coilWriterAppend(output->cache, unit->text);
+    output->list != NULL && listWrite(output, unit) ? output->listFailed = 1 : 0;
+
+    // Print out the progress
+    if (unit->layer >= 0) {
+        progressPrint(output->showProgress, unit->layer, unit->first + unit->count, (double)(unit->chunk+1) / unit->chunks, &output->lastPercent);
+        if (output->showProgress && unit->chunk == unit->chunks-1) printf("\n");
+    }
+
+    return output->writer->error;
+}
+
+
+/* cacheRun
+ * Generates the coils through the cache directory (--cache). The records of the same coils, placement
+ * and text are copied from the cache, otherwise the coils are generated from the cached geometry
+ * (coilCacheGenerate) and the records written are added to the cache for the next run.
+ * Returns the same as coilGenerate.
+ *
+ * Parameters:
+ *  -   dir:        Cache directory
+ *  -   params:     Parameters of the coils
+ *  -   sink:       Sink of the command line (outputWrite, or the fan-out to the other formats)
+ *  -   output:     Output of the run the records are written into
+ *  -   buffers:    Work units of the generator
+ *  -   stats:      Returned counters of the generation
+ *  -   cached:     Returned result of the cache (miss, geometry or file)
+ */
+static int cacheRun(const char *dir, const CoilParams *params, const CoilSink *sink, Output *output, CoilBuffers *buffers, CoilStats *stats, const char **cached) {
+
+    // Records of the geometry, its placement and the text of the records
+    char key[256], path[4096], temp[4096];
+    snprintf(key, sizeof(key), "%016llx %.17g %.17g %.17g %d %d %d %016llx%s", coilCacheKey(params), params->startX, params->startY, params->rotate, params->netID, params->precision, params->trimZeros, coilTagHash(params->tag), params->outline ? " outline" : "");
+    snprintf(path, sizeof(path), "%s/%016llx.txt", dir, coilTagHash(key));
+    snprintf(temp, sizeof(temp), "%s/%016llx.XXXXXX", dir, coilTagHash(key));
+
+    // Copy the records straight from the cache (mapped into memory)
+    int fd = open(path, O_RDONLY);
+    if (fd >= 0) {
+        struct stat info;
+        char *data = fstat(fd, &info) == 0 && info.st_size > 0 ? mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+        close(fd);
+
+        if (data != MAP_FAILED && !coilCacheStats(dir, params, stats)) {
+            CoilWriter text = {NULL, data, info.st_size, info.st_size, 0, 0, 0, 0, 0};
+            coilWriterAppend(output->writer, &text);
+            munmap(data, info.st_size);
+            *cached = "file";
+            return output->writer->error ? 2 : 0;
+        }
+        data != MAP_FAILED ? munmap(data, info.st_size) : 0;
+    }
+
+    // Keep a copy of the records in a temporary file of the cache
+    mkdir(dir, 0777);
+    fd = mkstemp(temp);
+    FILE *fp = fd >= 0 ? fdopen(fd, "wb") : NULL;
+    fd >= 0 && fp == NULL ? close(fd) : 0;
+    CoilWriter copy = {fp, fp != NULL ? malloc(WRITER_SIZE) : NULL, WRITER_SIZE, 0, 0, 0, 0, 0, 0};
+    output->cache = copy.buffer != NULL ? &copy : NULL;
+
+    int status = coilCacheGenerate(dir, params, sink, buffers, stats);
+    *cached = stats->cached ? "geometry" : "miss";
+
+    // The complete records replace the entry, so other runs never read a partial one
+    if (output->cache != NULL) coilWriterFlush(&copy);
+    int failed = fp == NULL || copy.buffer == NULL || copy.error || status;
+    fp != NULL && fclose(fp) ? failed = 1 : 0;
+    fd >= 0 ? (failed ? remove(temp) : rename(temp, path)) : 0;
+
+    output->cache = NULL;
+    free(copy.buffer);
+    return status;
+}
+
+/* boardGenerated
+ * Checks if a top level item of the board was generated with the tag: a track, via, copper
+ * polygon or group with a uuid starting with the hash of the tag.
+ *
+ * Parameters:
+ *  -   item:       Text of the item, starting with its parenthesis
+ *  -   length:     Length of the item
+ *  -   marker:     Start of the uuids of the tag (13 characters)
+ */
+static int boardGenerated(const char *item, size_t length, const char *marker) {
+    const char *kinds[5] = {"(segment", "(arc", "(via", "(group", "(gr_poly"};
+    int known = 0;
+
+    // Only the kinds of items the generator writes
+    for (int n = 0; n < 5; n++) {
+        size_t kindLength = strlen(kinds[n]);
+        if (length > kindLength && !strncmp(item, kinds[n], kindLength) && strchr(" \t\r\n", item[kindLength]) != NULL) {
+            known = 1;
+        }
+    }
+
+    // Look for a uuid of the tag
+    for (size_t c = 1; known && c + 13 <= length; c++) {
+        if (item[c] == marker[0] && item[c-1] == ' ' && !memcmp(item + c, marker, 13)) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* boardAbort
+ * Leaves the board untouched after a failed run: closes and removes the temporary file and
+ * unmaps the board.
+ *
+ * Parameters:
+ *  -   board:      Board to abort (boardOpen)
+ */
+static void boardAbort(Board *board) {
+    fclose(board->fp);
+    remove(board->temp);
+    free(board->temp);
+    munmap(board->data, board->size);
+}
+
+/* boardOpen
+ * Maps a board into memory and copies it into a temporary file up to its closing parenthesis,
+ * leaving out the items generated before with the same tag. The board is read only once.
+ * Returns 0 when the board is ready, 1 when it can not be read or written and 2 when it is not
+ * a kicad_pcb file (nothing is left open then).
+ *
+ * Parameters:
+ *  -   board:      Board to open
+ *  -   file:       Address of the board file
+ *  -   tag:        Hash of the tag (coilTagHash)
+ */
+static int boardOpen(Board *board, const char *file, unsigned long long tag) {
+    board->file = file;
+    board->removed = 0;
+
+    // Map the whole board into memory
+    struct stat info;
+    int fd = open(file, O_RDONLY);
+    if (fd < 0 || fstat(fd, &info) || info.st_size == 0) {
+        fd >= 0 ? close(fd) : 0;
+        return 1;
+    }
+    board->size = info.st_size;
+    board->data = mmap(NULL, board->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (board->data == MAP_FAILED) {
+        return 1;
+    }
+    posix_madvise(board->data, board->size, POSIX_MADV_SEQUENTIAL);
+
+    // Only a kicad_pcb file is patched
+    const char *data = board->data;
+    size_t c = 0;
+    while (c < board->size && strchr(" \t\r\n", data[c]) != NULL && data[c] != '\0') {
+        c++;
+    }
+    if (board->size - c < 10 || strncmp(data + c, "(kicad_pcb", 10)) {
+        munmap(board->data, board->size);
+        return 2;
+    }
+
+    // The temporary file is next to the board, so it can replace the board
+    board->temp = malloc(strlen(file) + 16);
+    sprintf(board->temp, "%s.coil-tmp", file);
+    board->fp = fopen(board->temp, "w");
+
+    // The board keeps its permissions when it is replaced by the temporary file
+    if (board->fp != NULL && fchmod(fileno(board->fp), info.st_mode & 07777)) {
+        fclose(board->fp);
+        remove(board->temp);
+        board->fp = NULL;
+    }
+    if (board->fp == NULL) {
+        free(board->temp);
+        munmap(board->data, board->size);
+        return 1;
+    }
+    setvbuf(board->fp, NULL, _IONBF, 0);
+
+    // Start of the uuids of the tag
+    char marker[40];
+    coilUuid(marker, tag, 0, 0, 0, 0);
+
+    // Walk through the top level items, copying everything but the generated ones
+    size_t copied = 0, itemStart = 0;
+    int depth = 0, quoted = 0, error = 0;
+    board->end = 0;
+    for (c = 0; c < board->size && board->end == 0; c++) {
+        if (quoted) {
+            data[c] == '\\' ? c++ : (data[c] == '"' ? quoted = 0 : 0);
+        } else if (data[c] == '"') {
+            quoted = 1;
+        } else if (data[c] == '(') {
+            depth++ == 1 ? itemStart = c : 0;
+        } else if (data[c] == ')' && --depth == 1 && boardGenerated(data + itemStart, c + 1 - itemStart, marker)) {
+
+            // Leave out the item together with its indentation and line end
+            size_t from = itemStart, to = c + 1;
+            while (from > copied && (data[from-1] == ' ' || data[from-1] == '\t')) {
+                from--;
+            }
+            to < board->size && data[to] == '\r' ? to++ : 0;
+            to < board->size && data[to] == '\n' ? to++ : 0;
+
+            error |= fwrite(data + copied, 1, from - copied, board->fp) != from - copied;
+            copied = to;
+            c = to - 1;
+            board->removed++;
+        } else if (data[c] == ')' && depth == 0) {
+            board->end = c;
+        }
+    }
+
+    // The board has to be closed
+    if (board->end == 0) {
+        boardAbort(board);
+        return 2;
+    }
+
+    error |= fwrite(data + copied, 1, board->end - copied, board->fp) != board->end - copied;
+    if (error) boardAbort(board);
+
+    return error;
+}
+
+/* boardClose
+ * Writes the rest of the board after the generated items and replaces the board with the
+ * temporary file, unless something could not be written. Then the board is left untouched.
+ * Returns 0 when the board is replaced.
+ *
+ * Parameters:
+ *  -   board:      Board to close (boardOpen)
+ *  -   writer:     Output buffer of the generated items
+ */
+static int boardClose(Board *board, CoilWriter *writer) {
+    coilWriterFlush(writer);
+
+    int error = writer->error;
+    error |= fwrite(board->data + board->end, 1, board->size - board->end, board->fp) != board->size - board->end;
+    error |= fclose(board->fp) != 0;
+    munmap(board->data, board->size);
+
+    // Replace the board at once
+    error = error || rename(board->temp, board->file) != 0;
+    error ? remove(board->temp) : 0;
+    free(board->temp);
+
+    return error;
+}
+
+/* groupWrite
+ * Writes the group of all the generated items, named after the tag. The uuids of the members
+ * are formatted again from the number of items of each coil and layer, a layer written as a
+ * copper polygon (--outline) has the polygon as its only member.
+ *
+ * Parameters:
+ *  -   writer:     Output buffer to write into
+ *  -   name:       Name of the group (tag)
+ *  -   tag:        Hash of the tag (coilTagHash)
+ *  -   count:      Number of coils
+ *  -   layers:     Number of copper layers
+ *  -   tracks:     Number of tracks of each coil and layer (count x layers)
+ *  -   vias:       Number of vias of each coil
+ *  -   links:      Number of via connections of each coil
+ *  -   outline:    Layers written as copper polygons (1) or tracks (0)
+ */
+static void groupWrite(CoilWriter *writer, const char *name, unsigned long long tag, int count, int layers, const long *tracks, const int *vias, const int *links, int outline) {
+    char uuid[40];
+    long members = 0;
+
+    coilWriterPrintf(writer, "(group \"%s\" (id %s)\n  (members", name, coilUuid(uuid, tag, 0, 0, 3, 0));
+    for (int k = 0; k < count; k++) {
+        for (int i = 0; i < layers; i++) {
+            for (long n = 0; n < tracks[k*layers + i] && !outline; n++) {
+                coilWriterPrintf(writer, members++ % 4 ? " %s" : "\n    %s", coilUuid(uuid, tag, k, i, 0, n));
+            }
+            if (outline && tracks[k*layers + i] > 0) coilWriterPrintf(writer, members++ % 4 ? " %s" : "\n    %s", coilUuid(uuid, tag, k, i, 4, 0));
+        }
+        for (int n = 0; n < vias[k]; n++) {
+            coilWriterPrintf(writer, members++ % 4 ? " %s" : "\n    %s", coilUuid(uuid, tag, k, 0, 1, n));
+        }
+        for (int n = 0; n < links[k]; n++) {
+            coilWriterPrintf(writer, members++ % 4 ? " %s" : "\n    %s", coilUuid(uuid, tag, k, 0, 2, n));
+        }
+    }
+    coilWriterPrintf(writer, "\n  )\n)\n");
+}
+
+/* formatsClose
+ * Writes the end of the other formats and closes their files, or removes them when the run failed.
+ * Returns 1 when a file could not be written (the file is removed).
+ *
+ * Parameters:
+ *  -   formats:    Formats opened by formatsOpen
+ *  -   keep:       Finish the files (1) or remove them (0)
+ */
+static int formatsClose(Formats *formats, int keep) {
+    int failed = 0;
+
+    for (int f = 0; f < 3; f++) {
+        if (formats->fp[f] == NULL) {
+            continue;
+        }
+        CoilWriter *writer = &formats->writers[f];
+
+        if (keep && f == 0) coilFootprintEnd(writer);
+        if (keep && f == 1) coilSvgEnd(writer, &formats->bounds);
+        if (keep && f == 2) coilDxfEnd(writer);
+        if (keep) coilWriterFlush(writer);
+        fclose(formats->fp[f]) ? writer->error = 1 : 0;
+        free(writer->buffer);
+
+        keep && writer->error ? printf("Error writing %s!\n\r", formats->files[f]) : 0;
+        !keep || writer->error ? remove(formats->files[f]) : 0;
+        failed |= keep && writer->error;
+    }
+
+    return failed;
+}
+
+/* formatsOpen
+ * Opens the files of the other formats and writes their start. Each of them becomes an output of
+ * the fan-out sink, so they are written from the items of the same generation.
+ * Returns 1 when a file could not be opened (none of them is left open).
+ *
+ * Parameters:
+ *  -   formats:    Formats with their files (NULL when not written)
+ *  -   params:     Parameters of the coils
+ */
+static int formatsOpen(Formats *formats, const CoilParams *params) {
+    void (*format[3])(void *, const CoilParams *, const CoilUnit *, CoilWriter *) = {coilFootprintFormat, coilSvgFormat, coilDxfFormat};
+    formats->count = 0;
+    formats->fp[0] = formats->fp[1] = formats->fp[2] = NULL;
+
+    for (int f = 0; f < 3; f++) {
+        if (formats->files[f] == NULL) {
+            continue;
+        }
+
+        FILE *fp = fopen(formats->files[f], "w");
+        char *buffer = fp != NULL ? malloc(WRITER_SIZE) : NULL;
+        if (buffer == NULL) {
+            printf("Error opening %s!\n\r", formats->files[f]);
+            fp != NULL ? fclose(fp) : 0;
+            formatsClose(formats, 0);
+            return 1;
+        }
+        formats->fp[f] = fp;
+
+        // The file is only written in large blocks from the output buffer
+        setvbuf(formats->fp[f], NULL, _IONBF, 0);
+        CoilWriter writer = {formats->fp[f], buffer, WRITER_SIZE, 0, 0, params->precision, params->trimZeros, 0, 0};
+        formats->writers[f] = writer;
+        if (f == 0) coilFootprintBegin(&formats->writers[f], params);
+        if (f == 1) coilSvgBegin(&formats->writers[f], params, &formats->bounds);
+        if (f == 2) coilDxfBegin(&formats->writers[f]);
+
+        CoilOutput output = {format[f], f == 1 ? &formats->bounds : NULL, &formats->writers[f]};
+        formats->outputs[formats->count++] = output;
+    }
+
+    return 0;
+}
+
+/* fieldParse
+ * Reads the grid and the currents of the field map: x=min:max:step,y=...,z=... (an axis left
+ * out, or given a single value, has one point), i=current of the coils (ampere, default 1),
+ * p=phases the coils are spread over (default 1) and a=electrical angle (radians, default 0).
+ * Coil k carries i cos(a - 2 pi k / p), so the coils of a motor take the currents of a rotating field.
+ * Returns 1 when the spec cannot be read, 2 when it has more than FIELD_POINTS points.
+ *
+ * Parameters:
+ *  -   spec:       Grid and currents of the field map
+ *  -   grid:       Returned points of the field map
+ *  -   current:    Returned current (ampere)
+ *  -   phases:     Returned number of phases
+ *  -   angle:      Returned electrical angle (radians)
+ */
+static int fieldParse(const char *spec, CoilGrid *grid, double *current, int *phases, double *angle) {
+    const char *axes = "xyz";
+    for (int a = 0; a < 3; a++) {
+        grid->min[a] = 0;
+        grid->step[a] = 0;
+        grid->points[a] = 1;
+    }
+    *current = 1;
+    *phases = 1;
+    *angle = 0;
+
+    char *text = malloc(strlen(spec) + 1);
+    int error = text == NULL;
+    text != NULL ? strcpy(text, spec) : 0;
+
+    char *saved;
+    for (char *word = error ? NULL : strtok_r(text, ",", &saved); word != NULL; word = strtok_r(NULL, ",", &saved)) {
+        const char *axis = word[0] != '\0' && word[1] == '=' ? strchr(axes, word[0]) : NULL;
+        if (axis != NULL) {
+            // Points of an axis (min:max:step, the step defaults to 1)
+            int a = axis - axes;
+            double range[3] = {0, 0, 1};
+            int read = sscanf(word + 2, "%lf:%lf:%lf", &range[0], &range[1], &range[2]);
+            read < 2 ? range[1] = range[0] : 0;
+            read < 3 ? range[2] = 1 : 0;
+            grid->min[a] = range[0];
+            grid->step[a] = range[2];
+            grid->points[a] = read >= 1 && range[2] > 0 && range[1] > range[0] ? (long)floor((range[1] - range[0])/range[2] + 1e-9) + 1 : 1;
+            read < 1 || (range[1] - range[0])/range[2] >= FIELD_POINTS ? error = 1 : 0;
+        } else if (word[0] == 'i' && word[1] == '=') {
+            *current = atof(word + 2);
+        } else if (word[0] == 'p' && word[1] == '=') {
+            *phases = atoi(word + 2);
+            *phases < 1 ? *phases = 1 : *phases;                        // Failsafe for phases
+        } else if (word[0] == 'a' && word[1] == '=') {
+            *angle = atof(word + 2);
+        } else {
+            error = 1;
+        }
+    }
+    free(text);
+
+    double points = (double)grid->points[0] * grid->points[1] * grid->points[2];
+    return error ? 1 : (points > FIELD_POINTS ? 2 : 0);
+}
+
+/* fieldWrite
+ * Writes the field map into its file: CSV (coilFieldFormat), or binary for a .bin file: the
+ * magic "COILFLD1", the points of x, y and z (int32), the first point and the steps of the grid
+ * (float64), then bx, by and bz of every point (float32, microtesla), all in the byte order of the machine.
+ * Returns 1 when the file could not be written.
+ *
+ * Parameters:
+ *  -   file:       File of the field map
+ *  -   grid:       Points of the field map
+ *  -   field:      Flux density of the points
+ *  -   params:     Parameters of the coils (precision of the CSV)
+ *  -   written:    Returned bytes written
+ */
+static int fieldWrite(const char *file, const CoilGrid *grid, const CoilField *field, const CoilParams *params, size_t *written) {
+    size_t length = strlen(file);
+    int binary = length >= 4 && !strcmp(file + length - 4, ".bin");
+    FILE *fp = fopen(file, binary ? "wb" : "w");
+    *written = 0;
+    if (fp == NULL) {
+        return 1;
+    }
+
+    int error = 0;
+    if (binary) {
+        // Header and the values as they are in memory
+        int points[3] = {grid->points[0], grid->points[1], grid->points[2]};
+        error |= fwrite("COILFLD1", 1, 8, fp) != 8;
+        error |= fwrite(points, sizeof(int), 3, fp) != 3;
+        error |= fwrite(grid->min, sizeof(double), 3, fp) != 3;
+        error |= fwrite(grid->step, sizeof(double), 3, fp) != 3;
+        error |= fwrite(field->b, sizeof(float), 3*field->points, fp) != (size_t)(3*field->points);
+        *written = 8 + 3*sizeof(int) + 6*sizeof(double) + 3*field->points*sizeof(float);
+    } else {
+        // Rows through the output buffer, written in large blocks
+        char *buffer = malloc(WRITER_SIZE);
+        setvbuf(fp, NULL, _IONBF, 0);
+        CoilWriter writer = {fp, buffer, WRITER_SIZE, 0, 0, params->precision, params->trimZeros, 0, 0};
+        if (buffer != NULL) coilFieldFormat(&writer, grid, field);
+        if (buffer != NULL) coilWriterFlush(&writer);
+        error = buffer == NULL || writer.error;
+        *written = writer.written;
+        free(buffer);
+    }
+
+    fclose(fp) ? error = 1 : 0;
+    error ? remove(file) : 0;
+    return error;
+}
+
+/* coilEvaluate
+ * Evaluates a candidate of the sweep without writing anything: the radius, length, resistance,
+ * inductance and clearance are estimated from the parameters (coilEstimate), or taken from the
+ * generated items (coilAnalyze and coilClearance) for the best candidates.
+ * Returns 1 when the items could not be generated or evaluated.
+ *
+ * Parameters:
+ *  -   params:     Parameters of the coils
+ *  -   copper:     Copper thickness (0 for SWEEP_COPPER)
+ *  -   clearance:  Minimum clearance (0 for no check)
+ *  -   buffers:    Work units of the generator
+ *  -   result:     Returned evaluation (evaluate 1 estimates, 2 generates the items)
+ */
+static int coilEvaluate(const CoilParams *params, double copper, double clearance, CoilBuffers *buffers, Result *result) {
+    copper <= 0 ? copper = SWEEP_COPPER : copper;
+    result->violations = 0;
+
+    // Estimate from the parameters, only the gap between the turns is checked
+    if (result->evaluate == 1) {
+        CoilEstimate estimate;
+        coilEstimate(params, copper, BOARD_THICKNESS, &estimate);
+        result->outerRadius = estimate.outerRadius;
+        result->length = estimate.length;
+        result->resistance = estimate.resistance;
+        result->inductance = estimate.inductance;
+        result->violations = estimate.gap < clearance;
+        return 0;
+    }
+
+    // Items of all the coils, kept in memory instead of being written
+    CoilList list = {NULL, 0, 0};
+    CoilSink sink = {&list, NULL, coilListWrite};
+    CoilStats counters;
+    int error = coilGenerate(params, &sink, buffers, &counters) != 0;
+    result->outerRadius = counters.outerRadius;
+    result->segments = counters.segments;
+    result->arcs = counters.arcs;
+    result->vias = counters.vias;
+    coilStatsFree(&counters);
+
+    CoilAnalysis analysis = {0, NULL, NULL, NULL, 0, 0, 0, 0, 0, 0};
+    error = error || coilAnalyze(list.items, list.count, params->layers, copper, BOARD_THICKNESS, params->threads, &analysis);
+    result->length = analysis.totalLength;
+    result->resistance = analysis.totalResistance;
+    result->inductance = analysis.totalInductance;
+
+    CoilClearance check = {0, 0, NULL, 0, 0, 0, 0};
+    error = error || (clearance > 0 && coilClearance(list.items, list.count, params->layers, clearance, 0, &check));
+    result->violations = check.violations;
+
+    free(list.items);
+    coilAnalysisFree(&analysis);
+    coilClearanceFree(&check);
+    return error;
+}
+/* --- End of FUNCTIONS --- */
+
+/* --- RUN --- */
+/* coilRun
+ * Generates the coils of a single set of arguments into its file: the command line,
+ * or one job of a batch.
+ *
+ * Parameters:
+ *  -   argc:       Number of arguments
+ *  -   argv:       Arguments (flag and parameter pairs after the program name)
+ *  -   buffers:    Output buffer and work units, reused between runs
+ *  -   result:     Counters of the run for the batch (NULL on the command line, a job prints no messages),
+ *                  or the evaluation of a candidate of the sweep (evaluate set, nothing is written)
+ */
+static int coilRun(int argc, char *argv[], Buffers *buffers, Result *result) {
+
+    // Start timing the run
+    double timeBegin = coilNow();
 
     /* --- FAILSAFE --- */
     /* Make sure the program does not fail due to any unforseen user errors
@@ -44,7 +844,7 @@ int main(int argc, char *argv[]) {
         if (strcmp(argv[1],"-h")) {
             printf("Usage: %s flags parameters\n\r",argv[0]);
             printf(" --------------------------------------------- \n");
-            printf("\t-f file_address\t(Default ./coil_text)\n\t-m mode\t\t(Default 0)\n\t-c count\t(Default 1)\n\t-t turns\t(Default 10)\n\t-i innerRadius\t(Default 0)\n\t-s spacing\t(Default 0.25)\n\t-x start_X\t(Default 0)\n\t-y start_Y\t(Default 0)\n\t-l layers\t(Default 1)\n\t-d direction(±1)(Default 1)\n\t-r rotation\t(Default 0 radians)\n\t-w width\t(Default 0.25)\n\t-n netID\t(Default 0)\n\t-v viaSize\t(Default 0.8)\n\t-p resolution\t(Default 0.01, lower better but slower)\n\t-h help\n\r");
+            printf("\t-f file_address\t(Default ./coil_text)\n\t-m mode\t\t(Default 0)\n\t-c count\t(Default 1)\n\t-t turns\t(Default 10)\n\t-i innerRadius\t(Default 0)\n\t-s spacing\t(Default 0.25)\n\t-x start_X\t(Default 0)\n\t-y start_Y\t(Default 0)\n\t-l layers\t(Default 1)\n\t-d direction(±1)(Default 1)\n\t-r rotation\t(Default 0 radians)\n\t-w width\t(Default 0.25)\n\t-n netID\t(Default 0)\n\t-v viaSize\t(Default 0.8)\n\t-p resolution\t(Default 0.01, lower better but slower)\n\t-e tolerance\t(Default 0, adaptive step off)\n\t-a arcTolerance\t(Default 0, arcs off)\n\t-q precision\t(Default 6 decimals)\n\t-z trimZeros\t(Default 0, keep zeros)\n\t--stats json\t(Default none, run report)\n\t--progress 0/1\t(Default 1)\n\t-j threads\t(Default 1, 0 uses all cores)\n\t-b jobFile\t(Default none, one coil per line)\n\t-k board\t(Default none, patch a kicad_pcb in place)\n\t-g tag\t\t(Default coil, group of the items)\n\t--layout type\t(Default circle, linear or grid)\n\t--cols columns\t(Default 0, square grid)\n\t--pitch-x pitch\t(Default 0, coils next to each other)\n\t--pitch-y pitch\t(Default 0, coils next to each other)\n\t--alternate 0/1\t(Default 0, same direction)\n\t--cache dir\t(Default none, reuse generated coils)\n\t--sides sides\t(Default 4, polygon of mode 1)\n\t--chamfer cut\t(Default 0, sharp corners)\n\t--fillet radius\t(Default 0, sharp corners)\n\t--copper thick\t(Default 0, analysis off)\n\t--clearance min\t(Default 0, check off)\n\t--strict 0/1\t(Default 0, report violations)\n\t--sweep ranges\t(Default none, t=min:max:step,w=...)\n\t--max-radius r\t(Default 0, sweep without limit)\n\t--target-l uH\t(Default 0, sweep best L/R)\n\t--target-r ohm\t(Default 0, sweep best L/R)\n\t--footprint mod\t(Default none, .kicad_mod with pads)\n\t--svg file\t(Default none, SVG preview)\n\t--dxf file\t(Default none, DXF drawing)\n\t--nm 0/1\t(Default 0, float engine)\n\t--server path\t(Default none, - for stdin)\n\t--outline 0/1\t(Default 0, tracks)\n\t--field grid\t(Default none, x=min:max:step,y=...,z=...)\n\t--field-out file(Default ./coil_field.csv, .bin binary)\n\t-h help\n\r");
             printf(" --------------------------------------------- \n");
             printf(" The order of the inputs does not matter\n\r");
             return 1;
@@ -57,82 +857,50 @@ int main(int argc, char *argv[]) {
      * even if the user only enters one or two parameters. This ensures
      * that the program will be able to create a coil even without any user
      * defined parameters. When run without any user defined parameters, it
-     * will create a basic coil using the constants defined below. This will
-     * allow for debuging and easy learning curve for beginner users.
+     * will create a basic coil using the defaults of the coil generator (coilDefaults).
+     * This will allow for debuging and easy learning curve for beginner users.
      */
 
     // kicad_pcb file address on your computer.
     // This is footprint file to overwrite the coil into
     char* filename = "./coil_text";
 
-    // Coil mode (circular or rectangular)
-    int mode = 0;                  // Default (0) is circular
-
-    // Coil count to generate
-    int count = 1;                  // Default (1) is single coil
+    // Coil parameters: mode, count, turns, innerRadius, spacing, start, layers, direction, rotation,
+    // width, netID, viaSize, resolution, tolerances, precision, threads, tag and layout
+    CoilParams params;
+    coilDefaults(&params);
 
-    // Amount of Turns around the center
-    float turns = 10;               // Default (10) rotations
+    // Run report with the phase timings and counters
+    int stats = 0;                  // Default (0) none, (1) json report instead of the messages
 
-    // Inner Radius of the spiral
-    float innerRadius = 0.00;       // Default (0) inner radius
+    // Progress output
+    int showProgress = 1;           // Default (1) prints the progress of each layer
 
-    // Width of the copper trace
-    float width = 0.25;             // Default (0.25) width
+    // Decimal digits entered with -q, kept by the nanometer engine
+    int precisionGiven = 0;         // Default (0) the nanometer engine writes 6 decimals
 
-    // Spacing between each curl
-    float spacing = 0.25 + width;   // Default (0.25) spacing
+    // kicad_pcb board to patch in place instead of writing the file
+    char* boardName = NULL;         // Default (none) writes the file (-f)
 
-    // Initial Start Coordinates
-    float startX = 0.00;            // Default X: (0.00)
-    float startY = 0.00;            // Default Y: (0.00)
+    // Cache directory of the generated coils
+    char* cacheDir = NULL;          // Default (none) generates every coil
 
-    // Amount of Layers
-    int layers = 1;                 // Default (1) Layer (F.Cu)
+    // Copper thickness of the analysis of the coil
+    double copper = 0.00;           // Default (0) no analysis, greater than 0 reports the length, resistance and inductance
 
-    // Direction of Rotation
-    int direction = 1;              // Default (1) (CounterClockWise - CCW), (-1) would mean CW
+    // Clearance check of the tracks and vias
+    double clearance = 0.00;        // Default (0) no check, greater than 0 reports the copper closer than the clearance
+    int strict = 0;                 // Default (0) reports the violations, (1) fails the run
 
-    // Rotation
-    float rotate = 0.00;            // Default (0) radians, rotates counterclockwise (units of radians, not degrees!)
+    // Other formats written from the same generation: footprint (.kicad_mod), SVG preview and DXF drawing
+    Formats formats;
+    formats.files[0] = formats.files[1] = formats.files[2] = NULL;     // Default (none) only writes the file or the board
 
-    // netID of the kicad_pcb file
-    int netID = 0;                  // Default (net 0 "")
-
-    // Via Size
-    float viaSize = 0.8;            // Default via size (0.8)
-
-    // Resolution of the coil gen
-    float resolution = 0.01;        // Default (0.01) resolution, lower is better, but slower
+    // Magnetic field of the coils on a grid of points (Biot-Savart)
+    char* fieldSpec = NULL;         // Default (none) no field map, x=min:max:step,y=...,z=... with the current (i), phases (p) and angle (a)
+    char* fieldFile = "./coil_field.csv";   // Default CSV, a .bin file is written in binary
     /* --- End of CONSTANTS --- */
 
-    /* --- VARIABLES --- */
-    /* Below are the secondary coil parameters used to create a motor
-     * out of multiple coils. These parameters before are defined as an 
-     * extension to the constants above. If the user enters greater than 1
-     * for the "-c" (count) flag then some of the constants defaults into
-     * these variables.
-     */
-
-    // Motor radius
-    /* motorRadius replaces the innerRadius constant. 
-     * Instead of changing the radius of each coil, the motorRadius variable changes 
-     * the radius of the motor created by set of coils arranged in a circle.
-     * Each individual coils will have an innerRadius of 0.
-     * If the user enters "-i" (innerRadius) the value will be transferred to motorRadius.
-     */
-    float motorRadius = 0.00;       // Default (0) radius
-
-    // Motor rotate
-    /* motorRotate replaces the rotate constant.
-     * Instead of changing the angle of each coil, the motorRotate variable changes
-     * the angle of the motor created by set of coils arranged in a circle.
-     * Each individual coils will have an angle of 0.
-     * If the user enters "-r" (rotate) the value will be transferred to motorRotate.
-     */
-    float motorRotate = 0.00;       // Default (0) radians
-    /* --- End of VARIABLES --- */
-
     /* --- ARGUMENTS --- */
     /* Iterate through each of the users arguments and make sure that the user has entered
      * the arguments using the appropriate flags. The order of the flag and parameter pair does not matter.
@@ -149,67 +917,168 @@ int main(int argc, char *argv[]) {
             filename = argv[i+1];                                       // Update the filename
 
         } else if (!strcmp(argv[i],"-m")) {
-            mode = atoi(argv[i+1]);                                     // Update the coil mode
-            mode < 0 ? mode = 0 : mode;                                 // Lower Boundary Failsafe
-            mode > 1 ? mode = 1 : mode;                                 // Upper Boundary Failsafe
+            params.mode = atoi(argv[i+1]);                              // Update the coil mode
+            params.mode < 0 ? params.mode = 0 : params.mode;            // Lower Boundary Failsafe
+            params.mode > 1 ? params.mode = 1 : params.mode;            // Upper Boundary Failsafe
 
         } else if (!strcmp(argv[i],"-c")) {
-            count = atoi(argv[i+1]);                                    // Update the coil count
-            count < 1 ? count = 1 : count;                              // Failsafe for coil count
+            params.count = atoi(argv[i+1]);                             // Update the coil count
+            params.count < 1 ? params.count = 1 : params.count;         // Failsafe for coil count
 
         } else if (!strcmp(argv[i],"-t")) {
-            turns = atof(argv[i+1]);                                    // Update the Turns
-            turns < 1 ? turns = 1 : turns;                              // Failsafe for turns
+            params.turns = atof(argv[i+1]);                             // Update the Turns
+            params.turns < 1 ? params.turns = 1 : params.turns;         // Failsafe for turns
 
         } else if (!strcmp(argv[i],"-i")) {
-            innerRadius = atof(argv[i+1]);                              // Update the Inner Radius
-            innerRadius < 0 ? innerRadius = 0 : innerRadius;            // Failsafe for innerRadius
+            params.innerRadius = atof(argv[i+1]);                       // Update the Inner Radius
+            params.innerRadius < 0 ? params.innerRadius = 0 : params.innerRadius;   // Failsafe for innerRadius
             
         } else if (!strcmp(argv[i],"-s")) {
-            spacing = atof(argv[i+1]) + width;                          // Update the Spacing
-            spacing < 0 ? spacing = width : spacing;                    // Failsafe for spacing
+            params.spacing = atof(argv[i+1]);                           // Update the Spacing
+            params.spacing < 0 ? params.spacing = 0 : params.spacing;   // Failsafe for spacing
 
         } else if (!strcmp(argv[i],"-x")) {
-            startX = atof(argv[i+1]);                                   // Update the Start Coordinate X value
+            params.startX = atof(argv[i+1]);                            // Update the Start Coordinate X value
 
         } else if (!strcmp(argv[i],"-y")) {
-            startY = atof(argv[i+1]);                                   // Update the Start Coordinate Y value
+            params.startY = atof(argv[i+1]);                            // Update the Start Coordinate Y value
 
         } else if (!strcmp(argv[i],"-l")) {
-            layers = atoi(argv[i+1]);                                   // Update the Layers
-            layers < 1 ? layers = 1 : layers;                           // Failsafe for layers
+            params.layers = atoi(argv[i+1]);                            // Update the Layers
+            params.layers < 1 ? params.layers = 1 : params.layers;      // Failsafe for layers
             
         } else if (!strcmp(argv[i],"-d")) {
-            direction = atoi(argv[i+1]);                                // Update the Direction
-            if (direction != 1 && direction != -1) { direction = 1; }   // Failsafe for direction
+            params.direction = atoi(argv[i+1]);                         // Update the Direction
+            if (params.direction != 1 && params.direction != -1) { params.direction = 1; }   // Failsafe for direction
 
         } else if (!strcmp(argv[i],"-r")) {
             /* The user can enter a mathematical expression to calculate the angle using textCalc() */
-            rotate = textCalc(argv[i+1]);                               // Update the Rotate
+            params.rotate = textCalc(argv[i+1]);                        // Update the Rotate
             
         } else if (!strcmp(argv[i],"-w")) {
-            width = atof(argv[i+1]);                                    // Update the Width
-            width < 0 ? width = 0.25 : width;                           // Failsafe for width
+            params.width = atof(argv[i+1]);                             // Update the Width
+            params.width < 0 ? params.width = 0.25 : params.width;      // Failsafe for width
             
 
         } else if (!strcmp(argv[i],"-n")) {
-            netID = atoi(argv[i+1]);                                    // Update the netID
-            netID < 0 ? netID = 0 : netID;                              // Failsafe for netID
+            params.netID = atoi(argv[i+1]);                             // Update the netID
+            params.netID < 0 ? params.netID = 0 : params.netID;         // Failsafe for netID
             
         } else if (!strcmp(argv[i],"-v")) {
-            viaSize = atof(argv[i+1]);                                  // Update the viaSize
-            viaSize < 0 ? viaSize = 0 : viaSize;                        // Failsafe for viaSize
+            params.viaSize = atof(argv[i+1]);                           // Update the viaSize
+            params.viaSize < 0 ? params.viaSize = 0 : params.viaSize;   // Failsafe for viaSize
 
         } else if (!strcmp(argv[i],"-p")) {
-            resolution = atof(argv[i+1]);                               // Update the resolution
-            resolution < 0.01 ? resolution = 0.01 : resolution;         // Failsafe for resolution
-            resolution > 1 ? resolution = 1 : resolution;               // Failsafe for resolution
+            params.resolution = atof(argv[i+1]);                        // Update the resolution
+            params.resolution < 0.01 ? params.resolution = 0.01 : params.resolution;   // Failsafe for resolution
+            params.resolution > 1 ? params.resolution = 1 : params.resolution;   // Failsafe for resolution
+
+        } else if (!strcmp(argv[i],"-e")) {
+            params.tolerance = atof(argv[i+1]);                         // Update the tolerance
+            params.tolerance < 0 ? params.tolerance = 0 : params.tolerance;   // Failsafe for tolerance
+
+        } else if (!strcmp(argv[i],"-a")) {
+            params.arcTolerance = atof(argv[i+1]);                      // Update the arc tolerance
+            params.arcTolerance < 0 ? params.arcTolerance = 0 : params.arcTolerance;   // Failsafe for arc tolerance
+
+        } else if (!strcmp(argv[i],"-q")) {
+            params.precision = atoi(argv[i+1]);                         // Update the precision
+            precisionGiven = 1;
+            params.precision < 0 ? params.precision = 0 : params.precision;   // Lower Boundary Failsafe
+            params.precision > 9 ? params.precision = 9 : params.precision;   // Upper Boundary Failsafe
+
+        } else if (!strcmp(argv[i],"-z")) {
+            params.trimZeros = atoi(argv[i+1]) ? 1 : 0;                 // Update the trailing zeros
+
+        } else if (!strcmp(argv[i],"--nm")) {
+            params.nanometers = atoi(argv[i+1]) ? 1 : 0;                // Update the nanometer engine
+
+        } else if (!strcmp(argv[i],"--outline")) {
+            params.outline = atoi(argv[i+1]) ? 1 : 0;                   // Update the copper polygons
+
+        } else if (!strcmp(argv[i],"--stats")) {
+            stats = !strcmp(argv[i+1],"json");                          // Update the run report
+
+        } else if (!strcmp(argv[i],"--progress")) {
+            showProgress = atoi(argv[i+1]) ? 1 : 0;                     // Update the progress output
+
+        } else if (!strcmp(argv[i],"-k")) {
+            boardName = argv[i+1];                                      // Update the board
+
+        } else if (!strcmp(argv[i],"-g")) {
+            params.tag = argv[i+1];                                     // Update the tag
+            strchr(params.tag,'"') != NULL ? params.tag = "coil" : params.tag;   // Failsafe for the group name
+
+        } else if (!strcmp(argv[i],"--layout")) {
+            params.layout = !strcmp(argv[i+1],"linear") ? 1 : (!strcmp(argv[i+1],"grid") ? 2 : 0);   // Update the layout
+
+        } else if (!strcmp(argv[i],"--cols")) {
+            params.columns = atoi(argv[i+1]);                           // Update the columns
+            params.columns < 0 ? params.columns = 0 : params.columns;   // Failsafe for columns
+
+        } else if (!strcmp(argv[i],"--pitch-x")) {
+            params.pitchX = atof(argv[i+1]);                            // Update the column pitch
+
+        } else if (!strcmp(argv[i],"--pitch-y")) {
+            params.pitchY = atof(argv[i+1]);                            // Update the row pitch
+
+        } else if (!strcmp(argv[i],"--alternate")) {
+            params.alternate = atoi(argv[i+1]) ? 1 : 0;                 // Update the alternating direction
+
+        } else if (!strcmp(argv[i],"--cache")) {
+            cacheDir = argv[i+1];                                       // Update the cache directory
+
+        } else if (!strcmp(argv[i],"--sides")) {
+            params.sides = atoi(argv[i+1]);                             // Update the sides of the polygon
+            params.sides < 3 ? params.sides = 3 : params.sides;         // Lower Boundary Failsafe
+
+        } else if (!strcmp(argv[i],"--chamfer")) {
+            params.chamfer = atof(argv[i+1]);                           // Update the corner cut
+            params.chamfer < 0 ? params.chamfer = 0 : params.chamfer;   // Lower Boundary Failsafe
+
+        } else if (!strcmp(argv[i],"--fillet")) {
+            params.fillet = atof(argv[i+1]);                            // Update the corner radius
+            params.fillet < 0 ? params.fillet = 0 : params.fillet;      // Lower Boundary Failsafe
+
+        } else if (!strcmp(argv[i],"--copper")) {
+            copper = atof(argv[i+1]);                                   // Update the copper thickness
+            copper < 0 ? copper = 0 : copper;                           // Lower Boundary Failsafe
+
+        } else if (!strcmp(argv[i],"--clearance")) {
+            clearance = atof(argv[i+1]);                                // Update the minimum clearance
+            clearance < 0 ? clearance = 0 : clearance;                  // Lower Boundary Failsafe
+
+        } else if (!strcmp(argv[i],"--strict")) {
+            strict = atoi(argv[i+1]) ? 1 : 0;                           // Update the failing on violations
+
+        } else if (!strcmp(argv[i],"--footprint")) {
+            formats.files[0] = argv[i+1];                               // Update the footprint file
+
+        } else if (!strcmp(argv[i],"--svg")) {
+            formats.files[1] = argv[i+1];                               // Update the SVG preview file
+
+        } else if (!strcmp(argv[i],"--dxf")) {
+            formats.files[2] = argv[i+1];                               // Update the DXF drawing file
+
+        } else if (!strcmp(argv[i],"--field")) {
+            fieldSpec = argv[i+1];                                      // Update the field map
+
+        } else if (!strcmp(argv[i],"--field-out")) {
+            fieldFile = argv[i+1];                                      // Update the field map file
+
+        } else if (!strcmp(argv[i],"--sweep") || !strcmp(argv[i],"--max-radius") || !strcmp(argv[i],"--target-l") || !strcmp(argv[i],"--target-r")) {
+            // Ranges and constraints of the sweep (sweepRun), the parameters of the winner come after them
+
+        } else if (!strcmp(argv[i],"-j")) {
+            params.threads = atoi(argv[i+1]);                           // Update the threads
+            params.threads < 1 ? params.threads = sysconf(_SC_NPROCESSORS_ONLN) : params.threads;   // All cores Failsafe
+            params.threads < 1 ? params.threads = 1 : params.threads;   // Lower Boundary Failsafe
 
         } else if (!strcmp(argv[i],"-h")) {
             // Print out help statement
             printf(" Usage: %s flags parameters\n\r",argv[0]);
             printf(" --------------------------------------------- \n");
-            printf("\t-f file_address\t(Default ./coil_text)\n\t-m mode\t\t(Default 0)\n\t-c count\t(Default 1)\n\t-t turns\t(Default 10)\n\t-i innerRadius\t(Default 0)\n\t-s spacing\t(Default 0.25)\n\t-x start_X\t(Default 0)\n\t-y start_Y\t(Default 0)\n\t-l layers\t(Default 1)\n\t-d direction(±1)(Default 1)\n\t-r rotation\t(Default 0 radians)\n\t-w width\t(Default 0.25)\n\t-n netID\t(Default 0)\n\t-v viaSize\t(Default 0.8)\n\t-p resolution\t(Default 0.01, lower better but slower)\n\t-h help\n\r");
+            printf("\t-f file_address\t(Default ./coil_text)\n\t-m mode\t\t(Default 0)\n\t-c count\t(Default 1)\n\t-t turns\t(Default 10)\n\t-i innerRadius\t(Default 0)\n\t-s spacing\t(Default 0.25)\n\t-x start_X\t(Default 0)\n\t-y start_Y\t(Default 0)\n\t-l layers\t(Default 1)\n\t-d direction(±1)(Default 1)\n\t-r rotation\t(Default 0 radians)\n\t-w width\t(Default 0.25)\n\t-n netID\t(Default 0)\n\t-v viaSize\t(Default 0.8)\n\t-p resolution\t(Default 0.01, lower better but slower)\n\t-e tolerance\t(Default 0, adaptive step off)\n\t-a arcTolerance\t(Default 0, arcs off)\n\t-q precision\t(Default 6 decimals)\n\t-z trimZeros\t(Default 0, keep zeros)\n\t--stats json\t(Default none, run report)\n\t--progress 0/1\t(Default 1)\n\t-j threads\t(Default 1, 0 uses all cores)\n\t-b jobFile\t(Default none, one coil per line)\n\t-k board\t(Default none, patch a kicad_pcb in place)\n\t-g tag\t\t(Default coil, group of the items)\n\t--layout type\t(Default circle, linear or grid)\n\t--cols columns\t(Default 0, square grid)\n\t--pitch-x pitch\t(Default 0, coils next to each other)\n\t--pitch-y pitch\t(Default 0, coils next to each other)\n\t--alternate 0/1\t(Default 0, same direction)\n\t--cache dir\t(Default none, reuse generated coils)\n\t--sides sides\t(Default 4, polygon of mode 1)\n\t--chamfer cut\t(Default 0, sharp corners)\n\t--fillet radius\t(Default 0, sharp corners)\n\t--copper thick\t(Default 0, analysis off)\n\t--clearance min\t(Default 0, check off)\n\t--strict 0/1\t(Default 0, report violations)\n\t--sweep ranges\t(Default none, t=min:max:step,w=...)\n\t--max-radius r\t(Default 0, sweep without limit)\n\t--target-l uH\t(Default 0, sweep best L/R)\n\t--target-r ohm\t(Default 0, sweep best L/R)\n\t--footprint mod\t(Default none, .kicad_mod with pads)\n\t--svg file\t(Default none, SVG preview)\n\t--dxf file\t(Default none, DXF drawing)\n\t--nm 0/1\t(Default 0, float engine)\n\t--server path\t(Default none, - for stdin)\n\t--outline 0/1\t(Default 0, tracks)\n\t--field grid\t(Default none, x=min:max:step,y=...,z=...)\n\t--field-out file(Default ./coil_field.csv, .bin binary)\n\t-h help\n\r");
             printf(" --------------------------------------------- \n");
             printf(" The order of the inputs does not matter\n\r");
             return 0;
@@ -218,24 +1087,91 @@ int main(int argc, char *argv[]) {
             printf("\n\rThe program has encountered an error in the parameters.\nThe program will continue with all the correct parameters.\nPlease make sure that all parameters.\n");
             printf(" Usage: %s flags parameters\n\r",argv[0]);
             printf(" --------------------------------------------- \n");
-            printf("\t-f file_address\t(Default ./coil_text)\n\t-m mode\t\t(Default 0)\n\t-c count\t(Default 1)\n\t-t turns\t(Default 10)\n\t-i innerRadius\t(Default 0)\n\t-s spacing\t(Default 0.25)\n\t-x start_X\t(Default 0)\n\t-y start_Y\t(Default 0)\n\t-l layers\t(Default 1)\n\t-d direction(±1)(Default 1)\n\t-r rotation\t(Default 0 radians)\n\t-w width\t(Default 0.25)\n\t-n netID\t(Default 0)\n\t-v viaSize\t(Default 0.8)\n\t-p resolution\t(Default 0.01, lower better but slower)\n\t-h help\n\r");
+            printf("\t-f file_address\t(Default ./coil_text)\n\t-m mode\t\t(Default 0)\n\t-c count\t(Default 1)\n\t-t turns\t(Default 10)\n\t-i innerRadius\t(Default 0)\n\t-s spacing\t(Default 0.25)\n\t-x start_X\t(Default 0)\n\t-y start_Y\t(Default 0)\n\t-l layers\t(Default 1)\n\t-d direction(±1)(Default 1)\n\t-r rotation\t(Default 0 radians)\n\t-w width\t(Default 0.25)\n\t-n netID\t(Default 0)\n\t-v viaSize\t(Default 0.8)\n\t-p resolution\t(Default 0.01, lower better but slower)\n\t-e tolerance\t(Default 0, adaptive step off)\n\t-a arcTolerance\t(Default 0, arcs off)\n\t-q precision\t(Default 6 decimals)\n\t-z trimZeros\t(Default 0, keep zeros)\n\t--stats json\t(Default none, run report)\n\t--progress 0/1\t(Default 1)\n\t-j threads\t(Default 1, 0 uses all cores)\n\t-b jobFile\t(Default none, one coil per line)\n\t-k board\t(Default none, patch a kicad_pcb in place)\n\t-g tag\t\t(Default coil, group of the items)\n\t--layout type\t(Default circle, linear or grid)\n\t--cols columns\t(Default 0, square grid)\n\t--pitch-x pitch\t(Default 0, coils next to each other)\n\t--pitch-y pitch\t(Default 0, coils next to each other)\n\t--alternate 0/1\t(Default 0, same direction)\n\t--cache dir\t(Default none, reuse generated coils)\n\t--sides sides\t(Default 4, polygon of mode 1)\n\t--chamfer cut\t(Default 0, sharp corners)\n\t--fillet radius\t(Default 0, sharp corners)\n\t--copper thick\t(Default 0, analysis off)\n\t--clearance min\t(Default 0, check off)\n\t--strict 0/1\t(Default 0, report violations)\n\t--sweep ranges\t(Default none, t=min:max:step,w=...)\n\t--max-radius r\t(Default 0, sweep without limit)\n\t--target-l uH\t(Default 0, sweep best L/R)\n\t--target-r ohm\t(Default 0, sweep best L/R)\n\t--footprint mod\t(Default none, .kicad_mod with pads)\n\t--svg file\t(Default none, SVG preview)\n\t--dxf file\t(Default none, DXF drawing)\n\t--nm 0/1\t(Default 0, float engine)\n\t--server path\t(Default none, - for stdin)\n\t--outline 0/1\t(Default 0, tracks)\n\t--field grid\t(Default none, x=min:max:step,y=...,z=...)\n\t--field-out file(Default ./coil_field.csv, .bin binary)\n\t-h help\n\r");
             printf(" --------------------------------------------- \n");
             printf(" The order of the inputs does not matter\n\r");
         }
     }
 
+    // The nanometer engine writes whole nanometers (6 decimals of mm), unless -q asks for other digits
+    if (params.nanometers && !precisionGiven) params.precision = 6;
+
+    // The json report replaces all the other messages, the jobs of a batch print none
+    result != NULL ? stats = 0 : stats;
+    int verbose = !stats && result == NULL;
+    showProgress = showProgress && verbose;
+
+    // A tiny -e makes the steps far shorter than the uniform steps of -p, so it is raised to a fraction of -p
+    if (params.tolerance > 0 && params.tolerance < params.resolution*TOLERANCE_FRACTION) {
+        if (verbose) printf("Note: -e %g is raised to %g (%g of -p).\n\r", params.tolerance, params.resolution*TOLERANCE_FRACTION, TOLERANCE_FRACTION);
+        params.tolerance = params.resolution*TOLERANCE_FRACTION;
+    }
+
+    // The same for -a: the pieces of the arcs are not halved below 1e-6, so a tinier -a could never be met
+    if (params.arcTolerance > 0 && params.arcTolerance < params.resolution*TOLERANCE_FRACTION) {
+        if (verbose) printf("Note: -a %g is raised to %g (%g of -p).\n\r", params.arcTolerance, params.resolution*TOLERANCE_FRACTION, TOLERANCE_FRACTION);
+        params.arcTolerance = params.resolution*TOLERANCE_FRACTION;
+    }
+
+    // Fewer digits than whole nanometers round the snapped coordinates again
+    if (params.nanometers && params.precision < 6 && verbose) printf("Warning: -q %d with --nm, the coordinates are rounded to %d decimals, not whole nanometers.\n\r", params.precision, params.precision);
+
+    // Grid and currents of the field map
+    CoilGrid grid;
+    double fieldCurrent = 1, fieldAngle = 0;
+    int fieldPhases = 1;
+    int fieldError = fieldSpec != NULL ? fieldParse(fieldSpec, &grid, &fieldCurrent, &fieldPhases, &fieldAngle) : 0;
+    if (fieldError) {
+        fieldError == 2 ? printf("Error: the field map has more than %d points!\n\r", FIELD_POINTS) : printf("Error: the field map is not x=min:max:step,y=...,z=... (i, p or a)!\n\r");
+        return(1);
+    }
+
+    // Time spent parsing the arguments
+    double timeParse = coilNow() - timeBegin;
+
+    // Candidate of the sweep, only evaluated
+    if (result != NULL && result->evaluate) {
+        int status = coilEvaluate(&params, copper, clearance, &buffers->coil, result);
+        result->time = coilNow() - timeBegin;
+        return status;
+    }
     /* --- End of ARGUMENTS --- */
 
     /* --- kicad_pcb Footprint File --- */
     /* Open or create a new file in write mode to write all the segment and via coordinates.
      * IF THE DOCUMENT ALREADY HAVE DATA IN IT, IT WILL BE OVERWRITTEN.
+     * A board (-k) is patched instead: the items are written into the board itself, replacing the
+     * items generated before with the same tag (-g).
      */
 
     // Create a file variable
     FILE *fp;
 
-    // Open the file in write mode
-    fp = fopen(filename,"w");
+    // Hash of the tag starting the uuids of the generated items
+    unsigned long long tag = coilTagHash(params.tag);
+
+    // Board to patch
+    Board board = {NULL, NULL, NULL, 0, 0, 0, NULL};
+
+    // The server keeps the records in memory instead of a file
+    int streamed = result != NULL && result->stream != NULL;
+
+    if (boardName != NULL) {
+        // Copy the board without the items generated before
+        int status = boardOpen(&board, boardName, tag);
+        if (status) {
+            status == 2 ? printf("Error: %s is not a kicad_pcb file!\n\r", boardName) : printf("Error opening kicad_pcb file! kicad_pcb file address entered wrong!\n\r");
+            return(1);
+        }
+        fp = board.fp;
+    } else if (streamed) {
+        // The server takes the records from its own stream
+        fp = result->stream;
+        result->stream = NULL;
+    } else {
+        // Open the file in write mode
+        fp = fopen(filename,"w");
+    }
 
     // Check if the file opened
     if (fp == NULL) {
@@ -243,343 +1179,1318 @@ int main(int argc, char *argv[]) {
         return(1);             
     }
 
-    // Set the cursor to the very beginning of the file
-    fseek(fp, 0, SEEK_SET);
-    /* --- End of kicad_pcb Footprint File --- */
+    // The file is only written in large blocks from the output buffer (memory streams keep their own)
+    streamed ? 0 : setvbuf(fp, NULL, _IONBF, 0);
 
-    /* --- Start & End Positions ---  */
+    // Set the cursor to the very beginning of the file (after the copied part of a board)
+    boardName == NULL ? fseek(fp, 0, SEEK_SET) : 0;
+
+    // Create the output buffer (kept between runs)
+    buffers->buffer == NULL ? buffers->buffer = malloc(WRITER_SIZE) : 0;
+    CoilWriter writer = {fp, buffers->buffer, WRITER_SIZE, 0, 0, params.precision, params.trimZeros, 0, 0};
+    if (writer.buffer == NULL) {
+        printf("Error allocating the output buffer!\n\r");
+        if (boardName != NULL) {
+            boardAbort(&board);
+        } else {
+            fclose(fp);
+        }
+        return(1);
+    }
 
-    // Create a variable to hold the number of Vias inside the coil.
-    int innerVias = 1;  // At least one layer means at least one via
+    // Open the other formats
+    if (formatsOpen(&formats, &params)) {
+        if (boardName != NULL) {
+            boardAbort(&board);
+        } else {
+            fclose(fp);
+        }
+        return(1);
+    }
+    /* --- End of kicad_pcb Footprint File --- */
 
-    // Calculate the number of vias needed inside the coil for the amount of copper layers
-    layers > 2 ? innerVias = ceilf((float)(layers-0.5)/2): innerVias;
+    /* --- GENERATE COIL --- */
+    /* Generate the coils with the given parameters (coilGenerate). The records of each
+     * work unit are formatted by the generator (coilKicadFormat) and appended to the
+     * output buffer of the file in order by the sink of the command line (outputWrite).
+     */
 
-    // Calculate the amount of vias needed outside of the coils for the amount of copper layers
-    int outerVias = innerVias-1;
+    // Inner radius of each coil, a circle of coils moves it to the motor radius
+    float innerRadius = params.count > 1 && params.layout == 0 ? 0.00 : params.innerRadius;
 
-    // Calculate the gap between the vias
-    float viaGap = (float)1/2; // With one via, only 1/2 ratio is needed
+    // Print out the User Parameters used to create the coils.
+    if (verbose) {
+        printf("\n --- Parameters Entered: --- \n");
+        printf("Mode:\t\t%d\nCount:\t\t%d\nTurns:\t\t%.3f\nInner Radius:\t%.3f\nSpacing:\t%.3f\nStart_X:\t%.3f\nStart_Y:\t%.3f\nLayers:\t\t%d\nDirection:\t%d\nRotation:\t%.3f\nWidth:\t\t%.3f\nnetID:\t\t%d\nviaSize:\t%.3f\nresolution:\t%.3f\ntolerance:\t%.3f\narcTolerance:\t%.3f\n\r",params.mode,params.count,params.turns,innerRadius,params.spacing,params.startX,params.startY,params.layers,params.direction,params.rotate,params.width,params.netID,params.viaSize,params.resolution,params.tolerance,params.arcTolerance);
+        params.mode == 1 ? printf("Sides:\t\t%d\nChamfer:\t%.3f\nFillet:\t\t%.3f\n\r",params.sides,params.chamfer,params.fillet) : 0;
+        printf(" --------------------------- \n");
+
+        // Print out the loading screen
+        printf("\n --- Generating Coils --- \n");
+    }
 
-    // More than one layers require at least 2/3 ratio
-    layers > 2 ? viaGap = (float)2/3 : viaGap;
+    // Generate the coils into the output buffer (through the cache when given), the other formats from the same items
+    CoilList local = {NULL, 0, 0};
+    CoilList *items = result != NULL && result->items != NULL ? result->items : &local;
+    CoilList *list = copper > 0 || clearance > 0 || fieldSpec != NULL || items != &local ? items : NULL;
+    Output output = {&writer, NULL, list, clearance > 0 || fieldSpec != NULL || items != &local ? params.count : 1, 0, verbose, showProgress, -1};
+    CoilSink sink = {&output, coilKicadFormat, outputWrite};
+    CoilOutline outline = {&params, &sink, NULL, 0, 0, 0, NULL, 0, 0, {NULL, NULL, 0, 0, 0, 0, 0, 0, 0}, 0, 0};
+    CoilSink outlineSink = {&outline, coilOutlineFormat, coilOutlineWrite};
+    CoilFanout fanout = {&params, params.outline ? &outlineSink : &sink, formats.outputs, formats.count};
+    CoilSink fanoutSink = {&fanout, coilFanoutFormat, coilFanoutWrite};
+    const CoilSink *generate = formats.count > 0 ? &fanoutSink : (params.outline ? &outlineSink : &sink);
+    CoilStats counters;
+    const char *cached = "off";
+    int status = cacheDir != NULL ? cacheRun(cacheDir, &params, generate, &output, &buffers->coil, &counters, &cached) : coilGenerate(&params, generate, &buffers->coil, &counters);
+
+    // A copper polygon that could not be written fails the file
+    outline.text.error ? writer.error = 1 : 0;
+    coilOutlineFree(&outline);
+
+    if (status == 1) {
+        printf("Error allocating the output buffer!\n\r");
+        if (boardName != NULL) {
+            boardAbort(&board);
+        } else {
+            fclose(fp);
+        }
+        formatsClose(&formats, 0);
+        coilStatsFree(&counters);
+        free(local.items);
+        return(1);
+    }
 
-    // Set the innerRadius according to the coil count
-    if (count > 1) {
-        motorRadius = innerRadius;
-        innerRadius = 0.00;
+    // Copper polygons written instead of the tracks, one for each coil and layer with tracks
+    int polygons = 0;
+    for (int n = 0; params.outline && n < params.count * params.layers; n++) {
+        polygons += counters.tracks[n] > 0;
     }
 
-    // Calculate the start and end factors
-    float start = innerRadius + viaSize * innerVias * viaGap;    // Start Position
-    float end = turns * spacing + start;    // End Position
+    // Items of the analysis, the clearance check and the other formats replayed from the geometry after a file hit of the cache
+    CoilSink collect = {&output, NULL, listWrite};
+    CoilFanout collectFanout = {&params, &collect, formats.outputs, formats.count};
+    CoilSink replay = {&collectFanout, NULL, coilFanoutWrite};
+    int replayed = !strcmp(cached, "file") && (output.list != NULL || formats.count > 0);
+    int replayFailed = replayed && coilCacheGenerate(cacheDir, &params, &replay, &buffers->coil, NULL);
+    for (int n = 0; replayFailed && n < formats.count; n++) {
+        formats.outputs[n].writer->error = 1;
+    }
+    int missing = output.list == NULL || output.listFailed || replayFailed;
 
-    //motorRadius == 0 ? motorRadius = end : motorRadius;
-    /* --- End of Start & End Positions --- */
+    // Length, resistance and inductance of the coil
+    CoilAnalysis analysis = {0, NULL, NULL, NULL, 0, 0, 0, 0, 0, 0};
+    int analyzed = copper > 0 && !missing && !coilAnalyze(items->items, items->count, params.layers, copper, BOARD_THICKNESS, params.threads, &analysis);
 
-    /* --- ANGLE --- */
-    /* Calculate the angle difference between the original spiral and the spaced one.
-     * Adjust the angle direction according to the final y position on the spaced coil.
-     * Include the user rotation into the coil angle.
-     */
+    // Copper of the tracks and vias closer than the clearance
+    CoilClearance check = {0, 0, NULL, 0, 0, 0, 0};
+    int checked = clearance > 0 && !missing && !coilClearance(items->items, items->count, params.layers, clearance, VIOLATIONS, &check);
 
-    // Find the start coordinates of the initial spiral
-    float xInit = end;
-    float yInit = 0;
+    // Magnetic field of all the coils, each with the current of its phase
+    CoilField field = {0, NULL, 0, 0};
+    double *currents = fieldSpec != NULL ? malloc(params.count * sizeof(double)) : NULL;
+    for (int k = 0; currents != NULL && k < params.count; k++) {
+        currents[k] = fieldCurrent * cos(fieldAngle - 2*M_PI*k/fieldPhases);
+    }
+    int mapped = currents != NULL && !missing && !coilField(items->items, items->count, params.layers, BOARD_THICKNESS, currents, params.count, &grid, params.threads, &field);
+    size_t fieldBytes = 0;
+    int fieldFailed = fieldSpec != NULL && (!mapped || fieldWrite(fieldFile, &grid, &field, &params, &fieldBytes));
+    float fieldMax = 0;
+    for (long p = 0; mapped && p < field.points; p++) {
+        const float *b = &field.b[3*p];
+        float magnitude = sqrtf(b[0]*b[0] + b[1]*b[1] + b[2]*b[2]);
+        magnitude > fieldMax ? fieldMax = magnitude : 0;
+    }
+    free(currents);
+    free(local.items);
+
+    if (verbose) {
+        printf(" ------------------------ \n");
+        printf("End of generating coils.\n\r");
+
+        // Report if the coils came from the cache
+        if (cacheDir != NULL) {
+            !strcmp(cached, "file") ? printf("Cache: hit, records copied from %s\n\r", cacheDir) : 0;
+            !strcmp(cached, "geometry") ? printf("Cache: hit, geometry reused from %s\n\r", cacheDir) : 0;
+            !strcmp(cached, "miss") ? printf(access(cacheDir, W_OK) ? "Cache: miss, %s cannot be written\n\r" : "Cache: miss, added to %s\n\r", cacheDir) : 0;
+        }
+        printf("\nThe total radius of the coil is: %.2f (system units)\n\r", counters.outerRadius);
+        printf("The total motor radius is: %.2f (system units)\n\n\r", counters.motorRadius);
+        // The outline replaces the segments and arcs with one polygon for each coil and layer
+        if (params.outline) {
+            printf("Copper polygons written: %d\n\r", polygons);
+        } else {
+            printf("Wire segments written: %d\n\r", counters.segments);
+            params.arcTolerance > 0 ? printf("Arcs written: %d\n\r", counters.arcs) : 0;
+        }
 
-    // Find the start coordinates of the spaced spiral
-    float xSpaced = cos(2*M_PI*xInit/spacing)*xInit;
-    float ySpaced = sin(2*M_PI*xInit/spacing)*xInit;
+        // Report the accuracy achieved by the adaptive step size or the arcs
+        if (params.tolerance > 0 || params.arcTolerance > 0) {
+            printf("Maximum deviation from the spiral: %f (system units)\n\n\r", counters.deviation);
+        }
 
-    // Create an angle variable to calculate the angle difference between a normal spiral and a spacing adjusted one
-    float angle = acosf( ( (xInit * xSpaced) + (yInit * ySpaced) ) / ( sqrt( powf(xInit,2) + powf(yInit,2) ) * sqrt( powf(xSpaced,2) + powf(ySpaced,2) ) ) );
+        // Report the length, resistance and inductance of a coil
+        if (copper > 0) {
+            if (analyzed) {
+                printf("\n --- Analysis (one coil, %.3f copper, %.2f board): --- \n", copper, BOARD_THICKNESS);
+                for (int i = 0; i < params.layers; i++) {
+                    printf("Layer %d:\tlength %.3f\tresistance %.4f ohm\tinductance %.4f uH\n", i, analysis.length[i], analysis.resistance[i], analysis.inductance[i*params.layers + i]*1e6);
+                }
+                for (int i = 0; i < params.layers; i++) {
+                    for (int j = i+1; j < params.layers; j++) {
+                        printf("Mutual %d-%d:\t%.4f uH\n", i, j, analysis.inductance[i*params.layers + j]*1e6);
+                    }
+                }
+                printf("Total (layers in series):\tlength %.3f\tresistance %.4f ohm\tinductance %.4f uH\n", analysis.totalLength, analysis.totalResistance, analysis.totalInductance*1e6);
+                printf("Analysis time: %.3f s (%d filaments)\n\r", analysis.time, analysis.filaments);
+            } else {
+                printf("Error allocating the analysis of the coil!\n\r");
+            }
+        }
 
-    // Adjust the angle orientation according to spacing adjusted y-coordinate
-    ySpaced < 0 ? angle *= -1 : angle;
+        // Report the clearance violations, the smallest clearances first
+        if (clearance > 0) {
+            const char *kinds[] = {"track", "arc", "via", "via connection"};
+            if (!checked) {
+                printf("Error allocating the clearance check!\n\r");
+            } else if (check.violations == 0) {
+                printf("\nClearance: no copper closer than %.3f (%d shapes, %.3f s)\n\r", clearance, check.shapes, check.time);
+            } else {
+                printf("\nClearance: %ld violations below %.3f, smallest %.4f (%d shapes, %.3f s)\n", check.violations, clearance, check.smallest, check.shapes, check.time);
+                for (int v = 0; v < check.listed; v++) {
+                    const CoilViolation *violation = &check.list[v];
+                    printf(" - %.4f at (%.3f, %.3f) ", violation->clearance, violation->at[0], violation->at[1]);
+                    violation->layer >= 0 ? printf("layer %d: ", violation->layer) : printf("vias: ");
+                    printf("%s of coil %d, %s of coil %d\n", kinds[violation->kind[0]], violation->coil[0]+1, kinds[violation->kind[1]], violation->coil[1]+1);
+                }
+                printf("\r");
+            }
+        }
 
-    // Adjust the angle according to user's rotation preference
-    //angle += rotate;    // In radians
-    /* --- End of ANGLE --- */
+        // Report the field map
+        if (fieldSpec != NULL) {
+            if (!mapped) {
+                printf("Error allocating the field map!\n\r");
+            } else if (fieldFailed) {
+                printf("Error writing the field map into %s!\n\r", fieldFile);
+            } else {
+                printf("\nField map: %ld points, %ld current elements, largest %.3f uT (%.3f s)\n\r", field.points, field.elements, fieldMax, field.time);
+                printf("Field map written into %s (%zu bytes)\n\r", fieldFile, fieldBytes);
+            }
+        }
+    }
+    /* --- End of GENERATE COIL --- */
 
-    /* --- GENERATE COIL --- */
-    /* Generate the coils with the given parameters per each layer.
-     * Every two layers is rotated with an angle (viaAngle) associated with the 
-     * number of layers. This ensures for better placement of vias and better wiring.
+    /* --- DISPLAY --- */
+    /* Display any additional information.
      */
 
-    // Print out the User Parameters used to create the coils.
-    printf("\n --- Parameters Entered: --- \n");
-    printf("Mode:\t\t%d\nCount:\t\t%d\nTurns:\t\t%.3f\nInner Radius:\t%.3f\nSpacing:\t%.3f\nStart_X:\t%.3f\nStart_Y:\t%.3f\nLayers:\t\t%d\nDirection:\t%d\nRotation:\t%.3f\nWidth:\t\t%.3f\nnetID:\t\t%d\nviaSize:\t%.3f\nresolution:\t%.3f\n\r",mode,count,turns,innerRadius,spacing-width,startX,startY,layers,direction,rotate,width,netID,viaSize,resolution);
-    printf(" --------------------------- \n");
-
-    // Print out the loading screen
-    printf("\n --- Generating Coils --- \n");
+    // Give a warning message to warn the user for adjusting the number of copper layers on KiCAD
+    if (params.layers > 2 && verbose) {
+        printf("\n\rYou have selected more than 2 copper layers.\n\rPlease make sure to change the number of copper layers on KiCAD and make sure the copper layer names matches.\n\n\r");
+    }
+    /* --- End of DISPLAY --- */
 
-    // Step size of the coil generator
-    float step = ( (float)resolution / (start) / turns * 2 );
+    // Fail on clearance violations before the board is patched
+    if (strict && clearance > 0 && (!checked || check.violations > 0)) {
+        printf("Error: clearance check failed, %s not written!\n\r", boardName != NULL ? boardName : filename);
+        if (boardName != NULL) {
+            boardAbort(&board);
+        } else {
+            fclose(fp);
+            streamed ? 0 : remove(filename);
+        }
+        formatsClose(&formats, 0);
+        coilStatsFree(&counters);
+        coilAnalysisFree(&analysis);
+        coilClearanceFree(&check);
+        coilFieldFree(&field);
+        return(1);
+    }
 
-    // Calculate the angle between the via positions for different layer combinations
-    float viaAngle = ( 2*M_PI ) / ( innerVias );
+    // Write the rest of the output buffer and close the File
+    if (boardName != NULL) {
+        // Group the items and finish the board
+        groupWrite(&writer, params.tag, tag, params.count, params.layers, counters.tracks, counters.coilVias, counters.coilLinks, params.outline);
+        boardClose(&board, &writer) ? writer.error = 1 : 0;
 
-    // Initialize the Position Arrays
-    float xPos[count][layers][(int)((end+(layers-1)*viaAngle*(spacing)/(2*M_PI)-start)/step + 1)];
-    float yPos[count][layers][(int)((end+(layers-1)*viaAngle*(spacing)/(2*M_PI)-start)/step + 1)];
+        if (verbose && !writer.error) {
+            printf("Patched %s: %d items generated before with the tag \"%s\" replaced.\n\r", boardName, board.removed, params.tag);
+        }
+    } else {
+        coilWriterFlush(&writer);
+        fclose(fp);
+    }
 
-    // Dummy variables for the loop
-    float x, coilInitX, coilInitY, coilFixedX, coilFixedY, coilAngledX, coilAngledY;
+    // Finish the other formats
+    int formatsFailed = formatsClose(&formats, 1);
+    if (verbose && !formatsFailed) {
+        const char *names[3] = {"Footprint", "SVG preview", "DXF drawing"};
+        for (int f = 0; f < 3; f++) {
+            formats.fp[f] != NULL ? printf("%s written into %s (%zu bytes)\n\r", names[f], formats.files[f], formats.writers[f].written) : 0;
+        }
+    }
 
-    // Layer Adjuster
-    int layerCode;
+    /* --- REPORT --- */
+    /* Print out the machine readable run report: the time of each phase,
+     * the counters of each layer, the bytes written and the peak memory.
+     */
+    if (stats) {
+        printf("{\"parameters\": {\"mode\": %d, \"sides\": %d, \"count\": %d, \"turns\": %g, \"innerRadius\": %g, \"spacing\": %g, \"layers\": %d, \"width\": %g, \"viaSize\": %g, \"resolution\": %g, \"tolerance\": %g, \"arcTolerance\": %g, \"threads\": %d},\n", params.mode, params.mode == 1 ? params.sides : 0, params.count, params.turns, innerRadius, params.spacing, params.layers, params.width, params.viaSize, params.resolution, params.tolerance, params.arcTolerance, params.threads);
+        printf(" \"phases\": {\"parse\": %.6f, \"generate\": %.6f, \"vias\": %.6f, \"write\": %.6f, \"total\": %.6f},\n", timeParse, counters.timeGenerate, counters.timeVias, writer.time, coilNow() - timeBegin);
+        printf(" \"layers\": [");
+        for (int i = 0; i < params.layers; i++) {
+            printf("%s{\"layer\": %d, \"points\": %ld, \"segments\": %ld, \"arcs\": %ld}", i ? ", " : "", i, counters.layerPoints[i], counters.layerSegments[i], counters.layerArcs[i]);
+        }
+        printf("],\n");
+        printf(" \"segments\": %d, \"arcs\": %d, \"vias\": %d, \"maxDeviation\": %g, \"outerRadius\": %g, \"motorRadius\": %g,\n", counters.segments, counters.arcs, counters.vias, counters.deviation, counters.outerRadius, counters.motorRadius);
+        if (analyzed) {
+            printf(" \"analysis\": {\"copper\": %g, \"board\": %g, \"length\": %g, \"resistance\": %g, \"inductance\": %g, \"time\": %.6f, \"filaments\": %d, \"layers\": [", copper, BOARD_THICKNESS, analysis.totalLength, analysis.totalResistance, analysis.totalInductance, analysis.time, analysis.filaments);
+            for (int i = 0; i < params.layers; i++) {
+                printf("%s{\"layer\": %d, \"length\": %g, \"resistance\": %g, \"inductance\": [", i ? ", " : "", i, analysis.length[i], analysis.resistance[i]);
+                for (int j = 0; j < params.layers; j++) {
+                    printf("%s%g", j ? ", " : "", analysis.inductance[i*params.layers + j]);
+                }
+                printf("]}");
+            }
+            printf("]},\n");
+        }
+        if (checked) {
+            printf(" \"clearance\": {\"minimum\": %g, \"violations\": %ld, \"smallest\": %g, \"time\": %.6f, \"shapes\": %d, \"list\": [", clearance, check.violations, check.violations ? check.smallest : clearance, check.time, check.shapes);
+            for (int v = 0; v < check.listed; v++) {
+                printf("%s{\"clearance\": %g, \"x\": %g, \"y\": %g, \"layer\": %d, \"coils\": [%d, %d]}", v ? ", " : "", check.list[v].clearance, check.list[v].at[0], check.list[v].at[1], check.list[v].layer, check.list[v].coil[0], check.list[v].coil[1]);
+            }
+            printf("]},\n");
+        }
+        if (fieldSpec != NULL) {
+            printf(" \"field\": {\"file\": \"%s\", \"points\": [%d, %d, %d], \"elements\": %ld, \"current\": %g, \"phases\": %d, \"angle\": %g, \"maxField_uT\": %g, \"time\": %.6f, \"bytesWritten\": %zu, \"error\": %s},\n", fieldFile, grid.points[0], grid.points[1], grid.points[2], field.elements, fieldCurrent, fieldPhases, fieldAngle, fieldMax, field.time, fieldBytes, fieldFailed ? "true" : "false");
+        }
+        if (formats.count > 0) {
+            const char *names[3] = {"footprint", "svg", "dxf"};
+            printf(" \"formats\": [");
+            for (int f = 0, n = 0; f < 3; f++) {
+                formats.fp[f] != NULL ? printf("%s{\"format\": \"%s\", \"file\": \"%s\", \"bytesWritten\": %zu, \"error\": %s}", n++ ? ", " : "", names[f], formats.files[f], formats.writers[f].written, formats.writers[f].error ? "true" : "false") : 0;
+            }
+            printf("],\n");
+        }
+        params.outline ? printf(" \"polygons\": %d,\n", polygons) : 0;
+        printf(" \"bytesWritten\": %zu, \"peakMemoryKiB\": %ld, \"cache\": \"%s\", \"error\": %s}\n", writer.written, peakMemory(), cached, writer.error || formatsFailed ? "true" : "false");
+    }
+    /* --- End of REPORT --- */
+
+    // Counters of the run for the batch
+    if (result != NULL) {
+        result->time = coilNow() - timeBegin;
+        result->segments = counters.segments;
+        result->arcs = counters.arcs;
+        result->vias = counters.vias;
+        result->bytes = writer.written;
+        result->deviation = counters.deviation;
+        result->cache = cached;
+    }
 
-    // Calculate the necessary values to position the outer vias
-    float outViaRad = ( end + viaSize + (float)1/3 );                   // Find the radius at which outer vias are positioned
-    float outViaAngle = ( ( 2 * viaSize + viaGap ) / ( outViaRad ) );   // Calculate the angle needed between each outer via
+    coilStatsFree(&counters);
+    coilAnalysisFree(&analysis);
+    coilClearanceFree(&check);
+    coilFieldFree(&field);
 
-    float outViaAdd = 0;
-    float outViaMult;
+    // Check if everything was written
+    if (writer.error) {
+        printf("Error writing into the kicad_pcb file!\n\r");
+        return(1);
+    }
+    if (formatsFailed || fieldFailed) {
+        return(1);
+    }
 
-    // Calculate the offset angle for each coil in the motor
-    float motorAngle = 2*M_PI/count;
+    // End of the run
+    return 0;
+}
+/* --- End of RUN --- */
 
-    // Calculate the new motorRadius accounting the spacing between coils 
-    count > 1 ? motorRadius += end/cos( ( M_PI - (motorAngle) )/2 ) + spacing : motorRadius;
+/* --- BATCH --- */
 
-    count > 1 ? motorRotate = rotate : motorRotate;
+/* buffersFree
+ * Frees the output buffer and the work units of the runs.
+ *
+ * Parameters:
+ *  -   buffers:    Output buffer and work units to free
+ */
+static void buffersFree(Buffers *buffers) {
+    coilBuffersFree(&buffers->coil);
+    free(buffers->buffer);
+}
 
-    // Repeat for each coil
-    for (int k = 0; k < count; k++) {
-        printf("Coil: %d ...\n", k+1);
+/* batchWorker
+ * Thread of the batch. Runs the next job until all jobs are done, reusing the same
+ * buffers for all of its jobs.
+ *
+ * Parameters:
+ *  -   arg:        Batch of the jobs
+ */
+static void *batchWorker(void *arg) {
+    Batch *batch = arg;
+    Buffers buffers = {NULL, {NULL, 0}};
 
-        // Adjust the starting coordinates for each Coil
-        startX = cos(motorRotate) * motorRadius*cos(motorAngle * (k+1)) + sin(motorRotate)*motorRadius*sin(motorAngle * (k+1));
-        startY = -sin(motorRotate) * motorRadius*cos(motorAngle * (k+1)) + cos(motorRotate) * motorRadius*sin(motorAngle * (k+1));
+    for (;;) {
+        pthread_mutex_lock(&batch->lock);
+        int index = batch->next++;
+        pthread_mutex_unlock(&batch->lock);
 
-        float endX = motorRadius*cos(motorAngle * (count)) + startX + end;
-        float endY = motorRadius*sin(motorAngle * (count)) + startY + end;
+        if (index >= batch->total) {
+            break;
+        }
 
-        // Removed due to division by zero error, needs fixing
-        //rotate = acos(round( (startX * endX + startY * endY) / ( sqrt( pow(startX,2) + pow(startY,2) ) * sqrt( pow(endX,2) + pow(endY,2) ) )*1000 )/1000);
+        Job *job = &batch->jobs[index];
+        job->status = coilRun(job->argc, job->argv, &buffers, &job->result);
+    }
 
-        startY > 0 ? rotate = -rotate : rotate;
+    buffersFree(&buffers);
+    return NULL;
+}
 
-        // Iterate through each copper layer
-        for (int i = 0; i < layers; i++) {
+/* batchThreads
+ * Runs all the jobs of the batch on the given number of threads (or right here with a single thread).
+ * Returns the number of threads used.
+ *
+ * Parameters:
+ *  -   batch:      Jobs to run, from the first one
+ *  -   threads:    Number of jobs run at the same time
+ */
+static int batchThreads(Batch *batch, int threads) {
+    batch->next = 0;
+    threads > batch->total ? threads = batch->total : threads;
+    threads < 1 ? threads = 1 : threads;
+
+    pthread_t *workers = malloc(threads * sizeof(pthread_t));
+    if (threads > 1 && workers != NULL) {
+        for (int t = 0; t < threads; t++) {
+            pthread_create(&workers[t], NULL, batchWorker, batch);
+        }
+        for (int t = 0; t < threads; t++) {
+            pthread_join(workers[t], NULL);
+        }
+    } else {
+        threads = 1;
+        batchWorker(batch);
+    }
 
-            // Print out progress tag
-            printf(" - Progress:\e[s");
+    free(workers);
+    return threads;
+}
 
-            // Adjust the layer numbering for specific end locations required per layer
-            layerCode = floor( i/2 );
+/* batchRun
+ * Runs every line of a job file as a separate coil in one process, on the given number of threads.
+ * A line has the same flags as the command line and lines starting with # are skipped. The other
+ * flags of the command line (besides -b and -j) are the defaults of every job, and a job without
+ * a file (-f) is written into ./coil_text_N, N being the number of the job.
+ * Prints the time and the counters of each job.
+ *
+ * Parameters:
+ *  -   argc:       Number of arguments of the command line
+ *  -   argv:       Arguments of the command line
+ *  -   jobFile:    Address of the job file
+ *  -   threads:    Number of jobs run at the same time
+ *  -   stats:      Print the report as json (1) or text (0)
+ */
+static int batchRun(int argc, char *argv[], const char *jobFile, int threads, int stats) {
+    double timeBegin = coilNow();
 
-            // Only need vias for the in-between layers
-            if (i == 0 || i == layers-1) {
-                outViaAdd = 0;
-            } else {
-                outViaAdd = powf(-1,floorf( ((float)i-0.5)/2 )) * (powf(-1,i) * ceilf( ((float)i) / 2 )/2)*outViaAngle*spacing/(2*M_PI);
-            }
-            
-            // Loop through each step to find the position
-            for (int j = 0; j < (int)(((end+pow(-1, i)*(layerCode)*viaAngle*(spacing)/(2*M_PI) + outViaAdd)-start)/step + 1); j++) {
+    // Read the whole job file
+    FILE *fp = fopen(jobFile, "r");
+    if (fp == NULL) {
+        printf("Error opening the job file!\n\r");
+        return(1);
+    }
 
-                x = j*step + start;   // Respective position (can think of it as x variable in a calculator while plotting this.)
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
 
-                // X & Y coordinate variables for the initial coil with spacing
-                coilInitX = cos(2*M_PI*x/spacing)*x;
-                coilInitY = sin(2*M_PI*x/spacing)*x;
+    char *text = malloc(size + 1);
+    if (text == NULL || fread(text, 1, size, fp) != (size_t)size) {
+        printf("Error reading the job file!\n\r");
+        free(text);
+        fclose(fp);
+        return(1);
+    }
+    text[size] = '\0';
+    fclose(fp);
 
-                // Adjusted X & Y coordinate variables for the angle adjusted coil with spacing
-                coilFixedX = direction * (cos(angle + rotate * pow(-1,i))*coilInitX + sin(angle + rotate * pow(-1,i))*coilInitY);
-                //coilFixedY = pow(-1, i) * (-sin(angle)*coilInitX + cos(angle)*coilInitY);
-                coilFixedY = (-sin(angle + M_PI_2 * (1+pow(-1,i+1)) + rotate * pow(-1,i))*coilInitX + cos(angle + M_PI_2 * (1+pow(-1,i+1))  + rotate * pow(-1,i))*coilInitY);
+    // Count the lines to allocate the jobs
+    int lines = 1;
+    for (long c = 0; c < size; c++) {
+        text[c] == '\n' ? lines++ : 0;
+    }
 
-                // Correctly orient the coil on each layer to have a nice via layout
-                coilAngledX = cos((layerCode)*viaAngle)*coilFixedX + sin((layerCode)*viaAngle)*coilFixedY;
-                coilAngledY = -sin((layerCode)*viaAngle)*coilFixedX + cos((layerCode)*viaAngle)*coilFixedY;
+    Batch batch;
+    batch.jobs = calloc(lines, sizeof(Job));
+    batch.total = 0;
+    batch.next = 0;
+    pthread_mutex_init(&batch.lock, NULL);
+
+    // Split each line into the arguments of a job
+    char *next = text, *saved;
+    for (int line = 1; next != NULL; line++) {
+        char *lineText = next;
+        next = strchr(next, '\n');
+        next != NULL ? *next++ = '\0' : 0;
+
+        // Skip the empty lines and the comments
+        lineText += strspn(lineText, " \t\r");
+        if (*lineText == '\0' || *lineText == '#') {
+            continue;
+        }
 
-                // Store the final X & Y coordinates plus initial position coordinate.
-                xPos[k][i][j] = coilAngledX + startX;
-                yPos[k][i][j] = coilAngledY + startY;
+        Job *job = &batch.jobs[batch.total++];
+        job->line = line;
+        snprintf(job->file, sizeof(job->file), "./coil_text_%d", batch.total);
 
-                // Print out the progress
-                printf(" %d %2d (%.2f%%)\e[u", i+1, j, roundf(((float) j / (((end+pow(-1, i)*(layerCode)*viaAngle*(spacing)/(2*M_PI) + outViaAdd)-start)/step + 1)) * 100));
+        // Enough room for the defaults and every word of the line
+        int words = argc + 4;
+        for (char *c = lineText; *c; c++) {
+            *c == ' ' || *c == '\t' ? words++ : 0;
+        }
+        job->argv = malloc(words * sizeof(char *));
+
+        // The program name and the default file come first, followed by the defaults of the command line
+        job->argv[0] = argv[0];
+        job->argv[1] = "-f";
+        job->argv[2] = job->file;
+        job->argc = 3;
+        for (int i = 1; i + 1 < argc; i += 2) {
+            if (strcmp(argv[i],"-b") && strcmp(argv[i],"-j") && strcmp(argv[i],"--stats")) {
+                job->argv[job->argc++] = argv[i];
+                job->argv[job->argc++] = argv[i+1];
             }
-            printf("\n");
         }
+
+        // The flags of the line come last, so they replace the defaults
+        for (char *word = strtok_r(lineText, " \t\r", &saved); word != NULL; word = strtok_r(NULL, " \t\r", &saved)) {
+            job->argv[job->argc++] = word;
+        }
+        job->argv[job->argc] = NULL;
     }
 
-    printf(" ------------------------ \n");
-    printf("End of generating coils\n");
-    /* --- End of GENERATE COIL --- */
+    // Run the jobs on the threads (or right here with a single thread)
+    threads = batchThreads(&batch, threads);
+
+    // Print out the time and the counters of each job
+    int failed = 0;
+    stats ? printf("{\"jobs\": [") : printf("\n --- Batch: %d jobs on %d threads --- \n", batch.total, threads);
+    for (int j = 0; j < batch.total; j++) {
+        Job *job = &batch.jobs[j];
+        Result *result = &job->result;
+        job->status ? failed++ : 0;
+
+        // The last file of the arguments is the one written
+        char *file = job->file;
+        for (int i = 1; i + 1 < job->argc; i += 2) {
+            !strcmp(job->argv[i],"-f") ? file = job->argv[i+1] : 0;
+        }
 
-    /* --- WRITE --- */
-    /* Using the xPos & yPos 2D arrays write all the coordinates generated
-     * into the file opened using KiCAD footprint format.
-     * Adjust the locations of the vias and write the coordinates of the vias
-     * into the file using the KiCAD footprint format.
-     */
+        if (stats) {
+            printf("%s\n {\"job\": %d, \"line\": %d, \"file\": \"%s\", \"error\": %s, \"time\": %.6f, \"segments\": %d, \"arcs\": %d, \"vias\": %d, \"bytesWritten\": %zu, \"maxDeviation\": %g, \"cache\": \"%s\"}", j ? "," : "", j+1, job->line, file, job->status ? "true" : "false", result->time, result->segments, result->arcs, result->vias, result->bytes, result->deviation, result->cache != NULL ? result->cache : "off");
+        } else {
+            printf("Job %d (line %d): %s\t%s%.3f s\t%d segments\t%d arcs\t%d vias\t%zu bytes%s%s\n\r", j+1, job->line, file, job->status ? "FAILED\t" : "", result->time, result->segments, result->arcs, result->vias, result->bytes, result->cache != NULL && strcmp(result->cache, "off") ? "\tcache " : "", result->cache != NULL && strcmp(result->cache, "off") ? result->cache : "");
+        }
+    }
+    stats ? printf("],\n \"total\": %.6f, \"failed\": %d, \"peakMemoryKiB\": %ld}\n", coilNow() - timeBegin, failed, peakMemory()) : printf(" --------------------------- \nTotal time: %.3f s, %d failed\n\r", coilNow() - timeBegin, failed);
 
-    float outerRadius = 0;
+    for (int j = 0; j < batch.total; j++) {
+        free(batch.jobs[j].argv);
+    }
+    free(batch.jobs);
+    free(text);
+    pthread_mutex_destroy(&batch.lock);
 
-    // Print out the loading screen
-    printf("\n --- Writing into File --- \n");
+    return failed ? 1 : 0;
+}
+/* --- End of BATCH --- */
 
-    for (int k = 0; k < count; k++) {
-        printf("Coil: %d ...\n", k+1);
+/* --- SWEEP --- */
 
-        // Iterate through each copper layer
-        for (int i = 0; i < layers; i++) {
-            // Print out progress tag
-            printf(" - Progress:\e[s");
+/* sweepScore
+ * Returns the distance of an evaluated candidate from the targets: the relative errors of the
+ * inductance and the resistance, or the resistance over the inductance without a target.
+ * Lower is better.
+ *
+ * Parameters:
+ *  -   result:     Evaluation of the candidate
+ *  -   targetL:    Target inductance (uH, 0 for none)
+ *  -   targetR:    Target resistance (ohm, 0 for none)
+ */
+static double sweepScore(const Result *result, double targetL, double targetR) {
+    if (targetL > 0 || targetR > 0) {
+        return (targetL > 0 ? fabs(result->inductance*1e6 - targetL)/targetL : 0) + (targetR > 0 ? fabs(result->resistance - targetR)/targetR : 0);
+    }
+    return result->inductance > 0 ? result->resistance/result->inductance : INFINITY;
+}
 
-            // Adjust the layer numbering for specific end locations required per layer
-            layerCode = floor( i/2 );
+/* rankCompare
+ * Orders the candidates of the sweep: the ones meeting the constraints first, then the lower
+ * score and the order of the candidates (qsort).
+ */
+static int rankCompare(const void *a, const void *b) {
+    const Rank *ra = a, *rb = b;
+    if (ra->fits != rb->fits) {
+        return rb->fits - ra->fits;
+    }
+    if (ra->score != rb->score) {
+        return ra->score < rb->score ? -1 : 1;
+    }
+    return ra->job - rb->job;
+}
 
-            int fix = 0;
+/* sweepRun
+ * Evaluates every combination of the ranges of -t, -w, -s, -l and -i and writes only the best coil.
+ * The other flags of the command line are the parameters of every candidate. All the candidates are
+ * estimated from their parameters (coilEstimate), the best ones within the largest radius and the
+ * clearance are generated into memory and analyzed (coilEvaluate), all on the given number of threads.
+ * Prints the ranking of the generated candidates, then the winner is written like the command line.
+ *
+ * Parameters:
+ *  -   argc:       Number of arguments of the command line
+ *  -   argv:       Arguments of the command line
+ *  -   ranges:     Ranges of the sweep (t=min:max:step,w=min:max:step,...)
+ *  -   threads:    Number of candidates evaluated at the same time
+ *  -   stats:      Print the report as json (1) or text (0)
+ */
+static int sweepRun(int argc, char *argv[], const char *ranges, int threads, int stats) {
+    double timeBegin = coilNow();
+    const char *flags[5] = {"-t", "-w", "-s", "-l", "-i"};
+    const char *names[5] = {"turns", "width", "spacing", "layers", "inner"};
+
+    // Constraints and targets of the candidates
+    double maxRadius = 0, clearance = 0, targetL = 0, targetR = 0;
+    char *file = "./coil_text";
+    for (int i = 1; i + 1 < argc; i += 2) {
+        !strcmp(argv[i],"--max-radius") ? maxRadius = atof(argv[i+1]) : 0;
+        !strcmp(argv[i],"--clearance") ? clearance = atof(argv[i+1]) : 0;
+        !strcmp(argv[i],"--target-l") ? targetL = atof(argv[i+1]) : 0;
+        !strcmp(argv[i],"--target-r") ? targetR = atof(argv[i+1]) : 0;
+        !strcmp(argv[i],"-f") || !strcmp(argv[i],"-k") ? file = argv[i+1] : 0;
+    }
 
-            if (i == 0 || i == layers-1) {
-                outViaAdd = 0;
-                fix = 0;
-            } else {
-                outViaAdd = powf(-1,floorf( ((float)i-0.5)/2 )) * (powf(-1,i) * ceilf( ((float)i) / 2 )/2)*outViaAngle*spacing/(2*M_PI);
-                fix = -1;
+    // Values of each range (min:max:step, the step defaults to 1), 0 steps for the parameters not swept
+    double range[5][3];
+    long steps[5] = {0, 0, 0, 0, 0};
+    char *text = malloc(strlen(ranges) + 1);
+    int error = text == NULL;
+    text != NULL ? strcpy(text, ranges) : 0;
+
+    char *saved;
+    for (char *word = error ? NULL : strtok_r(text, ",", &saved); word != NULL; word = strtok_r(NULL, ",", &saved)) {
+        int p = 0;
+        while (p < 5 && !(word[0] == flags[p][1] && word[1] == '=')) {
+            p++;
+        }
+        int read = p < 5 ? sscanf(word + 2, "%lf:%lf:%lf", &range[p][0], &range[p][1], &range[p][2]) : 0;
+        if (read < 1) {
+            error = 1;
+            break;
+        }
+        read < 2 ? range[p][1] = range[p][0] : 0;
+        read < 3 ? range[p][2] = 1 : 0;
+        steps[p] = range[p][2] > 0 && range[p][1] > range[p][0] ? (long)floor((range[p][1] - range[p][0])/range[p][2] + 1e-9) + 1 : 1;
+    }
+    free(text);
+
+    long total = 1;
+    for (int p = 0; p < 5 && !error; p++) {
+        total *= steps[p] ? steps[p] : 1;
+        total > SWEEP_CANDIDATES ? error = 2 : 0;
+    }
+    if (error) {
+        error == 2 ? printf("Error: the sweep has more than %d candidates!\n\r", SWEEP_CANDIDATES) : printf("Error: the ranges of the sweep are not flag=min:max:step (t, w, s, l or i)!\n\r");
+        return(1);
+    }
+
+    // Candidates: the command line without the batch flags, followed by the values of the candidate
+    Batch batch;
+    batch.jobs = calloc(total, sizeof(Job));
+    batch.total = total;
+    pthread_mutex_init(&batch.lock, NULL);
+    char (*values)[5][24] = malloc(total * sizeof(*values));
+    Rank *ranks = malloc(total * sizeof(Rank));
+    if (batch.jobs == NULL || values == NULL || ranks == NULL) {
+        printf("Error allocating the candidates of the sweep!\n\r");
+        free(batch.jobs);
+        free(values);
+        free(ranks);
+        pthread_mutex_destroy(&batch.lock);
+        return(1);
+    }
+
+    for (long c = 0; c < total; c++) {
+        Job *job = &batch.jobs[c];
+        job->line = c + 1;
+        job->argv = malloc((argc + 11) * sizeof(char *));
+        job->argv[0] = argv[0];
+        job->argc = 1;
+        for (int i = 1; i + 1 < argc; i += 2) {
+            if (strcmp(argv[i],"-b") && strcmp(argv[i],"-j") && strcmp(argv[i],"--stats")) {
+                job->argv[job->argc++] = argv[i];
+                job->argv[job->argc++] = argv[i+1];
             }
+        }
 
-            // Iterate through each position on the coil
-            for (int j = 0; j < (int)(((end+pow(-1, i)*(layerCode)*viaAngle*(spacing)/(2*M_PI) + outViaAdd)-start)/step)+fix; j++) {
-                // Print out the wire segments according to KiCAD Footprint File.
-
-                // Check for copper layers
-                if (i == 0) {
-                    fprintf(fp, "(segment (start %f %f) (end %f %f) (width %f) (layer \"F.Cu\") (net %d) (uuid 4efbfedb-0d6a-488e-863f-%dbeaaa%dba%d))\n", xPos[k][i][j], yPos[k][i][j], xPos[k][i][j+1], yPos[k][i][j+1], width, netID, k, j, i);
-                } else if (i == layers-1) {
-                    fprintf(fp, "(segment (start %f %f) (end %f %f) (width %f) (layer \"B.Cu\") (net %d) (uuid 4efbfedb-0d6a-488e-863f-%dbeaaa%dba%d))\n", xPos[k][i][j], yPos[k][i][j], xPos[k][i][j+1], yPos[k][i][j+1], width, netID, k, j, i);
-                } else {
-                    fprintf(fp, "(segment (start %f %f) (end %f %f) (width %f) (layer \"In%d.Cu\") (net %d) (uuid 4efbfedb-0d6a-488e-863f-%dbeaaa%dba%d))\n", xPos[k][i][j], yPos[k][i][j], xPos[k][i][j+1], yPos[k][i][j+1], width, i, netID, k, j, i);
-                }
-                // Print out the progress
-                printf(" %d %2d (%.2f%%)\e[u", i+1, j, roundf(((float) j / (((end+pow(-1, i)*(layerCode)*viaAngle*(spacing)/(2*M_PI) + outViaAdd)-start)/step)) * 100));
+        // The values come last, so they replace the parameters of the command line
+        long index = c;
+        for (int p = 0; p < 5; p++) {
+            if (steps[p]) {
+                snprintf(values[c][p], sizeof(values[c][p]), "%.6g", range[p][0] + (index % steps[p]) * range[p][2]);
+                index /= steps[p];
+                job->argv[job->argc++] = (char *)flags[p];
+                job->argv[job->argc++] = values[c][p];
             }
-            printf("\n");
         }
+        job->argv[job->argc] = NULL;
+        job->result.evaluate = 1;
+    }
 
-        // Adjust the starting coordinates for each Coil
-        startX = cos(motorRotate) * motorRadius*cos(motorAngle * (k+1)) + sin(motorRotate)*motorRadius*sin(motorAngle * (k+1));
-        startY = -sin(motorRotate) * motorRadius*cos(motorAngle * (k+1)) + cos(motorRotate) * motorRadius*sin(motorAngle * (k+1));
+    // Estimate every candidate, only the ones within the constraints are ranked
+    threads = batchThreads(&batch, threads);
+    int estimated = 0;
+    for (long c = 0; c < total; c++) {
+        Result *result = &batch.jobs[c].result;
+        if (!batch.jobs[c].status && (maxRadius <= 0 || result->outerRadius <= maxRadius) && result->violations == 0) {
+            Rank rank = {c, 1, sweepScore(result, targetL, targetR)};
+            ranks[estimated++] = rank;
+        }
+    }
+    qsort(ranks, estimated, sizeof(Rank), rankCompare);
+    double timeEstimate = coilNow() - timeBegin;
+
+    // Generate the best candidates of the estimate and rank them again with their items
+    int generated = estimated < SWEEP_GENERATED ? estimated : SWEEP_GENERATED;
+    Batch best;
+    best.jobs = malloc((generated ? generated : 1) * sizeof(Job));
+    best.total = best.jobs != NULL ? generated : 0;
+    pthread_mutex_init(&best.lock, NULL);
+    for (int g = 0; g < best.total; g++) {
+        best.jobs[g] = batch.jobs[ranks[g].job];
+        best.jobs[g].result.evaluate = 2;
+    }
+    batchThreads(&best, threads);
+    for (int g = 0; g < best.total; g++) {
+        Job *job = &batch.jobs[ranks[g].job];
+        job->status = best.jobs[g].status;
+        job->result = best.jobs[g].result;
+        ranks[g].fits = !job->status && (maxRadius <= 0 || job->result.outerRadius <= maxRadius) && job->result.violations == 0;
+        ranks[g].score = sweepScore(&job->result, targetL, targetR);
+    }
+    generated = best.total;
+    qsort(ranks, generated, sizeof(Rank), rankCompare);
+    free(best.jobs);
+    pthread_mutex_destroy(&best.lock);
+    double timeGenerate = coilNow() - timeBegin - timeEstimate;
+
+    // Print out the ranking of the generated candidates
+    if (stats) {
+        printf("{\"sweep\": {\"candidates\": %ld, \"estimated\": %d, \"generated\": %d, \"threads\": %d, \"maxRadius\": %g, \"clearance\": %g, \"targetInductance\": %g, \"targetResistance\": %g, \"estimate\": %.6f, \"generate\": %.6f},\n \"ranking\": [", total, estimated, generated, threads, maxRadius, clearance, targetL*1e-6, targetR, timeEstimate, timeGenerate);
+    } else {
+        printf("\n --- Sweep: %ld candidates, %d within the constraints (estimate), %d generated on %d threads --- \n", total, estimated, generated, threads);
+        printf("Rank\t");
+        for (int p = 0; p < 5; p++) {
+            steps[p] ? printf("%s\t", names[p]) : 0;
+        }
+        printf("radius\tL (uH)\tR (ohm)\tlength\tscore\n");
+    }
+    for (int g = 0; g < generated; g++) {
+        const Job *job = &batch.jobs[ranks[g].job];
+        const Result *result = &job->result;
+        const char *status = ranks[g].fits ? "ok" : (job->status ? "failed" : (result->violations ? "clearance" : "radius"));
+        if (stats) {
+            printf("%s\n {\"rank\": %d, \"candidate\": %d, ", g ? "," : "", g+1, job->line);
+            for (int p = 0; p < 5; p++) {
+                steps[p] ? printf("\"%s\": %s, ", names[p], values[ranks[g].job][p]) : 0;
+            }
+            printf("\"outerRadius\": %g, \"inductance\": %g, \"resistance\": %g, \"length\": %g, \"violations\": %ld, \"score\": %g, \"fits\": %s}", result->outerRadius, result->inductance, result->resistance, result->length, result->violations, ranks[g].score, ranks[g].fits ? "true" : "false");
+        } else {
+            printf("%d\t", g+1);
+            for (int p = 0; p < 5; p++) {
+                steps[p] ? printf("%s\t", values[ranks[g].job][p]) : 0;
+            }
+            printf("%.3f\t%.4f\t%.4f\t%.2f\t%.4g\t%s\n", result->outerRadius, result->inductance*1e6, result->resistance, result->length, ranks[g].score, status);
+        }
+    }
+    stats ? printf("],\n") : printf(" --------------------------- \n");
+
+    // Write only the winner: the command line followed by its values
+    int status = 1;
+    if (generated == 0 || !ranks[0].fits) {
+        printf(stats ? " \"winner\": null, \"error\": true}\n" : "Error: no candidate of the sweep meets the constraints!\n\r");
+    } else {
+        const Job *winner = &batch.jobs[ranks[0].job];
+        char **args = malloc((argc + 11) * sizeof(char *));
+        int count = 0;
+        for (int i = 0; i < argc; i++) {
+            if (i > 0 && i + 1 < argc && !strcmp(argv[i],"-b")) {
+                i++;
+                continue;
+            }
+            args[count++] = argv[i];
+        }
+        for (int p = 0; p < 5; p++) {
+            if (steps[p]) {
+                args[count++] = (char *)flags[p];
+                args[count++] = values[ranks[0].job][p];
+            }
+        }
+        args[count] = NULL;
+
+        // The winner prints its own messages, the json report only its counters
+        Buffers buffers = {NULL, {NULL, 0}};
+        Result result = {0, 0, 0, 0, 0, 0, NULL, 0, 0, 0, 0, 0, 0, NULL, NULL};
+        stats ? 0 : printf("\nWinner: candidate %d of %ld, written into %s\n\r", winner->line, total, file);
+        status = coilRun(count, args, &buffers, stats ? &result : NULL);
+        buffersFree(&buffers);
+        free(args);
+
+        if (stats) {
+            printf(" \"winner\": {\"candidate\": %d, \"file\": \"%s\", \"error\": %s, \"time\": %.6f, \"segments\": %d, \"arcs\": %d, \"vias\": %d, \"bytesWritten\": %zu},\n", winner->line, file, status ? "true" : "false", result.time, result.segments, result.arcs, result.vias, result.bytes);
+            printf(" \"total\": %.6f, \"peakMemoryKiB\": %ld, \"error\": %s}\n", coilNow() - timeBegin, peakMemory(), status ? "true" : "false");
+        }
+    }
 
-        float endX = motorRadius*cos(motorAngle * (count));
-        float endY = motorRadius*sin(motorAngle * (count));
+    for (long c = 0; c < total; c++) {
+        free(batch.jobs[c].argv);
+    }
+    free(batch.jobs);
+    free(values);
+    free(ranks);
+    pthread_mutex_destroy(&batch.lock);
 
-        rotate = acos(round( (startX * endX + startY * endY) / ( sqrt( pow(startX,2) + pow(startY,2) ) * sqrt( pow(endX,2) + pow(endY,2) ) )*1000 )/1000);
+    return status;
+}
+/* --- End of SWEEP --- */
 
-        startY > 0 ? rotate = -rotate : rotate;
+/* --- SERVER --- */
 
-        // Create a unit vector pointing to the via locations
-        float unitVector[2] = {(xPos[k][0][0]- startX)/(sqrt(powf(xPos[k][0][0]- startX,2) + powf(yPos[k][0][0]- startY,2))), (yPos[k][0][0]- startY)/(sqrt(powf(xPos[k][0][0]- startX,2) + powf(yPos[k][0][0]- startY,2)))};
+/* requestString
+ * Copies a JSON string of a request (without escapes) into the text of the words.
+ * Returns the position after the string, or NULL when there is no such string.
+ *
+ * Parameters:
+ *  -   c:          Start of the string (its quote)
+ *  -   text:       Text of the words, moved after the copied string
+ */
+static const char *requestString(const char *c, char **text) {
+    if (*c != '"') {
+        return NULL;
+    }
 
-        // Create vias at specific locations while biasing the location towards the center of the coil
-        if (layers == 1) { 
-            // Add a via adjusted using the unit vector
-            fprintf(fp,"(via (at %f %f) (size %.1f) (drill 0.4) (layers \"F.Cu\" \"B.Cu\") (free) (net %d) (tstamp e5f06cd2-492e-41b2-8ded-13a3fa1042b%d))\n", xPos[k][0][0] + ( unitVector[0] * (-viaSize/2 + width/2) ), yPos[k][0][0] + ( unitVector[1] * (-viaSize/2 + width/2) ), viaSize, netID, 0);
+    size_t length = strcspn(++c, "\"\\\n");
+    if (c[length] != '"') {
+        return NULL;
+    }
 
-        } else {
-            for (int i = 0; i < layers; i++) {
-                // Add vias
-                if ((i+1) % 2) {
-                    // Adjust the unit vector for the new via position
-                    unitVector[0] = (xPos[k][i][0]- startX)/(sqrt(powf(xPos[k][i][0]- startX,2) + powf(yPos[k][i][0]- startY,2)));
-                    unitVector[1] = (yPos[k][i][0]- startY)/(sqrt(powf(xPos[k][i][0]- startX,2) + powf(yPos[k][i][0]- startY,2)));
-
-                    // Adjust the via position using the new unit vector
-                    fprintf(fp,"(via (at %f %f) (size %.1f) (drill 0.4) (layers \"F.Cu\" \"B.Cu\") (free) (net %d) (tstamp e5f06cd2-492e-41b2-8ded-13a3fa1042b%d))\n", xPos[k][i][0] + ( unitVector[0] * (-viaSize*3/4 + width/2) ), yPos[k][i][0] + ( unitVector[1] * (-viaSize*3/4 + width/2) ), viaSize, netID, 0);
-                }
-            }
+    memcpy(*text, c, length);
+    (*text)[length] = '\0';
+    *text += length + 1;
+    return c + length + 1;
+}
 
-            // More than 2 layers requires vias outside the coil for connection
-            if (layers > 2) {
+/* requestParse
+ * Splits a request of the server, a flat JSON object such as {"t": 20, "l": 4, "format": "items"},
+ * into the flags of the command line: single letter keys become -key, the other keys --key and the
+ * values their parameters (true and false become 1 and 0). The format and the id of the request
+ * are returned apart. Strings cannot contain escapes.
+ * Returns the number of words, or -1 when the request is not such an object.
+ *
+ * Parameters:
+ *  -   line:       Request
+ *  -   text:       Text of the words (twice the length of the request)
+ *  -   words:      Returned flags and parameters
+ *  -   max:        Largest number of words
+ *  -   format:     Returned format of the response (unchanged when not given)
+ *  -   id:         Returned id of the request (unchanged when not given)
+ */
+static int requestParse(const char *line, char *text, char **words, int max, char **format, char **id) {
+    const char *space = " \t\r\n";
+    const char *c = line + strspn(line, space);
+    int count = 0;
 
-                // Dummy variables for outer via positions
-                float outViaXPos, outViaYPos;
+    if (*c++ != '{') {
+        return -1;
+    }
+    c += strspn(c, space);
+    if (*c == '}') {
+        return 0;
+    }
 
-                // Check if there are even or odd numbered Outer Vias
-                if (outerVias % 2) {
-                    // ODD number of outer vias
+    for (;;) {
+        // Key written as a flag (--key, or -k for a single letter)
+        char *key = text;
+        *text++ = '-';
+        *text++ = '-';
+        c = requestString(c, &text);
+        if (c == NULL || key[2] == '\0') {
+            return -1;
+        }
+        c += strspn(c, space);
+        if (*c++ != ':') {
+            return -1;
+        }
+        c += strspn(c, space);
+
+        // Value, a string or a bare number, true or false
+        char *value = text;
+        if (*c == '"') {
+            c = requestString(c, &text);
+            if (c == NULL) {
+                return -1;
+            }
+        } else {
+            size_t length = strcspn(c, ",} \t\r\n");
+            if (length == 0) {
+                return -1;
+            }
+            if (length == 4 && !strncmp(c, "true", 4)) {
+                *text++ = '1';
+            } else if (length == 5 && !strncmp(c, "false", 5)) {
+                *text++ = '0';
+            } else {
+                memcpy(text, c, length);
+                text += length;
+            }
+            *text++ = '\0';
+            c += length;
+        }
 
-                    // # 0 0 1 1 2 2 #
+        if (!strcmp(key, "--format")) {
+            *format = value;
+        } else if (!strcmp(key, "--id")) {
+            *id = value;
+        } else {
+            if (count + 2 > max) {
+                return -1;
+            }
+            words[count++] = key[3] == '\0' ? key + 1 : key;
+            words[count++] = value;
+        }
 
-                    // 0 1 2 3 4 5 6 7
+        c += strspn(c, space);
+        if (*c != ',') {
+            return *c == '}' ? count : -1;
+        }
+        c++;
+        c += strspn(c, space);
+    }
+}
 
-                    //i * 2 + 1
-                    //i * 2 + 2
+/* itemsWrite
+ * Writes the items of a run as JSON, an array per item with its kind, coil, layer, points and width
+ * (arcs with their middle point before the end, vias as kind, coil, center and size).
+ *
+ * Parameters:
+ *  -   writer:     In-memory writer of the response
+ *  -   list:       Items of every coil
+ */
+static void itemsWrite(CoilWriter *writer, const CoilList *list) {
+    const char *kinds[4] = {"segment", "arc", "via", "link"};
+
+    coilWriterPrintf(writer, "{\"items\": [");
+    for (size_t n = 0; n < list->count; n++) {
+        const CoilItem *item = &list->items[n];
+        const char *next = n ? ",\n" : "\n";
+        if (item->kind == COIL_VIA) {
+            coilWriterPrintf(writer, "%s[\"%s\", %d, %f, %f, %f]", next, kinds[item->kind], item->coil, item->start[0], item->start[1], item->width);
+        } else if (item->kind == COIL_ARC) {
+            coilWriterPrintf(writer, "%s[\"%s\", %d, %d, %f, %f, %f, %f, %f, %f, %f]", next, kinds[item->kind], item->coil, item->layer, item->start[0], item->start[1], item->mid[0], item->mid[1], item->end[0], item->end[1], item->width);
+        } else {
+            coilWriterPrintf(writer, "%s[\"%s\", %d, %d, %f, %f, %f, %f, %f]", next, kinds[item->kind], item->coil, item->layer, item->start[0], item->start[1], item->end[0], item->end[1], item->width);
+        }
+    }
+    coilWriterPrintf(writer, "\n]}\n");
+}
 
-                    for (int i = 0; i < outerVias; i++) {
+/* serverSend
+ * Writes all the data into a connection of the server.
+ * Returns 1 when the connection is closed.
+ *
+ * Parameters:
+ *  -   fd:         Connection (or standard output)
+ *  -   data:       Data to write
+ *  -   size:       Size of the data
+ */
+static int serverSend(int fd, const char *data, size_t size) {
+    while (size > 0) {
+        ssize_t sent = write(fd, data, size);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return 1;
+        }
+        data += sent;
+        size -= sent;
+    }
+    return 0;
+}
 
-                        outViaMult = ceilf((float)i/2);
+/* serverReply
+ * Sends a response: a JSON header line with the status and the counters of the run, followed by
+ * the number of body bytes given in the header.
+ * Returns 1 when the connection is closed.
+ *
+ * Parameters:
+ *  -   out:        Connection (or standard output)
+ *  -   id:         Id of the request
+ *  -   format:     Format of the body
+ *  -   error:      Reason of a failed request (NULL on success)
+ *  -   body:       Body of the response
+ *  -   size:       Size of the body
+ *  -   result:     Counters of the run
+ *  -   cache:      Result of the cache (off, miss, geometry, file or memory)
+ */
+static int serverReply(int out, const char *id, const char *format, const char *error, const char *body, size_t size, const Result *result, const char *cache) {
+    char header[512];
+    int length;
+
+    if (error != NULL) {
+        length = snprintf(header, sizeof(header), "{\"id\": \"%.64s\", \"status\": 1, \"error\": \"%s\", \"bytes\": 0}\n", id, error);
+        size = 0;
+    } else {
+        length = snprintf(header, sizeof(header), "{\"id\": \"%.64s\", \"status\": 0, \"format\": \"%s\", \"bytes\": %zu, \"segments\": %d, \"arcs\": %d, \"vias\": %d, \"cache\": \"%s\", \"time\": %.6f}\n", id, format, size, result->segments, result->arcs, result->vias, cache, result->time);
+    }
 
-                        outViaXPos = cos(outViaMult * outViaAngle - rotate * pow(-1, i)) * outViaRad + startX;
-                        outViaYPos = pow(-1, i) * sin(outViaMult * outViaAngle - rotate * pow(-1, i)) * outViaRad + startY;
+    return serverSend(out, header, length) || serverSend(out, body, size);
+}
 
-                        fprintf(fp,"(via (at %f %f) (size %.1f) (drill 0.4) (layers \"F.Cu\" \"B.Cu\") (free) (net %d) (tstamp e5f06cd2-492e-41b2-8ded-13a3fa1042b%d))\n", outViaXPos, outViaYPos, viaSize, netID, 0);
+/* serverRequest
+ * Runs a request of the server and sends its response. The flags of the request follow the
+ * defaults of the server, and the response of a recent identical request is sent from memory.
+ * Returns 1 when the connection is closed.
+ *
+ * Parameters:
+ *  -   server:     Server of the request
+ *  -   line:       Request (NULL when it was too long)
+ *  -   out:        Connection (or standard output)
+ *  -   buffers:    Output buffer and work units of the thread
+ */
+static int serverRequest(Server *server, const char *line, int out, Buffers *buffers) {
+    // Flags writing other files, running other modes or starting more threads are left to the command line of the server
+    const char *blocked[] = {"-f", "-k", "-b", "-j", "-h", "--server", "--sweep", "--cache", "--footprint", "--svg", "--dxf", "--field", "--field-out", "--stats"};
+    char text[2*SERVER_REQUEST + 16];
+    char *words[SERVER_WORDS];
+    char *format = "kicad";
+    char *id = "";
+    const char *error = NULL;
+
+    int count = line != NULL ? requestParse(line, text, words, SERVER_WORDS, &format, &id) : -1;
+    line == NULL ? error = "request too long" : (count < 0 ? error = "request is not a flat JSON object" : 0);
+    error == NULL && strcmp(format, "kicad") && strcmp(format, "items") ? error = "unknown format" : 0;
+    for (int w = 0; w < count && error == NULL; w += 2) {
+        for (size_t b = 0; b < sizeof(blocked) / sizeof(blocked[0]); b++) {
+            !strcmp(words[w], blocked[b]) ? error = "flag not allowed in a request" : 0;
+        }
+    }
+    if (error != NULL) {
+        return serverReply(out, id, format, error, NULL, 0, NULL, NULL);
+    }
 
-                        int sizeOne = (int)(((end+pow(-1, (i * 2 + 1))*(floor( (i * 2 + 1)/2 ))*viaAngle*(spacing)/(2*M_PI) + powf(-1,floorf( ((float)(i * 2 + 1)-0.5)/2 )) * (powf(-1,(i * 2 + 1)) * ceilf( ((float)(i * 2 + 1)) / 2 )/2)*outViaAngle*spacing/(2*M_PI))-start)/step + 1);
-                        int sizeTwo = (int)(((end+pow(-1, (i * 2 + 2))*(floor( (i * 2 + 2)/2 ))*viaAngle*(spacing)/(2*M_PI) + powf(-1,floorf( ((float)(i * 2 + 2)-0.5)/2 )) * (powf(-1,(i * 2 + 2)) * ceilf( ((float)(i * 2 + 2)) / 2 )/2)*outViaAngle*spacing/(2*M_PI))-start)/step + 1);
+    // Key of the recent responses: the flags and the format of the request, each word after its length
+    // so the words of one request can never read as the ones of another ({"t": "2 -l 4"} and {"t": 2, "l": 4})
+    char key[2*SERVER_REQUEST + 16 + 8*SERVER_WORDS];
+    size_t length = 0;
+    for (int w = 0; w < count; w++) {
+        length += sprintf(key + length, "%zu:%s", strlen(words[w]), words[w]);
+    }
+    sprintf(key + length, "%zu:%s", strlen(format), format);
+
+    Result result = {0, 0, 0, 0, 0, 0, NULL, 0, 0, 0, 0, 0, 0, NULL, NULL};
+    char *body = NULL;
+    size_t size = 0;
+    const char *cache = "memory";
+
+    pthread_mutex_lock(&server->lock);
+    for (int r = 0; r < SERVER_RECENT; r++) {
+        Response *recent = &server->recent[r];
+        if (recent->key != NULL && !strcmp(recent->key, key)) {
+            body = malloc(recent->size ? recent->size : 1);
+            body != NULL ? memcpy(body, recent->body, recent->size) : 0;
+            size = recent->size;
+            result = recent->result;
+            recent->used = ++server->uses;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&server->lock);
 
-                        fprintf(fp, "(segment (start %f %f) (end %f %f) (width %f) (layer \"In%d.Cu\") (net %d) (tstamp 4efbfedb-0d6a-488e-863f-1beaaa%dba%d))\n", xPos[k][ (i * 2 + 1) ][sizeOne-2], yPos[k][ (i * 2 + 1) ][sizeOne-2], outViaXPos, outViaYPos, width, (i * 2 + 1), netID, k*i+(i * 2 + 1), i);
-                        fprintf(fp, "(segment (start %f %f) (end %f %f) (width %f) (layer \"In%d.Cu\") (net %d) (tstamp 4efbfedb-0d6a-488e-863f-1beaaa%dba%d))\n", xPos[k][ (i * 2 + 2) ][sizeTwo-2], yPos[k][ (i * 2 + 2) ][sizeTwo-2], outViaXPos, outViaYPos, width, (i * 2 + 2), netID, k*i+(i * 2 + 2), i);
-                    }
+    if (body == NULL) {
+        // Arguments of the run: the defaults of the server followed by the flags of the request
+        char **args = malloc((server->argc + count + 1) * sizeof(char *));
+        if (args == NULL) {
+            return serverReply(out, id, format, "out of memory", NULL, 0, NULL, NULL);
+        }
+        memcpy(args, server->argv, server->argc * sizeof(char *));
+        memcpy(args + server->argc, words, count * sizeof(char *));
+        args[server->argc + count] = NULL;
+
+        // The records are written into memory, the items are returned by the run
+        CoilList items = {NULL, 0, 0};
+        result.stream = open_memstream(&body, &size);
+        result.items = !strcmp(format, "items") ? &items : NULL;
+        int status = result.stream != NULL ? coilRun(server->argc + count, args, buffers, &result) : 1;
+        result.stream != NULL ? fclose(result.stream) : 0;
+        result.stream = NULL;
+        free(args);
+
+        if (status == 0 && result.items != NULL) {
+            CoilWriter writer = {NULL, malloc(WRITER_SIZE), WRITER_SIZE, 0, 0, 6, 1, 0, 0};
+            if (writer.buffer != NULL) itemsWrite(&writer, &items);
+            status = writer.buffer == NULL || writer.error;
+            free(body);
+            body = writer.buffer;
+            size = writer.length;
+        }
+        result.items = NULL;
+        free(items.items);
 
-                    outerRadius = sqrt(pow(outViaXPos,2)+pow(outViaYPos,2))+viaSize/2;
-                } else {
-                    // EVEN number of outer vias
+        if (status != 0 || body == NULL) {
+            free(body);
+            return serverReply(out, id, format, "generation failed", NULL, 0, NULL, NULL);
+        }
+        cache = result.cache != NULL ? result.cache : "off";
+
+        // Keep the response in place of the least recently used one
+        char *copy = size <= SERVER_RECENT_SIZE ? malloc(size ? size : 1) : NULL;
+        char *name = copy != NULL ? strdup(key) : NULL;
+        if (name != NULL) {
+            memcpy(copy, body, size);
+            pthread_mutex_lock(&server->lock);
+            Response *oldest = &server->recent[0];
+            for (int r = 1; r < SERVER_RECENT; r++) {
+                server->recent[r].used < oldest->used ? oldest = &server->recent[r] : 0;
+            }
+            free(oldest->key);
+            free(oldest->body);
+            Response response = {name, copy, size, result, ++server->uses};
+            *oldest = response;
+            pthread_mutex_unlock(&server->lock);
+        } else {
+            free(copy);
+        }
+    }
 
-                    // # 0 0 1 #
+    int closed = serverReply(out, id, format, NULL, body, size, &result, cache);
+    free(body);
+    return closed;
+}
 
-                    // 0 1 2 3 4
+/* serverConnection
+ * Serves the requests of a connection, one JSON object per line, until it is closed.
+ *
+ * Parameters:
+ *  -   server:     Server of the connection
+ *  -   in:         Requests of the connection
+ *  -   out:        Responses of the connection
+ *  -   buffers:    Output buffer and work units of the thread
+ */
+static void serverConnection(Server *server, FILE *in, int out, Buffers *buffers) {
+    char line[SERVER_REQUEST];
 
-                    for (int i = 0; i < outerVias; i++) {
-                        
-                        outViaMult = floorf((float)i/2) + 0.5;
+    while (fgets(line, sizeof(line), in) != NULL) {
+        size_t length = strlen(line);
+        int tooLong = length == sizeof(line) - 1 && line[length - 1] != '\n';
 
-                        outViaXPos = cos(outViaMult * outViaAngle + rotate) * outViaRad + startX;
-                        outViaYPos = pow(-1, i) * sin(outViaMult * outViaAngle + rotate) * outViaRad + startY;
+        // The rest of a request that is too long is skipped
+        for (int c = 0; tooLong && (c = fgetc(in)) != EOF && c != '\n';) {
+        }
 
-                        fprintf(fp,"(via (at %f %f) (size %.1f) (drill 0.4) (layers \"F.Cu\" \"B.Cu\") (free) (net %d) (tstamp e5f06cd2-492e-41b2-8ded-13a3fa1042b%d))\n", outViaXPos, outViaYPos, viaSize, netID, 0);
+        // Empty lines are skipped
+        if (!tooLong && line[strspn(line, " \t\r\n")] == '\0') {
+            continue;
+        }
+        if (serverRequest(server, tooLong ? NULL : line, out, buffers)) {
+            break;
+        }
+    }
+}
 
-                        int sizeOne = (int)(((end+pow(-1, (i * 2 + 1))*(floor( (i * 2 + 1)/2 ))*viaAngle*(spacing)/(2*M_PI) + powf(-1,floorf( ((float)(i * 2 + 1)-0.5)/2 )) * (powf(-1,(i * 2 + 1)) * ceilf( ((float)(i * 2 + 1)) / 2 )/2)*outViaAngle*spacing/(2*M_PI))-start)/step + 1);
-                        int sizeTwo = (int)(((end+pow(-1, (i * 2 + 2))*(floor( (i * 2 + 2)/2 ))*viaAngle*(spacing)/(2*M_PI) + powf(-1,floorf( ((float)(i * 2 + 2)-0.5)/2 )) * (powf(-1,(i * 2 + 2)) * ceilf( ((float)(i * 2 + 2)) / 2 )/2)*outViaAngle*spacing/(2*M_PI))-start)/step + 1);
+/* serverWorker
+ * Thread of the server. Serves one connection after the other, reusing the same buffers for
+ * all of its requests.
+ *
+ * Parameters:
+ *  -   arg:        Server of the thread
+ */
+static void *serverWorker(void *arg) {
+    Server *server = arg;
+    Buffers buffers = {NULL, {NULL, 0}};
+
+    for (;;) {
+        int fd = accept(server->listener, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            break;
+        }
 
-                        fprintf(fp, "(segment (start %f %f) (end %f %f) (width %f) (layer \"In%d.Cu\") (net %d) (tstamp 4efbfedb-0d6a-488e-863f-1beaaa%dba%d))\n", xPos[k][ (i * 2 + 1) ][sizeOne-2], yPos[k][ (i * 2 + 1) ][sizeOne-2], outViaXPos, outViaYPos, width, (i * 2 + 1), netID, i+(i * 2 + 1), i);
-                        fprintf(fp, "(segment (start %f %f) (end %f %f) (width %f) (layer \"In%d.Cu\") (net %d) (tstamp 4efbfedb-0d6a-488e-863f-1beaaa%dba%d))\n", xPos[k][ (i * 2 + 2) ][sizeTwo-2], yPos[k][ (i * 2 + 2) ][sizeTwo-2], outViaXPos, outViaYPos, width, (i * 2 + 2), netID, i+(i * 2 + 2), i);
+        FILE *in = fdopen(fd, "r");
+        if (in != NULL) serverConnection(server, in, fd, &buffers);
+        in != NULL ? fclose(in) : close(fd);
+    }
 
-                    }
+    buffersFree(&buffers);
+    return NULL;
+}
 
-                    outerRadius = sqrt(pow(outViaXPos,2)+pow(outViaYPos,2))+viaSize/2;
-                }
+/* serverRun
+ * Runs the generation server (--server): every request is a line with a flat JSON object of
+ * flags ({"t": 20, "l": 4}) run on top of the other flags of the command line, and is answered
+ * by a JSON header line followed by the footprint file (kicad format) or the items as JSON
+ * (items format). The server listens on a Unix domain socket with a thread per connection
+ * (-j threads), or reads the requests from the standard input (-) and writes the responses into
+ * the standard output, the messages of the runs going into the standard error.
+ *
+ * Parameters:
+ *  -   argc:       Number of arguments of the command line
+ *  -   argv:       Arguments of the command line
+ *  -   path:       Address of the socket (- for the standard input and output)
+ *  -   threads:    Number of connections served at the same time
+ */
+static int serverRun(int argc, char *argv[], const char *path, int threads) {
+    // Flags of the command line that are not defaults of the requests
+    const char *skipped[] = {"--server", "-j", "-b", "--stats", "--sweep", "-f", "-k", "--footprint", "--svg", "--dxf", "--field", "--field-out"};
+    Server server;
+    memset(&server, 0, sizeof(server));
+    pthread_mutex_init(&server.lock, NULL);
+    server.listener = -1;
+
+    server.argv = malloc((argc + 1) * sizeof(char *));
+    if (server.argv == NULL) {
+        printf("Error: out of memory!\n\r");
+        return(1);
+    }
+    server.argv[server.argc++] = argv[0];
+    for (int i = 1; i + 1 < argc; i += 2) {
+        int skip = 0;
+        for (size_t s = 0; s < sizeof(skipped) / sizeof(skipped[0]); s++) {
+            skip |= !strcmp(argv[i], skipped[s]);
+        }
+        if (!skip) {
+            server.argv[server.argc++] = argv[i];
+            server.argv[server.argc++] = argv[i+1];
+        }
+    }
+    server.argv[server.argc] = NULL;
+
+    // A closed connection only ends its own requests
+    signal(SIGPIPE, SIG_IGN);
+
+    int status = 0;
+    if (!strcmp(path, "-")) {
+        // Responses into the standard output, the messages of the runs into the standard error
+        fflush(stdout);
+        int out = dup(STDOUT_FILENO);
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+
+        Buffers buffers = {NULL, {NULL, 0}};
+        serverConnection(&server, stdin, out, &buffers);
+        buffersFree(&buffers);
+        close(out);
+    } else {
+        struct sockaddr_un address;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (strlen(path) >= sizeof(address.sun_path)) {
+            printf("Error: socket address %s is too long!\n\r", path);
+            free(server.argv);
+            return(1);
+        }
+        strcpy(address.sun_path, path);
+
+        // A socket left by an earlier server is replaced, any other file is kept
+        struct stat info;
+        lstat(path, &info) == 0 && S_ISSOCK(info.st_mode) ? unlink(path) : 0;
+
+        server.listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (server.listener < 0 || bind(server.listener, (struct sockaddr *)&address, sizeof(address)) != 0) {
+            printf("Error opening the socket %s!\n\r", path);
+            status = 1;
+        } else if (listen(server.listener, SERVER_BACKLOG) != 0) {
+            printf("Error listening on the socket %s!\n\r", path);
+            unlink(path);
+            status = 1;
+        } else {
+            printf("Server: listening on %s with %d threads\n\r", path, threads);
+            fflush(stdout);
+
+            // The threads serve the connections, this one included
+            pthread_t *workers = malloc(threads * sizeof(pthread_t));
+            int started = 0;
+            while (workers != NULL && started < threads - 1 && pthread_create(&workers[started], NULL, serverWorker, &server) == 0) {
+                started++;
+            }
+            serverWorker(&server);
+            for (int t = 0; t < started; t++) {
+                pthread_join(workers[t], NULL);
             }
+            free(workers);
+            unlink(path);
         }
+        server.listener >= 0 ? close(server.listener) : 0;
     }
 
-    (int)outerRadius == 0 ? outerRadius = end : outerRadius;
+    for (int r = 0; r < SERVER_RECENT; r++) {
+        free(server.recent[r].key);
+        free(server.recent[r].body);
+    }
+    free(server.argv);
+    pthread_mutex_destroy(&server.lock);
 
-    printf(" ------------------------- \n");
-    printf("End of writing.\n\r");
-    printf("\nThe total radius of the coil is: %.2f (system units)\n\r", outerRadius);
-    printf("The total motor radius is: %.2f (system units)\n\n\r", motorRadius);
-    /* --- End of WRITE --- */
+    return status;
+}
+/* --- End of SERVER --- */
 
-    /* --- DISPLAY --- */
-    /* Display any additional information.
-     */
+/* --- MAIN --- */
+int main(int argc, char *argv[]) {
 
-    // Give a warning message to warn the user for adjusting the number of copper layers on KiCAD
-    if (layers > 2) {
-        printf("\n\rYou have selected more than 2 copper layers.\n\rPlease make sure to change the number of copper layers on KiCAD and make sure the copper layer names matches.\n\n\r");
+    // Look for a server, a job file or the ranges of a sweep, the number of threads and the report format
+    char *serverPath = NULL;
+    char *jobFile = NULL;
+    char *ranges = NULL;
+    int threads = 1;
+    int stats = 0;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i],"-b")) {
+            jobFile = argv[i+1];
+        } else if (!strcmp(argv[i],"--sweep")) {
+            ranges = argv[i+1];
+        } else if (!strcmp(argv[i],"--server")) {
+            serverPath = argv[i+1];
+        } else if (!strcmp(argv[i],"-j")) {
+            threads = atoi(argv[i+1]);
+            threads < 1 ? threads = sysconf(_SC_NPROCESSORS_ONLN) : threads;
+        } else if (!strcmp(argv[i],"--stats")) {
+            stats = !strcmp(argv[i+1],"json");
+        }
     }
-    /* --- End of DISPLAY --- */
 
-    // Close the File
-    fclose(fp);
+    // Serve the requests until the input or the socket is closed
+    if (serverPath != NULL) {
+        return serverRun(argc, argv, serverPath, threads);
+    }
 
-    // End script
-    return 0;
+    // Evaluate the candidates of the sweep and write the winner
+    if (ranges != NULL) {
+        return sweepRun(argc, argv, ranges, threads, stats);
+    }
+
+    // Run every job of the job file
+    if (jobFile != NULL) {
+        return batchRun(argc, argv, jobFile, threads, stats);
+    }
+
+    // Run the command line
+    Buffers buffers = {NULL, {NULL, 0}};
+    int status = coilRun(argc, argv, &buffers, NULL);
+    buffersFree(&buffers);
+
+    return status;
 }
-/* --- End of MAIN --- */
\ No newline at end of file
+/* --- End of MAIN --- */
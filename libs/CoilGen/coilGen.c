@@ -0,0 +1,4627 @@
+/* coilGen.c
+ * Coil generator library (see coilGen.h). The spiral of each copper layer is calculated on
+ * demand from its position on the spiral, every layer of every coil (and every chunk of a long
+ * layer) is a work unit generated on a thread pool and the units are handed to the sink in order.
+ */
+
+
+/* --- IMPORTS --- */
+#define _XOPEN_SOURCE 700       // clock_gettime, mmap and mkstemp with -std=c99
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <float.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "coilGen.h"
+/* --- End of IMPORTS --- */
+
+/* --- DEFINITIONS --- */
+#ifndef M_PI
+#define M_PI 3.14159265358979323846     // Not defined by math.h in strict POSIX mode
+#define M_PI_2 1.57079632679489661923
+#endif
+#define BLOCK_SIZE 64       // Number of points calculated together by the point kernel (coilBlock)
+#define WRITER_SIZE (1<<20) // Size of the output buffer, flushed into the file in blocks of this size
+#define WRITER_RECORD 1024  // Space reserved for a single record (line) in the output buffer
+#define UNIT_SIZE (64*BLOCK_SIZE)   // Number of wire segments of a layer generated as one work unit
+#define CACHE_MAGIC "COILGEO1"      // Start of a cache entry (format version 1)
+#define COPPER_RESISTIVITY 1.72e-5  // Resistivity of copper at 20 degrees C (ohm times system units, mm)
+#define MU_0_4PI 1e-10              // Permeability of free space over 4 pi (henry per system unit, mm)
+#define CLUSTER_SIZE 8              // Consecutive filaments of a layer in the smallest clusters of the far field
+#define FAR_FIELD 4.0               // Distance over size of two filaments using the far field
+#define CLUSTER_FAR 2.5             // Distance over size of two clusters using the far field (second order, clusterFar)
+#define ARC_PIECE (M_PI/16)         // Largest angle of the straight filaments of an arc
+#define SVG_ROOM 160                // Room left at the start of an SVG preview for its size
+#define RUN_SIZE 64                 // Largest number of straight pieces of a track joined into one shape
+#define FIELD_LANES 8               // Current elements calculated side by side by the field kernel (fieldTile)
+#define FIELD_BLOCK 2048            // Current elements summed in float before they are added in double
+#define FIELD_TILE 32               // Points of the field map taken together by a thread
+#define FIELD_UNIT 100.0            // Flux density of MU_0_4PI times an ampere over a system unit (microtesla, mm)
+#define OUTLINE_TOLERANCE 0.001     // Largest deviation of the copper polygons from the round corners and caps of the tracks
+#define DIGIT_PAIRS \
+    "0001020304050607080910111213141516171819202122232425262728293031323334353637383940414243444546474849" \
+    "5051525354555657585960616263646566676869707172737475767778798081828384858687888990919293949596979899"   // Two decimal digits of each number from 0 to 99 (fixedFormat)
+
+/* Template
+ * Adaptive wire segments or arcs of one layer on the initial spiral, shared by every coil.
+ * Record j goes from point j to point j+1, or through the points 2j, 2j+1 and 2j+2 for arcs.
+ */
+typedef struct {
+    int records;            // Number of wire segments or arcs
+    int length;             // Number of points
+    int capacity;           // Number of points allocated
+    double *points;         // Points on the initial spiral (x, y)
+    unsigned char *isArc;   // Arc (1) or straight segment (0) of each record, NULL without arcs
+    double deviation;       // Largest deviation from the spiral
+} Template;
+
+/* Layer
+ * Layout of one copper layer, planned once per run (layerPlan) and shared by the work units,
+ * the templates and the vias of every coil.
+ */
+typedef struct {
+    int segments;           // Number of uniform steps
+    int chunks;             // Number of work units
+    int sign;               // Side of the layer (-1 for the odd layers, mirrored to the other side)
+    double viaTurn;         // Turn of the layer to its via position
+    double last;            // Position of the last point on the initial spiral
+    double link;            // Position on the initial spiral the connection to its outer via starts from
+    int innerVia;           // Starts on its own inner via (1) or on the via of the layer before (0)
+} Layer;
+
+/* OuterVia
+ * Position of an outer via around the center of every coil and the two layers it connects,
+ * planned once per run (layerPlan).
+ */
+typedef struct {
+    double angle;           // Angle of the via without the rotation of the coil
+    int turn;               // Direction the rotation of the coil turns the via (±1)
+    int single;             // The turned angle is rounded to float (1) or kept in double precision (0)
+    int side;               // Side of the via (±1, mirrored by the y axis)
+    int layers[2];          // Layers ending on the via
+} OuterVia;
+
+/* Generator
+ * Parameters of the run shared by all work units. Filled in once before the generation
+ * and only read afterwards, so the threads can share it without locking.
+ */
+typedef struct {
+    double start, step, spacing, angle, viaAngle, width;
+    float tolerance, arcTolerance;
+    int layers;
+    int nanometers;         // Geometry kept in double precision and snapped to whole nanometers (1) or float (0)
+    const CoilParams *params;   // Parameters of the coils (formatter)
+    const CoilSink *sink;   // Receiver of the items
+    Layer *plan;            // Layout of each layer
+    OuterVia *outer;        // Outer vias connecting the layers in between
+    int outerVias;          // Number of outer vias
+    int unitsPerCoil;       // Number of work units of a single coil
+    double *coilX, *coilY;  // Center of each coil
+    double *coilRotate;     // Rotation of each coil
+    int *coilDirection;     // Direction of each coil (±1)
+    Template *templates;    // Adaptive wire segments, arcs or polygon sides of each layer (NULL for uniform steps)
+    int sides;              // Sides of the polygon coils (0 for the circular spiral)
+    double cornerAngle;     // Angle of the first corner of the polygon coils on the initial spiral
+    double chamfer, fillet; // Corners of the polygon coils cut off or rounded (0 for sharp corners)
+    double rotation[2][BLOCK_SIZE];     // Rotations by multiples of the angle step (coilBlock)
+} Generator;
+
+/* Unit
+ * A single work unit: one layer of one coil, or a chunk of the wire segments of a long layer.
+ * The items are generated into its own list and formatted into its own in-memory writer
+ * together with its counters.
+ */
+typedef struct {
+    int coil, layer;        // Coil and copper layer of the unit
+    int first, last;        // Wire segments [first, last) of the layer in the unit
+    CoilItem *items;        // Items of the unit
+    int count;              // Number of items
+    int capacity;           // Number of items allocated
+    CoilWriter writer;      // Items formatted by the sink
+    long segments, arcs;    // Number of wire segments and arcs generated
+    long points;            // Number of points on the layer added by the unit
+    double deviation;       // Largest deviation from the spiral
+    int error;              // Set when the items could not be allocated
+    int done;               // Set when the unit is generated
+} Unit;
+
+/* Pool
+ * Work units generated by the threads ahead of the writer. Unit u is kept in units[u % window],
+ * so at most window units are in memory and they are handed to the sink in order.
+ */
+typedef struct {
+    const Generator *gen;   // Parameters of the run
+    Unit *units;            // Ring of work units
+    int window;             // Number of units kept in memory
+    int total;              // Number of units of the run
+    int next;               // Next unit to generate
+    int written;            // Number of units handed to the sink
+    pthread_mutex_t lock;   // Protects next, written and done
+    pthread_cond_t changed; // Signalled when a unit is generated or written
+} Pool;
+
+/* CacheHeader
+ * Start of a cache entry (<key>.coil). It is followed by the points, wire segments and arcs of
+ * each layer, the tracks of each coil and layer, the vias and via connections of each coil and
+ * the items, so the whole entry can be used straight from memory.
+ */
+typedef struct {
+    char magic[8];          // CACHE_MAGIC
+    unsigned long long key; // Key of the geometry (coilCacheKey)
+    int count, layers;      // Number of coils and layers
+    int segments, arcs, vias;       // Number of items generated
+    double deviation;       // Largest deviation from the spiral
+    double outerRadius;     // Total radius of the coil
+    double motorRadius;     // Total radius of the motor
+    long items;             // Number of items
+} CacheHeader;
+
+/* CacheEntry
+ * Cache entry mapped into memory.
+ */
+typedef struct {
+    const CacheHeader *header;      // Start of the entry
+    size_t size;            // Size of the entry
+    const long *layerPoints, *layerSegments, *layerArcs, *tracks;
+    const int *coilVias, *coilLinks;
+    const CoilItem *items;  // Items in the order of the file
+} CacheEntry;
+
+/* CacheTee
+ * Context of the sink of a cache miss: the items are collected for the cache and handed on
+ * to the sink of the caller.
+ */
+typedef struct {
+    CoilList list;          // Items collected for the cache
+    const CoilSink *sink;   // Sink of the caller
+    int failed;             // Set when the items could not be collected (not cached)
+} CacheTee;
+
+/* Filament
+ * Straight piece of a track of the analysed coil carrying the current of its layer.
+ */
+typedef struct {
+    double start[3];        // Start point (x, y and the height of the layer)
+    double current[3];      // Direction of the current times the length of the filament
+    double length;          // Length of the filament
+    double gmd;             // Geometric mean distance of the cross section of the track
+    int layer;              // Index of the copper layer
+} Filament;
+
+/* Cluster
+ * Consecutive filaments of one layer, taken together in the far field (clusterFar). The
+ * clusters make up a tree: every cluster above the smallest ones joins two consecutive clusters.
+ */
+typedef struct {
+    int first, count;       // Filaments of the cluster
+    int children[2];        // Clusters joined by the cluster (-1 for the smallest clusters)
+    int layer;              // Index of the copper layer
+    double center[3];       // Center of the filaments
+    double radius;          // Largest distance of a filament end from the center
+    double current[3];      // Sum of the currents of the filaments
+    double moment[2][2];    // Currents times their offsets from the center (current x, y by offset x, y)
+    double spread[2][2][2]; // Currents times the products of their offsets (along the filaments too)
+} Cluster;
+
+/* Analysis
+ * Rows of clusters taken in order by the threads of the inductance calculation.
+ */
+typedef struct {
+    const Filament *filaments;
+    const Cluster *clusters;
+    const int *roots;       // Top clusters of the tree, one for each run of a layer
+    int total;              // Number of smallest clusters (the rows)
+    int runs;               // Number of top clusters
+    int next;               // Next row of clusters
+    int layers;             // Number of copper layers
+    double *inductance;     // Inductances of the layers (layers x layers), summed by the threads
+    pthread_mutex_t lock;   // Protects next and inductance
+} Analysis;
+
+/* Shape
+ * Copper of an item in the clearance check: a straight piece of a track (a capsule) or a via
+ * (a disc), with its position along the track of its layer to leave out the copper it is connected to.
+ */
+typedef struct {
+    double a[2], b[2];      // Ends of the piece (both the center of a via)
+    double radius;          // Half the width of the track, radius of a via
+    double from, to;        // Position of the piece along the track of its layer (0 for vias)
+    int layer;              // Index of the copper layer (-1 for vias, on every layer)
+    int coil;               // Index of the coil
+    int kind;               // Kind of the item (COIL_SEGMENT, COIL_ARC, COIL_VIA or COIL_LINK)
+    int via;                // Index of the via (-1 for tracks)
+    int cell[4];            // Cells of the grid covered (x0, y0, x1, y1)
+} Shape;
+
+/* Run
+ * Points of the straight pieces of a track joined into the last shape of the clearance check.
+ */
+typedef struct {
+    double points[RUN_SIZE+1][2];   // Points of the pieces
+    int length;             // Number of points
+} Run;
+
+/* Grid
+ * Uniform grid of the shapes of the clearance check: the shapes of each cell are listed
+ * one cell after the other (cell c from first[c] to first[c+1]).
+ */
+typedef struct {
+    double origin[2];       // Corner of the first cell
+    double size;            // Size of the cells
+    int columns, rows;      // Number of cells
+    int *first;             // Start of the shapes of each cell (columns*rows + 1)
+    int *shapes;            // Shapes of the cells
+} Grid;
+
+/* Elements
+ * Straight current elements of the field map, one array per component so the field kernel takes
+ * FIELD_LANES elements at a time. The list is padded with elements without current.
+ */
+typedef struct {
+    float *ax, *ay, *az;    // Start point (y mirrored to point up, z the height of the layer)
+    float *lx, *ly, *lz;    // End point minus the start point (direction of the current)
+    float *core;            // Twice the square of the core of the track (width over 2 pi)
+    float *current;         // Current of the element (ampere)
+    long count;             // Number of elements
+} Elements;
+
+/* FieldJob
+ * Tiles of the points of the grid taken in order by the threads of the field map.
+ */
+typedef struct {
+    const Elements *elements;
+    const CoilGrid *grid;
+    float *b;               // Flux density at each point
+    long points;            // Number of points
+    long next;              // First point of the next tile
+    pthread_mutex_t lock;   // Protects next
+} FieldJob;
+/* --- End of DEFINITIONS --- */
+
+/* --- FUNCTIONS --- */
+
+/* generatorValue
+ * Rounds a value calculated from the parameters of the run to float, the precision the generator
+ * calculates its geometry in, unless the nanometer engine keeps the geometry in double precision.
+ *
+ * Parameters:
+ *  -   gen:        Parameters of the run
+ *  -   value:      Value to round
+ */
+static double generatorValue(const Generator *gen, double value) {
+    return gen->nanometers ? value : (float)value;
+}
+
+/* layerTransform
+ * Calculates the transform that moves a point of the initial spiral to its position on the board
+ * for one copper layer of one coil. The initial spiral is turned by the spacing adjusted angle and
+ * the user rotation, mirrored for the direction and the layer side, turned to the via position of
+ * the layer and moved to the center of the coil. All of these steps are combined into a single
+ * 2x2 matrix and an offset, so they are calculated once per layer instead of once per point.
+ * The transform keeps distances, so arcs remain arcs.
+ *
+ * Parameters:
+ *  -   gen:        Parameters of the run (angle, via angle, center, rotation and direction of the coils)
+ *  -   coil:       Index of the coil
+ *  -   layer:      Index of the copper layer
+ *  -   transform:  Returned matrix {xx, xy, yx, yy} followed by the offset {x, y}
+ */
+static void layerTransform(const Generator *gen, int coil, int layer, double transform[6]) {
+    double angle = gen->angle, rotate = gen->coilRotate[coil];
+    int direction = gen->coilDirection[coil];
+
+    // Every odd layer turns the other way and is mirrored to the other side
+    int sign = gen->plan[layer].sign;
+
+    // Angle adjusted coil with spacing (rows of the first matrix)
+    double turn = generatorValue(gen, angle + rotate * sign);
+    double fixedXX = direction * cos(turn), fixedXY = direction * sin(turn);
+    double fixedYX = -sin(angle + M_PI_2 * (1 - sign) + rotate * sign), fixedYY = cos(angle + M_PI_2 * (1 - sign) + rotate * sign);
+
+    // Orient the coil on each layer to have a nice via layout (second matrix)
+    double c = cos(gen->plan[layer].viaTurn), s = sin(gen->plan[layer].viaTurn);
+
+    // Combine both matrices and add the center of the coil
+    transform[0] = c*fixedXX + s*fixedYX;
+    transform[1] = c*fixedXY + s*fixedYY;
+    transform[2] = -s*fixedXX + c*fixedYX;
+    transform[3] = -s*fixedXY + c*fixedYY;
+    transform[4] = gen->coilX[coil];
+    transform[5] = gen->coilY[coil];
+}
+
+/* coilTransform
+ * Moves a point of the initial spiral onto the board using the transform of the layer.
+ *
+ * Parameters:
+ *  -   px:         X coordinate of the point on the initial spiral
+ *  -   py:         Y coordinate of the point on the initial spiral
+ *  -   transform:  Transform of the layer (layerTransform)
+ *  -   xOut:       Returned X coordinate of the point
+ *  -   yOut:       Returned Y coordinate of the point
+ */
+static void coilTransform(double px, double py, const double transform[6], double *xOut, double *yOut) {
+    *xOut = transform[0]*px + transform[1]*py + transform[4];
+    *yOut = transform[2]*px + transform[3]*py + transform[5];
+}
+
+/* coilPoint
+ * Calculates the board coordinates of a single point on the spiral of one copper layer.
+ * The point is computed on demand from the spiral position x (can think of it as x variable
+ * in a calculator while plotting this), so no point has to be stored to draw the coil.
+ *
+ * Parameters:
+ *  -   x:          Position on the spiral (radius of the point before rotation)
+ *  -   spacing:    Spacing between each curl (including the width)
+ *  -   transform:  Transform of the layer (layerTransform)
+ *  -   xOut:       Returned X coordinate of the point
+ *  -   yOut:       Returned Y coordinate of the point
+ */
+static void coilPoint(double x, double spacing, const double transform[6], double *xOut, double *yOut) {
+
+    // Point of the initial coil with spacing, moved onto the layer
+    coilTransform(cos(2*M_PI*x/spacing)*x, sin(2*M_PI*x/spacing)*x, transform, xOut, yOut);
+}
+
+/* polygonCorner
+ * Calculates a corner of the initial polygon spiral. Every side is a straight line with its
+ * distance from the center taken from the spiral at the angle of its middle, so the sides of two
+ * turns are one spacing apart, the same as the circular spiral, and a square keeps its sides
+ * parallel to the axes. The corner is where the sides before and after it meet.
+ *
+ * Parameters:
+ *  -   gen:        Parameters of the run
+ *  -   corner:     Index of the corner (0 at the corner angle)
+ *  -   point:      Returned corner
+ */
+static void polygonCorner(const Generator *gen, long corner, double point[2]) {
+    double theta = gen->cornerAngle + 2*M_PI*corner/gen->sides;
+
+    // Angles of the middle of the sides before (a) and after (b) the corner
+    double a = theta - M_PI/gen->sides, b = theta + M_PI/gen->sides;
+
+    // Distances of the sides from the center (sides near the center cannot be negative)
+    double da = fmax(0, a*gen->spacing/(2*M_PI)), db = fmax(0, b*gen->spacing/(2*M_PI));
+
+    // Intersection of both sides
+    double det = sin(b - a);
+    point[0] = (da*sin(b) - db*sin(a))/det;
+    point[1] = (db*cos(a) - da*cos(b))/det;
+}
+
+/* polygonPoint
+ * Calculates the point of the initial polygon spiral at the position x on the spiral: the point
+ * of the side between the two corners around it in the direction of the spiral angle, so that
+ * the layers still start and end on the same axis as the circular spiral (their vias line up).
+ * The corners themselves are the only points of a polygon layer besides its first and last point
+ * (templatePolygon).
+ *
+ * Parameters:
+ *  -   gen:        Parameters of the run
+ *  -   x:          Position on the spiral
+ *  -   point:      Returned point
+ */
+static void polygonPoint(const Generator *gen, double x, double point[2]) {
+    double side = gen->spacing/gen->sides;          // Position on the spiral between two corners
+    double offset = gen->cornerAngle*gen->spacing/(2*M_PI);
+    long corner = (long)floor((x - offset)/side);
+
+    double a[2], b[2];
+    polygonCorner(gen, corner, a);
+    polygonCorner(gen, corner + 1, b);
+
+    // Intersection of the side with the direction of the spiral angle (a at the center)
+    double u[2] = {cos(2*M_PI*x/gen->spacing), sin(2*M_PI*x/gen->spacing)};
+    double across = u[0]*(b[1] - a[1]) - u[1]*(b[0] - a[0]);
+    double fraction = fabs(across) > 1e-12 ? -(u[0]*a[1] - u[1]*a[0])/across : 0;
+    point[0] = a[0] + fraction*(b[0] - a[0]);
+    point[1] = a[1] + fraction*(b[1] - a[1]);
+}
+
+/* spiralPoint
+ * Calculates the board coordinates of a single point of one copper layer, on the circular
+ * spiral (coilPoint) or on the polygon spiral of the polygon coils.
+ *
+ * Parameters:
+ *  -   gen:        Parameters of the run
+ *  -   x:          Position on the spiral
+ *  -   transform:  Transform of the layer (layerTransform)
+ *  -   xOut:       Returned X coordinate of the point
+ *  -   yOut:       Returned Y coordinate of the point
+ */
+static void spiralPoint(const Generator *gen, double x, const double transform[6], double *xOut, double *yOut) {
+    if (gen->sides > 0) {
+        double point[2];
+        polygonPoint(gen, x, point);
+        coilTransform(point[0], point[1], transform, xOut, yOut);
+    } else {
+        coilPoint(x, gen->spacing, transform, xOut, yOut);
+    }
+}
+
+/* coilBlock
+ * Calculates a block of BLOCK_SIZE evenly spaced points (x = start + j*step) on the spiral of
+ * one copper layer without calling cos/sin for every point. The spiral angle of the first point
+ * of the block is calculated exactly and the angle of every other point is reached by rotating
+ * it with the precomputed rotations m*delta (delta = 2*pi*step/spacing) of the table. As every
+ * block restarts from an exact angle, the rounding errors cannot build up along the coil.
+ * The loop has a fixed length and no dependencies between the points, so the compiler vectorizes
+ * it (SIMD). The last block of a layer is always calculated in full and only partly used.
+ *
+ * Parameters:
+ *  -   start:      Position on the spiral of the first point of the layer
+ *  -   step:       Step of the spiral position between the points
+ *  -   spacing:    Spacing between each curl (including the width)
+ *  -   first:      Index j of the first point of the block
+ *  -   rotation:   Table of cos(m*delta) followed by sin(m*delta) for m < BLOCK_SIZE
+ *  -   transform:  Transform of the layer (layerTransform)
+ *  -   xOut:       Returned X coordinates of the points
+ *  -   yOut:       Returned Y coordinates of the points
+ */
+static void coilBlock(double start, double step, double spacing, int first, const double rotation[2][BLOCK_SIZE], const double transform[6], double *restrict xOut, double *restrict yOut) {
+
+    // Exact angle of the first point of the block
+    double theta = 2*M_PI*(start + first*step)/spacing;
+    double c0 = cos(theta), s0 = sin(theta);
+
+    for (int m = 0; m < BLOCK_SIZE; m++) {
+        // Rotate the first angle of the block forward by m steps
+        double c = c0*rotation[0][m] - s0*rotation[1][m];
+        double s = s0*rotation[0][m] + c0*rotation[1][m];
+
+        // Point of the initial coil with spacing
+        double x = start + (first + m)*step;
+        double px = c*x, py = s*x;
+
+        // Move the point onto the layer
+        xOut[m] = transform[0]*px + transform[1]*py + transform[4];
+        yOut[m] = transform[2]*px + transform[3]*py + transform[5];
+    }
+}
+
+/* spiralDeviation
+ * Calculates how far the spiral deviates from the straight wire segment between the
+ * spiral positions x0 and x1, measured at the middle of the segment. The coil on each
+ * layer is only rotated and moved, so the deviation of the initial spiral is used.
+ *
+ * Parameters:
+ *  -   x0:         Position on the spiral at the start of the segment
+ *  -   x1:         Position on the spiral at the end of the segment
+ *  -   spacing:    Spacing between each curl (including the width)
+ */
+static double spiralDeviation(double x0, double x1, double spacing) {
+
+    // Start, end and middle points of the initial spiral
+    double xm = (x0 + x1)/2;
+    double ax = cos(2*M_PI*x0/spacing)*x0, ay = sin(2*M_PI*x0/spacing)*x0;
+    double bx = cos(2*M_PI*x1/spacing)*x1, by = sin(2*M_PI*x1/spacing)*x1;
+    double mx = cos(2*M_PI*xm/spacing)*xm, my = sin(2*M_PI*xm/spacing)*xm;
+
+    // Distance of the middle point from the line through the start and end points
+    double chordLength = sqrt(pow(bx - ax,2) + pow(by - ay,2));
+    return chordLength > 0 ? fabs((bx - ax)*(ay - my) - (ax - mx)*(by - ay)) / chordLength : 0;
+}
+
+/* chordStep
+ * Calculates the largest step of the spiral position x starting from the given position
+ * so that the straight wire segment deviates at most by tolerance from the real spiral.
+ * The step is chosen from the local radius of curvature of the Archimedean spiral
+ * r = b * theta (b = spacing / 2pi), which is rho = (r^2 + b^2)^(3/2) / (r^2 + 2b^2).
+ * A chord spanning the angle phi on a circle of radius rho deviates rho * (1 - cos(phi/2)),
+ * so phi = 2 * acos(1 - tolerance/rho). The spiral also moves outwards along the segment,
+ * so the estimate is checked against the real deviation and shortened when needed.
+ *
+ * Parameters:
+ *  -   x:          Position on the spiral at the start of the segment
+ *  -   spacing:    Spacing between each curl (including the width)
+ *  -   tolerance:  Maximum allowed deviation between the segment and the spiral
+ */
+static float chordStep(float x, float spacing, float tolerance) {
+
+    // Spiral constant and the radius of curvature at the current position
+    double b = spacing / (2*M_PI);
+    double rho = pow(x*x + b*b, 1.5) / (x*x + 2*b*b);
+
+    // Angle of the osculating circle spanned by the segment (at most a quarter turn)
+    double phi = tolerance < rho ? 2*acos(1 - tolerance/rho) : M_PI;
+    phi > M_PI_2 ? phi = M_PI_2 : phi;
+
+    // Convert the arc length on the osculating circle into a step of the spiral position
+    double xStep = b * rho * phi / sqrt(x*x + b*b);
+
+    // Shorten the step until the real deviation is within the tolerance (deviation grows with the square of the step)
+    double deviation = spiralDeviation(x, x + xStep, spacing);
+    for (int n = 0; n < 8 && deviation > tolerance; n++) {
+        xStep *= 0.99 * sqrt(tolerance / deviation);
+        deviation = spiralDeviation(x, x + xStep, spacing);
+    }
+
+    return (float)xStep;
+}
+/* spiralTangent
+ * Calculates the unit tangent of the initial spiral at the spiral position x.
+ *
+ * Parameters:
+ *  -   x:          Position on the spiral
+ *  -   spacing:    Spacing between each curl (including the width)
+ *  -   tangent:    Returned unit tangent
+ */
+static void spiralTangent(double x, double spacing, double tangent[2]) {
+
+    // Derivative of (x*cos(theta), x*sin(theta)) with theta = 2*pi*x/spacing
+    double theta = 2*M_PI*x/spacing;
+    double tx = cos(theta) - x*(2*M_PI/spacing)*sin(theta);
+    double ty = sin(theta) + x*(2*M_PI/spacing)*cos(theta);
+
+    double length = sqrt(tx*tx + ty*ty);
+    tangent[0] = tx / length;
+    tangent[1] = ty / length;
+}
+
+/* arcThrough
+ * Finds the circular arc leaving point a along the tangent and ending at point b.
+ * Returns 0 when the two points are on the tangent line (no arc, a straight segment).
+ *
+ * Parameters:
+ *  -   a:          Start point of the arc
+ *  -   tangent:    Unit tangent at the start point
+ *  -   b:          End point of the arc
+ *  -   center:     Returned center of the arc
+ *  -   radius:     Returned radius of the arc
+ *  -   mid:        Returned middle point of the arc
+ */
+static int arcThrough(double a[2], double tangent[2], double b[2], double center[2], double *radius, double mid[2]) {
+
+    // Normal of the tangent and the chord from a to b
+    double nx = -tangent[1], ny = tangent[0];
+    double wx = b[0] - a[0], wy = b[1] - a[1];
+    double den = 2 * (nx*wx + ny*wy);
+
+    // The middle of the chord is used when there is no arc
+    mid[0] = (a[0] + b[0])/2;
+    mid[1] = (a[1] + b[1])/2;
+    if (fabs(den) < 1e-9 * sqrt(wx*wx + wy*wy)) {
+        return 0;
+    }
+
+    // Signed radius along the normal and the center of the arc
+    double r = (wx*wx + wy*wy) / den;
+    center[0] = a[0] + nx*r;
+    center[1] = a[1] + ny*r;
+    *radius = fabs(r);
+
+    // Project the middle of the chord onto the circle (arcs are shorter than half a circle)
+    double mx = mid[0] - center[0], my = mid[1] - center[1];
+    double ml = sqrt(mx*mx + my*my);
+    mid[0] = center[0] + mx / ml * (*radius);
+    mid[1] = center[1] + my / ml * (*radius);
+    return 1;
+}
+
+/* biarcFit
+ * Fits two tangent continuous circular arcs (a biarc) to the initial spiral between the spiral
+ * positions x0 and x1. Both arcs have the tangent of the spiral at their outer ends and share
+ * the tangent at the joint, which is placed so that both tangent legs have the same length.
+ * Returns the largest distance of the spiral from the biarc, sampled along the piece.
+ *
+ * Parameters:
+ *  -   x0:         Position on the spiral at the start of the biarc
+ *  -   x1:         Position on the spiral at the end of the biarc
+ *  -   spacing:    Spacing between each curl (including the width)
+ *  -   points:     Returned start, middle of the first arc, joint, middle of the second arc and end
+ *  -   isArc:      Returned 1 for each arc, 0 if the part is a straight segment
+ */
+static double biarcFit(double x0, double x1, double spacing, double points[5][2], int isArc[2]) {
+
+    // End points and end tangents of the piece
+    double t0[2], t1[2], reverse[2];
+    points[0][0] = cos(2*M_PI*x0/spacing)*x0;
+    points[0][1] = sin(2*M_PI*x0/spacing)*x0;
+    points[4][0] = cos(2*M_PI*x1/spacing)*x1;
+    points[4][1] = sin(2*M_PI*x1/spacing)*x1;
+    spiralTangent(x0, spacing, t0);
+    spiralTangent(x1, spacing, t1);
+
+    // Solve |(p0 + d*t0) - (p1 - d*t1)| = 2d for the length d of the tangent legs
+    double vx = points[4][0] - points[0][0], vy = points[4][1] - points[0][1];
+    double vt = vx*(t0[0] + t1[0]) + vy*(t0[1] + t1[1]);
+    double vv = vx*vx + vy*vy;
+    double den = 2 * (1 - (t0[0]*t1[0] + t0[1]*t1[1]));
+    double d = den > 1e-12 ? (-vt + sqrt(vt*vt + den*vv)) / den : vv / (2*vt);
+
+    // The joint is in the middle of the two tangent legs
+    points[2][0] = (points[0][0] + d*t0[0] + points[4][0] - d*t1[0]) / 2;
+    points[2][1] = (points[0][1] + d*t0[1] + points[4][1] - d*t1[1]) / 2;
+
+    // First arc from the start to the joint, second arc from the end back to the joint
+    double c0[2], c1[2], r0 = 0, r1 = 0;
+    reverse[0] = -t1[0];
+    reverse[1] = -t1[1];
+    isArc[0] = arcThrough(points[0], t0, points[2], c0, &r0, points[1]);
+    isArc[1] = arcThrough(points[4], reverse, points[2], c1, &r1, points[3]);
+
+    // Sample the spiral inside the piece and measure its distance to the closest arc
+    double error = 0;
+    for (int n = 1; n < 8; n++) {
+        double x = x0 + (x1 - x0) * n / 8;
+        double px = cos(2*M_PI*x/spacing)*x, py = sin(2*M_PI*x/spacing)*x;
+        double e0 = isArc[0] ? fabs(sqrt(pow(px - c0[0],2) + pow(py - c0[1],2)) - r0) : fabs(t0[0]*(points[0][1] - py) - t0[1]*(points[0][0] - px));
+        double e1 = isArc[1] ? fabs(sqrt(pow(px - c1[0],2) + pow(py - c1[1],2)) - r1) : fabs(t1[0]*(points[4][1] - py) - t1[1]*(points[4][0] - px));
+        double e = e0 < e1 ? e0 : e1;
+        e > error ? error = e : error;
+    }
+
+    return error;
+}
+
+/* coilNow
+ * Returns the time in seconds from a monotonic clock, used to time the phases of the run.
+ */
+double coilNow(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+/* coilTagHash
+ * Hashes the tag of the generated items (FNV-1a). The first 48 bits of the hash start the uuid
+ * of every generated item, so the items of a tag can be found again on the board.
+ *
+ * Parameters:
+ *  -   tag:        Name of the group of the generated items
+ */
+unsigned long long coilTagHash(const char *tag) {
+    unsigned long long hash = 14695981039346656037ULL;
+    for (const char *c = tag; *c; c++) {
+        hash ^= (unsigned char)*c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/* coilUuid
+ * Formats the uuid of a generated item: the hash of the tag, the coil, the kind and the layer of
+ * the item and its index. The uuids are valid, unique and the same on every run with the same tag.
+ * The low 12 bits of the coil share a group with the version, the next 12 bits sit above the
+ * 36 bits of the index in the last group, so the uuids of the first 4096 coils stay the same.
+ * Returns the formatted uuid.
+ *
+ * Parameters:
+ *  -   out:        Text to write the uuid into (at least 37 characters)
+ *  -   tag:        Hash of the tag (coilTagHash)
+ *  -   coil:       Index of the coil
+ *  -   layer:      Index of the copper layer
+ *  -   kind:       Kind of the item (0 tracks, 1 vias, 2 via connections, 3 group, 4 outline)
+ *  -   index:      Index of the item
+ */
+char *coilUuid(char *out, unsigned long long tag, int coil, int layer, int kind, long index) {
+    static const char hex[] = "0123456789abcdef";
+    unsigned long long fields[5] = {tag >> 32, (tag >> 16) & 0xffff, 0x4000 | (coil & 0xfff), 0x8000 | ((kind & 0xf) << 8) | (layer & 0xff), ((unsigned long long)((coil >> 12) & 0xfff) << 36) | ((unsigned long long)index & 0xfffffffffULL)};
+    int widths[5] = {8, 4, 4, 4, 12};
+
+    char *c = out;
+    for (int f = 0; f < 5; f++) {
+        for (int d = widths[f] - 1; d >= 0; d--) {
+            *c++ = hex[(fields[f] >> (4*d)) & 0xf];
+        }
+        *c++ = '-';
+    }
+    c[-1] = '\0';
+
+    return out;
+}
+
+/* fixedFormat
+ * Formats a number with a fixed number of decimal digits into the given text without using
+ * the locale aware stdio formatting. The number is rounded to an integer of the smallest
+ * decimal unit and split into its integer and fractional digits.
+ * Returns the end of the formatted text.
+ *
+ * Parameters:
+ *  -   out:        Text to write the number into
+ *  -   value:      Number to format
+ *  -   digits:     Number of decimal digits (0 to 9)
+ *  -   trim:       Remove the trailing zeros of the decimals (1) or not (0)
+ */
+static char *fixedFormat(char *out, double value, int digits, int trim) {
+    static const double scale[10] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9};
+
+    // Numbers out of the range of the integer conversion are left to the C library
+    double scaled = fabs(value) * scale[digits];
+    if (!(scaled < 9e18)) {
+        return out + snprintf(out, 32, "%.*g", 17, value);
+    }
+
+    // Round to the smallest decimal unit and split into the integer and fractional parts
+    unsigned long long units = (unsigned long long)(scaled + 0.5);
+    unsigned long long whole = units / (unsigned long long)scale[digits];
+    unsigned long long fraction = units % (unsigned long long)scale[digits];
+
+    // Only print the sign when the rounded number is not zero
+    if (value < 0 && units != 0) {
+        *out++ = '-';
+    }
+
+    // Integer digits (written backwards first, two digits per division)
+    char text[24];
+    int length = 0;
+    while (whole >= 100) {
+        const char *pair = &DIGIT_PAIRS[2*(whole % 100)];
+        text[length++] = pair[1];
+        text[length++] = pair[0];
+        whole /= 100;
+    }
+    if (whole >= 10) {
+        text[length++] = DIGIT_PAIRS[2*whole + 1];
+        text[length++] = DIGIT_PAIRS[2*whole];
+    } else {
+        text[length++] = '0' + whole;
+    }
+    while (length) {
+        *out++ = text[--length];
+    }
+
+    // Decimal digits, optionally without the trailing zeros
+    int d = digits;
+    for (; d >= 2; d -= 2) {
+        const char *pair = &DIGIT_PAIRS[2*(fraction % 100)];
+        text[d-1] = pair[1];
+        text[d-2] = pair[0];
+        fraction /= 100;
+    }
+    d ? text[0] = '0' + fraction : 0;
+    length = digits;
+    if (trim) {
+        while (length > 0 && text[length-1] == '0') {
+            length--;
+        }
+    }
+    if (length > 0) {
+        *out++ = '.';
+        memcpy(out, text, length);
+        out += length;
+    }
+
+    return out;
+}
+
+/* coilWriterFlush
+ * Writes the content of the output buffer into the file and empties the buffer.
+ *
+ * Parameters:
+ *  -   writer:     Output buffer to flush
+ */
+void coilWriterFlush(CoilWriter *writer) {
+    double begin = coilNow();
+    if (writer->length > 0 && fwrite(writer->buffer, 1, writer->length, writer->fp) != writer->length) {
+        writer->error = 1;
+    }
+    writer->written += writer->length;
+    writer->length = 0;
+    writer->time += coilNow() - begin;
+}
+
+/* coilWriterPrintf
+ * Formats a single record into the output buffer, flushing the buffer first when it is full.
+ * Supports a subset of the printf conversions used by the footprint records:
+ *  -   %f:         Coordinate with the digits (and trimming) of the writer
+ *  -   %.Nf:       Number with exactly N decimal digits
+ *  -   %d:         Integer
+ *  -   %s:         Text
+ *
+ * Parameters:
+ *  -   writer:     Output buffer to write into
+ *  -   format:     Format of the record (at most WRITER_RECORD bytes when formatted)
+ */
+void coilWriterPrintf(CoilWriter *writer, const char *format, ...) {
+
+    // Make sure that the whole record fits into the buffer (in-memory buffers grow instead)
+    if (writer->length + WRITER_RECORD > writer->size) {
+        if (writer->fp) {
+            coilWriterFlush(writer);
+        } else {
+            char *buffer = realloc(writer->buffer, 2*writer->size);
+            if (buffer == NULL) {
+                writer->error = 1;
+                writer->length = 0;
+            } else {
+                writer->buffer = buffer;
+                writer->size *= 2;
+            }
+        }
+    }
+
+    char *out = writer->buffer + writer->length;
+
+    va_list args;
+    va_start(args, format);
+    for (const char *c = format; *c; c++) {
+        // Copy the text between the conversions
+        if (*c != '%') {
+            *out++ = *c;
+            continue;
+        }
+
+        // Optional fixed number of decimal digits
+        int digits = writer->digits, trim = writer->trim;
+        if (*++c == '.') {
+            digits = c[1] - '0';
+            trim = 0;
+            c += 2;
+        }
+
+        if (*c == 'f') {
+            out = fixedFormat(out, va_arg(args, double), digits, trim);
+        } else if (*c == 'd') {
+            int value = va_arg(args, int);
+            out = fixedFormat(out, value, 0, 0);
+        } else if (*c == 's') {
+            const char *text = va_arg(args, const char *);
+            size_t length = strlen(text);
+            memcpy(out, text, length);
+            out += length;
+        } else {
+            *out++ = *c;
+        }
+    }
+    va_end(args);
+
+    writer->length = out - writer->buffer;
+}
+
+/* coilWriterAppend
+ * Appends the records of an in-memory writer (work unit) to the output buffer. Records that
+ * do not fit into the output buffer are written into the file directly.
+ *
+ * Parameters:
+ *  -   writer:     Output buffer to write into
+ *  -   unit:       In-memory writer to append
+ */
+void coilWriterAppend(CoilWriter *writer, const CoilWriter *unit) {
+    if (writer->length + unit->length > writer->size) {
+        coilWriterFlush(writer);
+    }
+
+    if (unit->length > writer->size) {
+        double begin = coilNow();
+        if (fwrite(unit->buffer, 1, unit->length, writer->fp) != unit->length) {
+            writer->error = 1;
+        }
+        writer->written += unit->length;
+        writer->time += coilNow() - begin;
+    } else {
+        memcpy(writer->buffer + writer->length, unit->buffer, unit->length);
+        writer->length += unit->length;
+    }
+
+    unit->error ? writer->error = 1 : 0;
+}
+
+/* unitSetup
+ * Finds the coil, the layer and the wire segments of a work unit from its index. The units
+ * follow the order of the file: coil by coil, layer by layer, chunk by chunk.
+ *
+ * Parameters:
+ *  -   gen:        Parameters of the run
+ *  -   index:      Index of the work unit
+ *  -   unit:       Work unit to set up
+ */
+static void unitSetup(const Generator *gen, int index, Unit *unit) {
+    int rest = index % gen->unitsPerCoil;
+    int i = 0;
+
+    while (rest >= gen->plan[i].chunks) {
+        rest -= gen->plan[i++].chunks;
+    }
+
+    unit->coil = index / gen->unitsPerCoil;
+    unit->layer = i;
+
+    // Long uniform layers are split into chunks of UNIT_SIZE wire segments
+    unit->first = rest * UNIT_SIZE;
+    unit->last = gen->plan[i].chunks > 1 && unit->first + UNIT_SIZE < gen->plan[i].segments ? unit->first + UNIT_SIZE : gen->plan[i].segments;
+}
+
+/* templatePoint
+ * Adds a point of the initial spiral to the template of a layer, growing it when it is full.
+ * Returns 1 when the point could not be added.
+ *
+ * Parameters:
+ *  -   layout:     Template of the layer
+ *  -   px:         X coordinate of the point on the initial spiral
+ *  -   py:         Y coordinate of the point on the initial spiral
+ */
+static int templatePoint(Template *layout, double px, double py) {
+    if (layout->length == layout->capacity) {
+        int capacity = layout->capacity ? 2*layout->capacity : 1024;
+        double *points = realloc(layout->points, 2 * capacity * sizeof(double));
+        if (points == NULL) {
+            return 1;
+        }
+        layout->points = points;
+        layout->capacity = capacity;
+    }
+
+    layout->points[2*layout->length] = px;
+    layout->points[2*layout->length + 1] = py;
+    layout->length++;
+
+    return 0;
+}
+
+/* templateRecord
+ * Adds a record of a polygon layer to its template: the middle point and the end point of the
+ * record, which is an arc (isArc) or a straight segment. Returns 1 when it could not be added.
+ *
+ * Parameters:
+ *  -   layout:     Template of the layer (isArc allocated for all its records)
+ *  -   isArc:      Arc (1) or straight segment (0)
+ *  -   mid:        Middle point of the record
+ *  -   end:        End point of the record
+ */
+static int templateRecord(Template *layout, int isArc, const double mid[2], const double end[2]) {
+    int error = templatePoint(layout, mid[0], mid[1]);
+    error |= templatePoint(layout, end[0], end[1]);
+    !error ? layout->isArc[layout->records++] = isArc : 0;
+    return error;
+}
+
+/* templatePolygon
+ * Calculates the sides of one layer of the polygon coils: one straight segment from corner to
+ * corner, so a turn only takes as many records as the polygon has sides. The corners can be cut
+ * off (chamfer, a 45 degree cut on a square) or rounded (fillet, an arc tangent to both sides).
+ * A corner takes at most half of each of its sides, so the corners never overlap.
+ * Returns 1 when the template could not be allocated.
+ *
+ * Parameters:
+ *  -   gen:        Parameters of the run
+ *  -   layer:      Index of the copper layer
+ *  -   layout:     Returned template of the layer
+ */
+static int templatePolygon(const Generator *gen, int layer, Template *layout) {
+    double xFirst = gen->start, xLast = gen->plan[layer].last;
+    double side = gen->spacing/gen->sides;
+    double offset = gen->cornerAngle*gen->spacing/(2*M_PI);
+
+    // Corners between the first and the last point of the layer
+    long first = (long)floor((xFirst - offset)/side) + 1;
+    long last = (long)ceil((xLast - offset)/side) - 1;
+    long corners = last >= first ? last - first + 1 : 0;
+
+    // Every corner takes at most two records, followed by the last side
+    layout->isArc = malloc((2*corners + 1) * sizeof(unsigned char));
+    if (layout->isArc == NULL) {
+        return 1;
+    }
+
+    double prev[2], corner[2], next[2], end[2], mid[2], in[2], out[2];
+    polygonPoint(gen, xFirst, prev);
+    polygonPoint(gen, xLast, end);
+    int error = templatePoint(layout, prev[0], prev[1]);
+    double from[2] = {prev[0], prev[1]};    // End of the last record
+
+    for (long k = first; k <= last && !error; k++) {
+        polygonCorner(gen, k, corner);
+        k < last ? polygonCorner(gen, k+1, next) : (void)(next[0] = end[0], next[1] = end[1]);
+
+        // Directions and lengths of the sides before and after the corner
+        double lengthIn = hypot(corner[0] - prev[0], corner[1] - prev[1]);
+        double lengthOut = hypot(next[0] - corner[0], next[1] - corner[1]);
+        in[0] = lengthIn > 0 ? (corner[0] - prev[0])/lengthIn : 0;
+        in[1] = lengthIn > 0 ? (corner[1] - prev[1])/lengthIn : 0;
+        out[0] = lengthOut > 0 ? (next[0] - corner[0])/lengthOut : 0;
+        out[1] = lengthOut > 0 ? (next[1] - corner[1])/lengthOut : 0;
+
+        // Length of the sides taken by the corner (the tangent length of a fillet)
+        double turn = acos(fmax(-1, fmin(1, in[0]*out[0] + in[1]*out[1])));
+        double cut = gen->fillet > 0 ? gen->fillet*tan(turn/2) : gen->chamfer;
+        cut = fmin(cut, fmin(lengthIn, lengthOut)/2);
+
+        if (cut > 0) {
+            double a[2] = {corner[0] - cut*in[0], corner[1] - cut*in[1]};
+            double b[2] = {corner[0] + cut*out[0], corner[1] + cut*out[1]};
+
+            // Side up to the corner (none when the corner before took the rest of the side)
+            mid[0] = (from[0] + a[0])/2;
+            mid[1] = (from[1] + a[1])/2;
+            hypot(a[0] - from[0], a[1] - from[1]) > 1e-9 ? error |= templateRecord(layout, 0, mid, a) : 0;
+
+            // Rounded corner through the middle of the arc, or the cut
+            if (gen->fillet > 0) {
+                double bisector[2] = {out[0] - in[0], out[1] - in[1]};
+                double length = hypot(bisector[0], bisector[1]);
+                double radius = cut/tan(turn/2);
+                double depth = radius/cos(turn/2) - radius;     // From the corner to the middle of the arc
+                mid[0] = corner[0] + bisector[0]/length*depth;
+                mid[1] = corner[1] + bisector[1]/length*depth;
+                error |= templateRecord(layout, 1, mid, b);
+            } else {
+                mid[0] = (a[0] + b[0])/2;
+                mid[1] = (a[1] + b[1])/2;
+                error |= templateRecord(layout, 0, mid, b);
+            }
+            from[0] = b[0];
+            from[1] = b[1];
+        } else {
+            // Sharp corner
+            mid[0] = (from[0] + corner[0])/2;
+            mid[1] = (from[1] + corner[1])/2;
+            error |= templateRecord(layout, 0, mid, corner);
+            from[0] = corner[0];
+            from[1] = corner[1];
+        }
+
+        prev[0] = corner[0];
+        prev[1] = corner[1];
+    }
+
+    // Last side up to the last point of the layer
+    mid[0] = (from[0] + end[0])/2;
+    mid[1] = (from[1] + end[1])/2;
+    error |= templateRecord(layout, 0, mid, end);
+
+    return error;
+}
+
+/* templateBuild
+ * Calculates the adaptive wire segments or the arcs of one layer on the initial spiral. They only
+ * depend on the spiral, so the template is calculated once and shared by every coil of the run,
+ * which only moves it onto its place (generateUnit). The points are calculated exactly as
+ * coilPoint does, so the coils are the same as if each of them was calculated on its own.
+ * Returns 1 when the template could not be allocated.
+ *
+ * Parameters:
+ *  -   gen:        Parameters of the run
+ *  -   layer:      Index of the copper layer
+ *  -   layout:     Returned template of the layer
+ */
+static int templateBuild(const Generator *gen, int layer, Template *layout) {
+    double start = gen->start, spacing = gen->spacing;
+    int error = 0;
+
+    layout->records = 0;
+    layout->length = 0;
+    layout->capacity = 0;
+    layout->points = NULL;
+    layout->isArc = NULL;
+    layout->deviation = 0;
+
+    // Polygon coils only need their corners
+    if (gen->sides > 0) {
+        return templatePolygon(gen, layer, layout);
+    }
+
+    // Position of the last point of the layer
+    double xLast = gen->plan[layer].last;
+
+    // First point of the layer
+    double x = start;
+    error |= templatePoint(layout, cos(2*M_PI*x/spacing)*x, sin(2*M_PI*x/spacing)*x);
+
+    // Arcs fitted to the spiral: the middle point, the joint and the middle point of every biarc and its end
+    if (gen->arcTolerance > 0) {
+
+        // Start with pieces of a quarter turn
+        double arcStep = spacing/4;
+        int arcCapacity = 0;
+
+        while (x < xLast && !error) {
+
+            // Fit a biarc to the piece and halve the piece until the biarc is within the tolerance
+            double xArcEnd = fmin(x + arcStep, xLast);
+            double points[5][2];
+            int isArc[2];
+            double deviation = biarcFit(x, xArcEnd, spacing, points, isArc);
+            while (deviation > gen->arcTolerance && xArcEnd - x > 1e-6) {
+                xArcEnd = x + (xArcEnd - x)/2;
+                deviation = biarcFit(x, xArcEnd, spacing, points, isArc);
+            }
+            deviation > layout->deviation ? layout->deviation = deviation : layout->deviation;
+
+            // Let the next piece grow again (at most a quarter turn)
+            arcStep = fmin(2*(xArcEnd - x), spacing/4);
+
+            for (int n = 1; n < 4; n++) {
+                error |= templatePoint(layout, points[n][0], points[n][1]);
+            }
+            error |= templatePoint(layout, cos(2*M_PI*xArcEnd/spacing)*xArcEnd, sin(2*M_PI*xArcEnd/spacing)*xArcEnd);
+
+            // Both halves of the biarc are arcs or straight segments
+            if (layout->records + 2 > arcCapacity) {
+                arcCapacity = arcCapacity ? 2*arcCapacity : 1024;
+                unsigned char *arcs = realloc(layout->isArc, arcCapacity);
+                arcs == NULL ? error = 1 : (layout->isArc = arcs, 0);
+            }
+            if (!error) {
+                layout->isArc[layout->records++] = isArc[0];
+                layout->isArc[layout->records++] = isArc[1];
+            }
+
+            x = xArcEnd;
+        }
+
+        return error;
+    }
+
+    // Wire segments sized to the curvature of the spiral: the end of every segment
+    while (x < xLast && !error) {
+
+        // Respective position of the end of the segment
+        double xBegin = x;
+        double xStep = chordStep(x, spacing, gen->tolerance);   // Step as far as the curvature allows
+        xStep = x + xStep > x ? xStep : gen->step;              // Failsafe when the tolerance rounds the step to 0
+
+        // Finish exactly on the last point of the layer without leaving a tiny segment behind
+        if (xLast - x <= xStep) {
+            x = xLast;
+        } else if (xLast - x < 2*xStep) {
+            x += (xLast - x)/2;
+        } else {
+            x += xStep;
+        }
+
+        // Measure how far the spiral deviates from the segment at its middle
+        double xMid = (xBegin + x)/2;
+        double *prev = &layout->points[2*(layout->length - 1)];
+        double xPrev = prev[0], yPrev = prev[1];
+        double xNext = cos(2*M_PI*x/spacing)*x, yNext = sin(2*M_PI*x/spacing)*x;
+        double pxMid = cos(2*M_PI*xMid/spacing)*xMid, pyMid = sin(2*M_PI*xMid/spacing)*xMid;
+
+        double chordLength = sqrt(pow(xNext - xPrev,2) + pow(yNext - yPrev,2));
+        double deviation = chordLength > 0 ? fabs((xNext - xPrev)*(yPrev - pyMid) - (xPrev - pxMid)*(yNext - yPrev)) / chordLength : 0;
+        deviation > layout->deviation ? layout->deviation = deviation : layout->deviation;
+
+        error |= templatePoint(layout, xNext, yNext);
+        layout->records++;
+    }
+
+    return error;
+}
+
+/* unitReserve
+ * Makes room for the given number of items in a work unit and empties it.
+ * Returns 1 when the items could not be allocated.
+ *
+ * Parameters:
+ *  -   unit:       Work unit to fill
+ *  -   count:      Number of items needed
+ */
+static int unitReserve(Unit *unit, int count) {
+    unit->count = 0;
+    if (count > unit->capacity) {
+        CoilItem *items = realloc(unit->items, count * sizeof(CoilItem));
+        if (items == NULL) {
+            return 1;
+        }
+        unit->items = items;
+        unit->capacity = count;
+    }
+    return 0;
+}
+
+/* unitItem
+ * Adds an item to a work unit (unitReserve made room for it).
+ *
+ * Parameters:
+ *  -   unit:       Work unit to add the item to
+ *  -   kind:       Kind of the item (COIL_SEGMENT, COIL_ARC, COIL_VIA or COIL_LINK)
+ *  -   layer:      Index of the copper layer
+ *  -   index:      Index of the item within its coil, layer and kind
+ *  -   x0, y0:     Start point (center of a via)
+ *  -   x1, y1:     End point
+ *  -   width:      Width of the track (size of a via)
+ */
+static CoilItem *unitItem(Unit *unit, int kind, int layer, long index, double x0, double y0, double x1, double y1, double width) {
+    CoilItem *item = &unit->items[unit->count++];
+    item->kind = kind;
+    item->coil = unit->coil;
+    item->layer = layer;
+    item->index = index;
+    item->start[0] = x0;
+    item->start[1] = y0;
+    item->mid[0] = (x0 + x1)/2;
+    item->mid[1] = (y0 + y1)/2;
+    item->end[0] = x1;
+    item->end[1] = y1;
+    item->width = width;
+    return item;
+}
+
+/* toNanometers
+ * Rounds a coordinate (mm) to whole nanometers, the internal unit of KiCAD.
+ *
+ * Parameters:
+ *  -   value:      Coordinate to round
+ */
+static long long toNanometers(double value) {
+    return llround(value * 1e6);
+}
+
+/* unitSnap
+ * Snaps the items of a work unit to whole nanometers (nanometer engine). Tracks that become a
+ * single point are removed, arcs whose three points fall onto one line become straight segments,
+ * and the items left are numbered again so their uuids stay consecutive. The counters of the
+ * wire segments and arcs of the unit are counted again.
+ * Returns the number of items removed.
+ *
+ * Parameters:
+ *  -   unit:       Work unit to snap
+ */
+static int unitSnap(Unit *unit) {
+    long next[4] = {0, 0, 0, 0};    // Next index of each kind of item (arcs share the index of the segments)
+    int kept = 0;
+
+    unit->segments = 0;
+    unit->arcs = 0;
+
+    for (int n = 0; n < unit->count; n++) {
+        CoilItem item = unit->items[n];
+
+        // Whole nanometers of the points
+        long long start[2] = {toNanometers(item.start[0]), toNanometers(item.start[1])};
+        long long mid[2] = {toNanometers(item.mid[0]), toNanometers(item.mid[1])};
+        long long end[2] = {toNanometers(item.end[0]), toNanometers(item.end[1])};
+
+        // A track of a single point is left out, the next one starts on the same point
+        if (item.kind != COIL_VIA && start[0] == end[0] && start[1] == end[1]) {
+            continue;
+        }
+
+        // Arcs without a curvature left are straight segments
+        if (item.kind == COIL_ARC && (mid[0] - start[0])*(end[1] - start[1]) == (mid[1] - start[1])*(end[0] - start[0])) {
+            item.kind = COIL_SEGMENT;
+            mid[0] = (start[0] + end[0])/2;
+            mid[1] = (start[1] + end[1])/2;
+        }
+
+        for (int d = 0; d < 2; d++) {
+            item.start[d] = start[d] / 1e6;
+            item.mid[d] = mid[d] / 1e6;
+            item.end[d] = end[d] / 1e6;
+        }
+
+        item.index = next[item.kind == COIL_ARC ? COIL_SEGMENT : item.kind]++;
+        item.kind == COIL_SEGMENT ? unit->segments++ : (item.kind == COIL_ARC ? unit->arcs++ : 0);
+        unit->items[kept++] = item;
+    }
+
+    int removed = unit->count - kept;
+    unit->count = kept;
+    return removed;
+}
+
+/* unitView
+ * Describes a work unit to the sink.
+ *
+ * Parameters:
+ *  -   gen:        Parameters of the run
+ *  -   unit:       Work unit to describe
+ *  -   view:       Returned description of the unit
+ */
+static void unitView(const Generator *gen, const Unit *unit, CoilUnit *view) {
+    view->coil = unit->coil;
+    view->layer = unit->layer;
+    view->chunk = unit->layer < 0 ? 0 : unit->first / UNIT_SIZE;
+    view->chunks = unit->layer < 0 ? 1 : gen->plan[unit->layer].chunks;
+    view->first = unit->first;
+    view->items = unit->items;
+    view->count = unit->count;
+    view->text = gen->sink->format != NULL ? &unit->writer : NULL;
+}
+
+/* unitFormat
+ * Formats the items of a work unit into its in-memory writer with the formatter of the sink.
+ *
+ * Parameters:
+ *  -   gen:        Parameters of the run
+ *  -   unit:       Work unit to format
+ */
+static void unitFormat(const Generator *gen, Unit *unit) {
+    if (gen->sink->format != NULL) {
+        CoilUnit view;
+        unitView(gen, unit, &view);
+        unit->writer.length = 0;
+        gen->sink->format(gen->sink->context, gen->params, &view, &unit->writer);
+    }
+}
+
+/* generateUnit
+ * Generates the wire segments (or arcs) of a work unit into its list of items and formats them
+ * with the formatter of the sink. Every point is calculated from its position on the spiral, so
+ * the units are independent of each other and give the same items as generating the whole layer at once.
+ *
+ * Parameters:
+ *  -   gen:        Parameters of the run
+ *  -   unit:       Work unit to generate (unitSetup)
+ */
+static void generateUnit(const Generator *gen, Unit *unit) {
+    int k = unit->coil, i = unit->layer;
+    double start = gen->start, step = gen->step, spacing = gen->spacing;
+
+    // Dummy variables for the loop
+    double xPrev, yPrev, xNext, yNext;
+
+    // Transform of the layer and the points of the current block
+    double transform[6], xBlock[BLOCK_SIZE], yBlock[BLOCK_SIZE];
+
+    unit->segments = 0;
+    unit->arcs = 0;
+    unit->deviation = 0;
+    unit->points = 0;
+
+    // Calculate the transform of the layer once and the first point of the layer
+    layerTransform(gen, k, i, transform);
+
+    // Move the template of the layer (adaptive wire segments, arcs or polygon sides) onto the coil
+    if (gen->templates != NULL) {
+        const Template *layout = &gen->templates[i];
+        const double *points = layout->points;
+        double xMid, yMid;
+
+        unit->error = unitReserve(unit, layout->records);
+        if (unit->error) {
+            return;
+        }
+
+        coilTransform(points[0], points[1], transform, &xPrev, &yPrev);
+
+        for (int j = 0; j < layout->records; j++) {
+            if (layout->isArc != NULL) {
+                // Both halves of a biarc share the joint, so the points of record j are 2j, 2j+1 and 2j+2
+                coilTransform(points[4*j + 2], points[4*j + 3], transform, &xMid, &yMid);
+                coilTransform(points[4*j + 4], points[4*j + 5], transform, &xNext, &yNext);
+
+                // Add the arc (or a straight segment if there is no arc)
+                if (layout->isArc[j]) {
+                    CoilItem *item = unitItem(unit, COIL_ARC, i, j, xPrev, yPrev, xNext, yNext, gen->width);
+                    item->mid[0] = xMid;
+                    item->mid[1] = yMid;
+                    unit->arcs++;
+                } else {
+                    unitItem(unit, COIL_SEGMENT, i, j, xPrev, yPrev, xNext, yNext, gen->width);
+                    unit->segments++;
+                }
+            } else {
+                coilTransform(points[2*j + 2], points[2*j + 3], transform, &xNext, &yNext);
+
+                // Add the wire segment
+                unitItem(unit, COIL_SEGMENT, i, j, xPrev, yPrev, xNext, yNext, gen->width);
+                unit->segments++;
+            }
+
+            // The end of this record is the start of the next one
+            xPrev = xNext;
+            yPrev = yNext;
+        }
+
+        unit->deviation = layout->deviation;
+        unit->points = unit->segments + unit->arcs + 1;
+    } else {
+        unit->error = unitReserve(unit, unit->last - unit->first);
+        if (unit->error) {
+            return;
+        }
+
+        // First point of the layer
+        coilPoint(start, spacing, transform, &xPrev, &yPrev);
+
+        // A chunk starts on the last point of the block before it, calculated exactly as that block does
+        if (unit->first > 0) {
+            coilBlock(start, step, spacing, unit->first - BLOCK_SIZE + 1, gen->rotation, transform, xBlock, yBlock);
+            xPrev = xBlock[BLOCK_SIZE-1];
+            yPrev = yBlock[BLOCK_SIZE-1];
+        }
+
+        // Iterate through each block of positions of the unit
+        for (int j = unit->first; j < unit->last; j += BLOCK_SIZE) {
+
+            // Calculate the end points of the next block of wire segments
+            int n = unit->last - j < BLOCK_SIZE ? unit->last - j : BLOCK_SIZE;
+            coilBlock(start, step, spacing, j+1, gen->rotation, transform, xBlock, yBlock);
+
+            // Add the wire segments
+            for (int m = 0; m < n; m++) {
+                unitItem(unit, COIL_SEGMENT, i, j+m, xPrev, yPrev, xBlock[m], yBlock[m], gen->width);
+
+                // The end of this segment is the start of the next one
+                xPrev = xBlock[m];
+                yPrev = yBlock[m];
+            }
+            unit->segments += n;
+        }
+
+        // The first point of the layer belongs to its first chunk
+        unit->points = unit->segments + (unit->first == 0);
+    }
+
+    // Snap to whole nanometers, the nanometer engine keeps every layer in a single unit
+    if (gen->nanometers) {
+        unitSnap(unit);
+        unit->points = unit->segments + unit->arcs + 1;
+    }
+
+    // Format the items on this thread
+    unitFormat(gen, unit);
+}
+
+/* poolWorker
+ * Thread of the pool. Takes the next work unit and generates it, as long as the unit stays
+ * within the window of units ahead of the sink.
+ *
+ * Parameters:
+ *  -   arg:        Pool of the work units
+ */
+static void *poolWorker(void *arg) {
+    Pool *pool = arg;
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->next < pool->total) {
+
+        // Wait for the writer to free a place in the window
+        if (pool->next >= pool->written + pool->window) {
+            pthread_cond_wait(&pool->changed, &pool->lock);
+            continue;
+        }
+
+        int index = pool->next++;
+        Unit *unit = &pool->units[index % pool->window];
+        pthread_mutex_unlock(&pool->lock);
+
+        unitSetup(pool->gen, index, unit);
+        generateUnit(pool->gen, unit);
+
+        pthread_mutex_lock(&pool->lock);
+        unit->done = 1;
+        pthread_cond_broadcast(&pool->changed);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+/* generatorExact
+ * Calculates the geometry of the layers and the centers of the coils again in double precision
+ * for the nanometer engine, the same way coilGenerate does in float. Only the positions change:
+ * the number of steps of each layer and the side each coil of a motor is turned to stay the ones
+ * of the float calculation, so both engines give the same coils.
+ *
+ * Parameters:
+ *  -   params:     Parameters of the coils
+ *  -   count:      Number of coils
+ *  -   layout:     Layout of the coils (0 circle, 1 linear, 2 grid)
+ *  -   columns:    Columns of the linear and grid layouts
+ *  -   gen:        Parameters of the run to update (centers already placed in float)
+ */
+static void generatorExact(const CoilParams *params, int count, int layout, int columns, Generator *gen) {
+    int layers = gen->layers, sides = gen->sides;
+    int innerVias = layers > 2 ? (int)ceil((layers - 0.5)/2) : 1;
+    double viaSize = params->viaSize, spacing = params->spacing + params->width;
+    double innerRadius = count > 1 && layout == 0 ? 0 : params->innerRadius;
+
+    // Start and end positions, the step and the angle difference of the spaced spiral
+    double start = innerRadius + viaSize * innerVias * (layers > 2 ? 2.0/3 : 0.5);
+    double end = params->turns * spacing + start;
+    double theta = 2*M_PI*end/spacing;
+    gen->start = start;
+    gen->step = params->resolution / start / params->turns * 2;
+    gen->spacing = spacing;
+    gen->angle = atan2(sin(theta), cos(theta));
+    gen->viaAngle = 2*M_PI / innerVias;
+    gen->width = params->width;
+    gen->cornerAngle = gen->angle + (sides > 0 ? M_PI/sides : 0);
+
+    // Motor radius and the pitch of the coils
+    double extent = sides > 0 ? end/cos(M_PI/sides) : end;
+    double motorAngle = 2*M_PI/count;
+    double motorRadius = count > 1 && layout == 0 ? params->innerRadius + extent/cos( ( M_PI - motorAngle )/2 ) + spacing : 0;
+    double motorRotate = count > 1 && layout == 0 ? params->rotate : 0;
+    double coilPitch = 2*(layers > 2 ? extent + viaSize + 1.0/3 + viaSize/2 : extent + viaSize/2) + spacing;
+    double pitchX = params->pitchX == 0 ? coilPitch : params->pitchX;
+    double pitchY = params->pitchY == 0 ? coilPitch : params->pitchY;
+
+    for (int k = 0; k < count; k++) {
+        if (layout == 0) {
+            gen->coilX[k] = cos(motorRotate) * motorRadius*cos(motorAngle * (k+1)) + sin(motorRotate)*motorRadius*sin(motorAngle * (k+1));
+            gen->coilY[k] = -sin(motorRotate) * motorRadius*cos(motorAngle * (k+1)) + cos(motorRotate) * motorRadius*sin(motorAngle * (k+1));
+        } else {
+            gen->coilX[k] = params->startX + (k % columns) * pitchX;
+            gen->coilY[k] = params->startY + (k / columns) * pitchY;
+        }
+
+        // Rotation of the coil, turned the same way as in float
+        gen->coilRotate[k] = gen->coilRotate[k] == (float)params->rotate ? params->rotate : -params->rotate;
+    }
+}
+/* layerPlan
+ * Plans the layout of the copper layers once per run: the number of uniform steps of each layer
+ * (its end moved by its via position and by the outer via of the layers in between), its work units,
+ * side and turn, the start of its connection to the outer via and the outer vias themselves. The
+ * steps are counted in float, so the nanometer engine has the same layers, while the turns and the
+ * positions on the spiral are taken from the parameters of the run.
+ * Returns 1 when the plan could not be allocated.
+ *
+ * Parameters:
+ *  -   gen:        Parameters of the run, the plan is added to it
+ *  -   start:      Start position of the spiral
+ *  -   end:        End position of the spiral
+ *  -   step:       Step size of the spiral
+ *  -   spacing:    Spacing between each curl (including the width)
+ *  -   viaAngle:   Angle between the via positions of the layers
+ *  -   outViaAngle: Angle between the outer vias
+ *  -   split:      Long layers are split into chunks of UNIT_SIZE steps (1) or not (0)
+ */
+static int layerPlan(Generator *gen, float start, float end, float step, float spacing, float viaAngle, float outViaAngle, int split) {
+    int layers = gen->layers;
+    int outerVias = layers > 2 ? (int)ceilf((float)(layers-0.5)/2) - 1 : 0;
+
+    gen->plan = malloc(layers * sizeof(Layer));
+    gen->outer = malloc((outerVias > 0 ? outerVias : 1) * sizeof(OuterVia));
+    gen->outerVias = outerVias;
+    gen->unitsPerCoil = 0;
+    if (gen->plan == NULL || gen->outer == NULL) {
+        return 1;
+    }
+
+    for (int i = 0; i < layers; i++) {
+        Layer *layer = &gen->plan[i];
+
+        // Adjust the layer numbering for specific end locations required per layer
+        int layerCode = floor( i/2 );
+        double viaAdd = pow(-1, i)*(layerCode)*viaAngle*(spacing)/(2*M_PI);
+
+        // Move the end of the layers in between to their outer via (only the connection uses the exact move)
+        double linkAdd = powf(-1,floorf( ((float)i-0.5)/2 )) * (powf(-1,i) * ceilf( ((float)i) / 2 )/2)*outViaAngle*spacing/(2*M_PI);
+        int between = i != 0 && i != layers-1;
+        float outViaAdd = between ? linkAdd : 0;
+
+        layer->segments = (int)(((end+viaAdd + outViaAdd)-start)/step)+(between ? -1 : 0);
+        layer->chunks = split && layer->segments > UNIT_SIZE ? (layer->segments + UNIT_SIZE - 1) / UNIT_SIZE : 1;
+        layer->sign = (i % 2) ? -1 : 1;
+        layer->viaTurn = generatorValue(gen, layerCode*gen->viaAngle);
+        layer->last = gen->start + (double)layer->segments*gen->step;
+        layer->link = gen->start + (double)((int)(((end+viaAdd + linkAdd)-start)/step + 1)-2)*gen->step;
+        layer->innerVia = (i+1) % 2;
+        gen->unitsPerCoil += layer->chunks;
+    }
+
+    // The outer vias connect the layers 1 and 2, 3 and 4... alternating on both sides of the coil
+    for (int i = 0; i < outerVias; i++) {
+        OuterVia *via = &gen->outer[i];
+        float outViaMult;
+
+        if (outerVias % 2) {
+            // ODD number of outer vias, the first one on the axis
+
+            // # 0 0 1 1 2 2 #
+
+            // 0 1 2 3 4 5 6 7
+            outViaMult = ceilf((float)i/2);
+            via->turn = -pow(-1, i);
+            via->single = 0;
+        } else {
+            // EVEN number of outer vias
+
+            // # 0 0 1 #
+
+            // 0 1 2 3 4
+            outViaMult = floorf((float)i/2) + 0.5;
+            via->turn = 1;
+            via->single = 1;
+        }
+        via->angle = outViaMult * outViaAngle;
+        via->side = pow(-1, i);
+        via->layers[0] = i * 2 + 1;
+        via->layers[1] = i * 2 + 2;
+    }
+
+    return 0;
+}
+/* --- End of FUNCTIONS --- */
+
+/* --- GENERATE --- */
+
+/* coilDefaults
+ * Fills the parameters with the defaults of coil.c. When run without any user defined
+ * parameters, it will create a basic coil. This will allow for debuging and easy learning
+ * curve for beginner users.
+ *
+ * Parameters:
+ *  -   params:     Parameters to fill
+ */
+void coilDefaults(CoilParams *params) {
+    params->mode = 0;               // Default (0) is circular
+    params->sides = 4;              // Default (4) sides, rectangular coils of mode 1
+    params->chamfer = 0.00;         // Default (0) sharp corners, length cut off each side of a corner
+    params->fillet = 0.00;          // Default (0) sharp corners, radius of the rounded corners
+    params->count = 1;              // Default (1) is single coil
+    params->turns = 10;             // Default (10) rotations
+    params->innerRadius = 0.00;     // Default (0) inner radius
+    params->spacing = 0.25;         // Default (0.25) spacing
+    params->startX = 0.00;          // Default X: (0.00)
+    params->startY = 0.00;          // Default Y: (0.00)
+    params->layers = 1;             // Default (1) Layer (F.Cu)
+    params->direction = 1;          // Default (1) (CounterClockWise - CCW), (-1) would mean CW
+    params->rotate = 0.00;          // Default (0) radians, rotates counterclockwise (units of radians, not degrees!)
+    params->width = 0.25;           // Default (0.25) width
+    params->netID = 0;              // Default (net 0 "")
+    params->viaSize = 0.8;          // Default via size (0.8)
+    params->resolution = 0.01;      // Default (0.01) resolution, lower is better, but slower
+    params->tolerance = 0.00;       // Default (0) uniform steps, greater than 0 adapts the step size to the curvature
+    params->arcTolerance = 0.00;    // Default (0) wire segments, greater than 0 writes arcs (KiCAD 6 or newer)
+    params->precision = 6;          // Default (6) digits, same as %f
+    params->trimZeros = 0;          // Default (0) keeps the zeros, (1) removes them for smaller files
+    params->nanometers = 0;         // Default (0) calculates in float, (1) snaps to whole nanometers
+    params->outline = 0;            // Default (0) writes the tracks, (1) one copper polygon per layer (coilOutlineWrite)
+    params->threads = 1;            // Default (1) generates serially
+    params->tag = "coil";           // Default ("coil")
+    params->layout = 0;             // Default (0) circle (motor), (1) linear, (2) grid
+    params->columns = 0;            // Default (0) square grid, columns of the grid
+    params->pitchX = 0.00;          // Default (0) coils next to each other, distance between the columns
+    params->pitchY = 0.00;          // Default (0) coils next to each other, distance between the rows
+    params->alternate = 0;          // Default (0) same direction, (1) every other coil turns the other way
+}
+
+/* coilGenerate
+ * Generates the coils with the given parameters into the sink.
+ * Returns 0 when everything is generated, 1 when the work units could not be allocated
+ * and 2 when the sink stopped the generation.
+ *
+ * Parameters:
+ *  -   params:     Parameters of the coils
+ *  -   sink:       Receiver of the items
+ *  -   buffers:    Work units, reused between generations (NULL allocates them for this generation)
+ *  -   stats:      Returned counters of the generation (NULL if not needed, else freed by coilStatsFree)
+ */
+int coilGenerate(const CoilParams *params, const CoilSink *sink, CoilBuffers *buffers, CoilStats *stats) {
+
+    // Parameters in the precision of the calculations
+    int count = params->count, layers = params->layers, direction = params->direction, threads = params->threads;
+    float turns = params->turns, innerRadius = params->innerRadius, width = params->width, viaSize = params->viaSize;
+    float spacing = params->spacing + width;    // Spacing between each curl (including the width)
+    float startX = params->startX, startY = params->startY, rotate = params->rotate;
+    float resolution = params->resolution, tolerance = params->tolerance, arcTolerance = params->arcTolerance;
+    int layout = params->layout, columns = params->columns, alternate = params->alternate;
+    float pitchX = params->pitchX, pitchY = params->pitchY;
+    int sides = params->mode == 1 ? params->sides : 0;     // Polygon coils (0 for the circular spiral)
+    sides != 0 && sides < 3 ? sides = 3 : sides;
+
+    // Failsafe for the callers of the library
+    count < 1 ? count = 1 : count;
+    layers < 1 ? layers = 1 : layers;
+    threads < 1 ? threads = 1 : threads;
+
+    // Work units and counters of this generation only
+    CoilBuffers localBuffers = {NULL, 0};
+    CoilStats localStats;
+    buffers == NULL ? buffers = &localBuffers : buffers;
+    stats == NULL ? stats = &localStats : stats;
+
+    /* --- VARIABLES --- */
+    /* Below are the secondary coil parameters used to create a motor
+     * out of multiple coils. These parameters before are defined as an 
+     * extension to the parameters above. If the user enters greater than 1
+     * for the count then some of the parameters defaults into
+     * these variables.
+     */
+
+    // Motor radius
+    /* motorRadius replaces the innerRadius parameter. 
+     * Instead of changing the radius of each coil, the motorRadius variable changes 
+     * the radius of the motor created by set of coils arranged in a circle.
+     * Each individual coils will have an innerRadius of 0.
+     * The innerRadius entered is transferred to motorRadius.
+     */
+    float motorRadius = 0.00;       // Default (0) radius
+
+    // Motor rotate
+    /* motorRotate replaces the rotate parameter.
+     * Instead of changing the angle of each coil, the motorRotate variable changes
+     * the angle of the motor created by set of coils arranged in a circle.
+     * Each individual coils will have an angle of 0.
+     * The rotate entered is transferred to motorRotate.
+     */
+    float motorRotate = 0.00;       // Default (0) radians
+    /* --- End of VARIABLES --- */
+
+    /* --- Start & End Positions ---  */
+
+    // Create a variable to hold the number of Vias inside the coil.
+    int innerVias = 1;  // At least one layer means at least one via
+
+    // Calculate the number of vias needed inside the coil for the amount of copper layers
+    layers > 2 ? innerVias = ceilf((float)(layers-0.5)/2): innerVias;
+
+    // Calculate the amount of vias needed outside of the coils for the amount of copper layers
+    int outerVias = innerVias-1;
+
+    // Calculate the gap between the vias
+    float viaGap = (float)1/2; // With one via, only 1/2 ratio is needed
+
+    // More than one layers require at least 2/3 ratio
+    layers > 2 ? viaGap = (float)2/3 : viaGap;
+
+    // Set the innerRadius according to the coil count (only the motor moves it to the motor radius)
+    if (count > 1 && layout == 0) {
+        motorRadius = innerRadius;
+        innerRadius = 0.00;
+    }
+
+    // Calculate the start and end factors
+    float start = innerRadius + viaSize * innerVias * viaGap;    // Start Position
+    float end = turns * spacing + start;    // End Position
+
+    //motorRadius == 0 ? motorRadius = end : motorRadius;
+    /* --- End of Start & End Positions --- */
+
+    /* --- ANGLE --- */
+    /* Calculate the angle difference between the original spiral and the spaced one.
+     * Adjust the angle direction according to the final y position on the spaced coil.
+     * Include the user rotation into the coil angle.
+     */
+
+    // Find the start coordinates of the initial spiral
+    float xInit = end;
+    float yInit = 0;
+
+    // Find the start coordinates of the spaced spiral
+    float xSpaced = cos(2*M_PI*xInit/spacing)*xInit;
+    float ySpaced = sin(2*M_PI*xInit/spacing)*xInit;
+
+    // Create an angle variable to calculate the angle difference between a normal spiral and a spacing adjusted one
+    float angle = acosf( ( (xInit * xSpaced) + (yInit * ySpaced) ) / ( sqrt( powf(xInit,2) + powf(yInit,2) ) * sqrt( powf(xSpaced,2) + powf(ySpaced,2) ) ) );
+
+    // Adjust the angle orientation according to spacing adjusted y-coordinate
+    ySpaced < 0 ? angle *= -1 : angle;
+
+    // Adjust the angle according to user's rotation preference
+    //angle += rotate;    // In radians
+    /* --- End of ANGLE --- */
+
+
+    /* --- GENERATE COIL --- */
+    /* Generate the coils with the given parameters per each layer.
+     * Every two layers is rotated with an angle (viaAngle) associated with the 
+     * number of layers. This ensures for better placement of vias and better wiring.
+     * Each layer of each coil (and each chunk of a long layer) is a work unit, generated
+     * and formatted into its own buffer by the threads and handed to the sink in order, so
+     * the sink does not depend on the number of threads. Only a window of units is kept in
+     * memory, hence the memory used does not depend on the turns, layers, count or resolution.
+     * The via positions are calculated afterwards from the anchor points of each layer.
+     */
+
+    // Step size of the coil generator
+    float step = ( (float)resolution / (start) / turns * 2 );
+
+    // Calculate the angle between the via positions for different layer combinations
+    float viaAngle = ( 2*M_PI ) / ( innerVias );
+
+    // Dummy variables for the vias
+    double xNext, yNext;
+
+    // Transform of the current layer
+    double transform[6];
+
+    // Number of items generated, their largest deviation from the spiral and the time spent
+    stats->segments = 0;
+    stats->arcs = 0;
+    stats->vias = 0;
+    stats->deviation = 0;
+    stats->timeGenerate = 0;
+    stats->timeVias = 0;
+    stats->cached = 0;
+
+    // Points, wire segments and arcs of each copper layer (all coils) for the run report
+    stats->layerPoints = calloc(layers, sizeof(long));
+    stats->layerSegments = calloc(layers, sizeof(long));
+    stats->layerArcs = calloc(layers, sizeof(long));
+
+    // Tracks of each coil and layer, vias and via connections of each coil (members of the group)
+    stats->tracks = calloc(count * layers, sizeof(long));
+    stats->coilVias = calloc(count, sizeof(int));
+    stats->coilLinks = calloc(count, sizeof(int));
+    int coilVias, coilLinks;
+
+    // Time spent generating the layers and laying out the vias (without the sink)
+    double timeMark;
+    int error = stats->layerPoints == NULL || stats->layerSegments == NULL || stats->layerArcs == NULL || stats->tracks == NULL || stats->coilVias == NULL || stats->coilLinks == NULL;
+
+    // Distance of the outermost point from the center (the corners of the polygon coils)
+    float extent = sides > 0 ? end/cos(M_PI/sides) : end;
+
+    // Calculate the necessary values to position the outer vias
+    float outViaRad = ( extent + viaSize + (float)1/3 );                   // Find the radius at which outer vias are positioned
+    float outViaAngle = ( ( 2 * viaSize + viaGap ) / ( outViaRad ) );   // Calculate the angle needed between each outer via
+
+    // Rotation of the vias of the current coil
+    float viaRotate = 0;
+
+    // Anchor points of the coil used to position the vias
+    double anchorX, anchorY;
+
+    // Calculate the offset angle for each coil in the motor
+    float motorAngle = 2*M_PI/count;
+
+    // Calculate the new motorRadius accounting the spacing between coils 
+    count > 1 && layout == 0 ? motorRadius += extent/cos( ( M_PI - (motorAngle) )/2 ) + spacing : motorRadius;
+
+    count > 1 && layout == 0 ? motorRotate = rotate : motorRotate;
+
+    // Linear and grid layouts start from the entered coordinates with the coils next to each other
+    float originX = startX, originY = startY;
+    float coilPitch = 2*(layers > 2 ? outViaRad + viaSize/2 : extent + viaSize/2) + spacing;
+    pitchX == 0 ? pitchX = coilPitch : pitchX;
+    pitchY == 0 ? pitchY = coilPitch : pitchY;
+    layout == 1 ? columns = count : columns;
+    columns == 0 ? columns = ceil(sqrt(count)) : columns;
+
+    float outerRadius = 0;
+
+    // Parameters shared by all work units
+    Generator gen;
+    gen.start = start;
+    gen.step = step;
+    gen.spacing = spacing;
+    gen.angle = angle;
+    gen.viaAngle = viaAngle;
+    gen.width = width;
+    gen.tolerance = tolerance;
+    gen.arcTolerance = arcTolerance;
+    gen.sides = sides;
+    gen.cornerAngle = angle + (sides > 0 ? M_PI/sides : 0);    // Sides of the layers parallel to the axes
+    gen.chamfer = params->chamfer < 0 ? 0 : params->chamfer;
+    gen.fillet = params->fillet < 0 ? 0 : params->fillet;
+    gen.layers = layers;
+    gen.nanometers = params->nanometers;
+    gen.params = params;
+    gen.sink = sink;
+    gen.plan = NULL;
+    gen.outer = NULL;
+    gen.coilX = malloc(count * sizeof(double));
+    gen.coilY = malloc(count * sizeof(double));
+    gen.coilRotate = malloc(count * sizeof(double));
+    gen.coilDirection = malloc(count * sizeof(int));
+    gen.templates = NULL;
+    gen.unitsPerCoil = 0;
+    gen.coilX == NULL || gen.coilY == NULL || gen.coilRotate == NULL || gen.coilDirection == NULL ? error = 1 : 0;
+
+    // Center, rotation and direction of each coil (instance)
+    for (int k = 0; k < count && !error; k++) {
+
+        if (layout == 0) {
+            // Adjust the starting coordinates for each Coil
+            startX = cos(motorRotate) * motorRadius*cos(motorAngle * (k+1)) + sin(motorRotate)*motorRadius*sin(motorAngle * (k+1));
+            startY = -sin(motorRotate) * motorRadius*cos(motorAngle * (k+1)) + cos(motorRotate) * motorRadius*sin(motorAngle * (k+1));
+
+            startY > 0 ? rotate = -rotate : rotate;
+        } else {
+            // Place the coils in rows of the given columns
+            startX = originX + (k % columns) * pitchX;
+            startY = originY + (k / columns) * pitchY;
+        }
+
+        gen.coilX[k] = startX;
+        gen.coilY[k] = startY;
+        gen.coilRotate[k] = rotate;
+
+        // Every other coil (a checkerboard on a grid) turns the other way
+        int flip = alternate && (layout == 2 && columns % 2 == 0 ? (k % columns + k / columns) % 2 : k % 2);
+        gen.coilDirection[k] = flip ? -direction : direction;
+    }
+
+    // The nanometer engine places the same coils in double precision
+    if (gen.nanometers && !error) generatorExact(params, count, layout, columns, &gen);
+
+    // Layout of the layers and the outer vias, long layers are split into chunks unless the steps are adaptive or arcs
+    !error && layerPlan(&gen, start, end, step, spacing, viaAngle, outViaAngle, !(tolerance > 0 || arcTolerance > 0 || sides > 0 || gen.nanometers)) ? error = 1 : 0;
+
+    // Rotations by multiples of the angle step, shared by all blocks of all layers
+    for (int m = 0; m < BLOCK_SIZE; m++) {
+        gen.rotation[0][m] = cos(2*M_PI*m*gen.step/gen.spacing);
+        gen.rotation[1][m] = sin(2*M_PI*m*gen.step/gen.spacing);
+    }
+
+    // Calculate the adaptive wire segments, the arcs or the polygon sides of each layer once for all the coils.
+    // Uniform steps have no template: coilBlock only rotates each point once more than moving a stored
+    // point would, and writing the items takes about 90% of a coil, so a template would gain little
+    // while keeping every point of the layer in memory and taking the chunks of a layer off the threads.
+    if ((tolerance > 0 || arcTolerance > 0 || sides > 0) && !error) {
+        timeMark = coilNow();
+        gen.templates = calloc(layers, sizeof(Template));
+        for (int i = 0; i < layers; i++) {
+            gen.templates == NULL || templateBuild(&gen, i, &gen.templates[i]) ? error = 1 : 0;
+        }
+        stats->timeGenerate += coilNow() - timeMark;
+    }
+
+    // Work units generated ahead of the sink, a few per thread
+    Pool pool;
+    pool.gen = &gen;
+    pool.window = threads > 1 ? 4*threads : 1;
+    pool.total = count * gen.unitsPerCoil;
+    pool.next = 0;
+    pool.written = 0;
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.changed, NULL);
+
+    // Allocate the work units the previous generations did not need (kept between generations)
+    if (buffers->window < pool.window) {
+        Unit *units = realloc(buffers->units, pool.window * sizeof(Unit));
+        for (int u = buffers->window; units != NULL && u < pool.window; u++) {
+            memset(&units[u], 0, sizeof(Unit));
+        }
+        units == NULL ? error = 1 : (buffers->units = units, buffers->window = pool.window);
+    }
+    pool.units = buffers->units;
+
+    // Clear the work units for this generation, only a formatter needs their text buffers
+    for (int u = 0; u < pool.window && !error; u++) {
+        Unit *unit = &pool.units[u];
+        if (sink->format != NULL && unit->writer.buffer == NULL) {
+            unit->writer.buffer = malloc(WRITER_SIZE);
+            unit->writer.size = WRITER_SIZE;
+            unit->writer.buffer == NULL ? error = 1 : 0;
+        }
+        unit->writer.length = 0;
+        unit->writer.digits = params->precision;
+        unit->writer.trim = params->trimZeros;
+        unit->writer.error = 0;
+        unit->done = 0;
+    }
+
+    // Vias and via connections of the current coil
+    Unit vias;
+    memset(&vias, 0, sizeof(Unit));
+    vias.layer = -1;
+    vias.writer.digits = params->precision;
+    vias.writer.trim = params->trimZeros;
+    if (sink->format != NULL) {
+        vias.writer.buffer = malloc(16*WRITER_RECORD);
+        vias.writer.size = 16*WRITER_RECORD;
+        vias.writer.buffer == NULL ? error = 1 : 0;
+    }
+    error |= unitReserve(&vias, layers + 3*outerVias + 1);
+
+    // Start the threads, this thread only hands the units to the sink in order
+    pthread_t *workers = malloc(threads * sizeof(pthread_t));
+    int started = 0;
+    workers == NULL ? error = 1 : 0;
+    for (int t = 0; t < threads && threads > 1 && !error; t++) {
+        pthread_create(&workers[t], NULL, poolWorker, &pool) ? error = 1 : started++;
+    }
+
+    int unitIndex = 0;
+    CoilUnit view;
+
+    // Repeat for each coil
+    for (int k = 0; k < count && !error; k++) {
+
+        startX = gen.coilX[k];
+        startY = gen.coilY[k];
+
+        // Center of the coil in the precision of the layers
+        double centerX = gen.coilX[k], centerY = gen.coilY[k];
+
+        // Iterate through each copper layer
+        for (int i = 0; i < layers && !error; i++) {
+
+            // Hand the work units of the layer to the sink in order
+            for (int c = 0; c < gen.plan[i].chunks && !error; c++, unitIndex++) {
+                Unit *unit = &pool.units[unitIndex % pool.window];
+
+                // Wait for the threads or generate the unit here
+                timeMark = coilNow();
+                if (threads > 1) {
+                    pthread_mutex_lock(&pool.lock);
+                    while (!unit->done) {
+                        pthread_cond_wait(&pool.changed, &pool.lock);
+                    }
+                    pthread_mutex_unlock(&pool.lock);
+                } else {
+                    unitSetup(&gen, unitIndex, unit);
+                    generateUnit(&gen, unit);
+                }
+                stats->timeGenerate += coilNow() - timeMark;
+
+                stats->segments += unit->segments;
+                stats->arcs += unit->arcs;
+                stats->layerSegments[i] += unit->segments;
+                stats->layerArcs[i] += unit->arcs;
+                stats->tracks[k*layers + i] += unit->segments + unit->arcs;
+                stats->layerPoints[i] += unit->points;
+                unit->deviation > stats->deviation ? stats->deviation = unit->deviation : stats->deviation;
+
+                // Hand the unit to the sink
+                unit->error || unit->writer.error ? error = 1 : 0;
+                unitView(&gen, unit, &view);
+                !error && sink->write(sink->context, &view) ? error = 2 : 0;
+
+                // Free the place of the unit in the window
+                pthread_mutex_lock(&pool.lock);
+                unit->done = 0;
+                pool.written++;
+                pthread_cond_broadcast(&pool.changed);
+                pthread_mutex_unlock(&pool.lock);
+            }
+        }
+
+        if (error) {
+            break;
+        }
+
+        // Start timing the vias
+        timeMark = coilNow();
+
+        // uuid indices of the vias and their connections
+        coilVias = 0;
+        coilLinks = 0;
+        vias.coil = k;
+        vias.count = 0;
+
+        // Calculate the rotation of the vias for each Coil
+        float endX = motorRadius*cos(motorAngle * (count));
+        float endY = motorRadius*sin(motorAngle * (count));
+
+        // A single coil sits in the center of the motor, so its vias are not turned (avoids 0/0)
+        if (motorRadius == 0) {
+            viaRotate = 0;
+        } else {
+            viaRotate = acos(round( (startX * endX + startY * endY) / ( sqrt( pow(startX,2) + pow(startY,2) ) * sqrt( pow(endX,2) + pow(endY,2) ) )*1000 )/1000);
+        }
+
+        startY > 0 ? viaRotate = -viaRotate : viaRotate;
+
+        // Find the first point of the coil
+        layerTransform(&gen, k, 0, transform);
+        spiralPoint(&gen, gen.start, transform, &anchorX, &anchorY);
+
+        // Create a unit vector pointing to the via locations
+        double unitVector[2] = {(anchorX- centerX)/(sqrt(pow(anchorX- centerX,2) + pow(anchorY- centerY,2))), (anchorY- centerY)/(sqrt(pow(anchorX- centerX,2) + pow(anchorY- centerY,2)))};
+
+        // Create vias at specific locations while biasing the location towards the center of the coil
+        if (layers == 1) { 
+            // Add a via adjusted using the unit vector
+            xNext = anchorX + ( unitVector[0] * (-viaSize/2 + width/2) );
+            yNext = anchorY + ( unitVector[1] * (-viaSize/2 + width/2) );
+            unitItem(&vias, COIL_VIA, 0, coilVias++, xNext, yNext, xNext, yNext, viaSize);
+            stats->vias++;
+
+        } else {
+            for (int i = 0; i < layers; i++) {
+                // Add vias
+                if (gen.plan[i].innerVia) {
+                    // Find the first point of the layer
+                    layerTransform(&gen, k, i, transform);
+                    spiralPoint(&gen, gen.start, transform, &anchorX, &anchorY);
+
+                    // Adjust the unit vector for the new via position
+                    unitVector[0] = (anchorX- centerX)/(sqrt(pow(anchorX- centerX,2) + pow(anchorY- centerY,2)));
+                    unitVector[1] = (anchorY- centerY)/(sqrt(pow(anchorX- centerX,2) + pow(anchorY- centerY,2)));
+
+                    // Adjust the via position using the new unit vector
+                    xNext = anchorX + ( unitVector[0] * (-viaSize*3/4 + width/2) );
+                    yNext = anchorY + ( unitVector[1] * (-viaSize*3/4 + width/2) );
+                    unitItem(&vias, COIL_VIA, 0, coilVias++, xNext, yNext, xNext, yNext, viaSize);
+                    stats->vias++;
+                }
+            }
+
+            // More than 2 layers requires vias outside the coil for connection
+            if (gen.outerVias > 0) {
+
+                // Dummy variables for outer via positions (kept in double precision like the points of the layers)
+                double outViaXPos, outViaYPos;
+
+                for (int i = 0; i < gen.outerVias; i++) {
+                    const OuterVia *via = &gen.outer[i];
+                    double turned = via->single ? (float)(via->angle + via->turn * viaRotate) : via->angle + via->turn * viaRotate;
+
+                    outViaXPos = cos(turned) * outViaRad + centerX;
+                    outViaYPos = via->side * sin(turned) * outViaRad + centerY;
+
+                    unitItem(&vias, COIL_VIA, 0, coilVias++, outViaXPos, outViaYPos, outViaXPos, outViaYPos, viaSize);
+                    stats->vias++;
+
+                    // Connect the ends of the two layers to the outer via
+                    for (int j = 0; j < 2; j++) {
+                        int layer = via->layers[j];
+                        layerTransform(&gen, k, layer, transform);
+                        spiralPoint(&gen, gen.plan[layer].link, transform, &xNext, &yNext);
+                        unitItem(&vias, COIL_LINK, layer, coilLinks++, xNext, yNext, outViaXPos, outViaYPos, width);
+                    }
+                }
+
+                outerRadius = sqrt(pow(outViaXPos,2)+pow(outViaYPos,2))+viaSize/2;
+            }
+        }
+
+        // Snap the vias and via connections to whole nanometers (only via connections are removed)
+        gen.nanometers ? coilLinks -= unitSnap(&vias) : 0;
+
+        stats->coilVias[k] = coilVias;
+        stats->coilLinks[k] = coilLinks;
+
+        // Format the vias and finish timing them
+        unitFormat(&gen, &vias);
+        stats->timeVias += coilNow() - timeMark;
+
+        // Hand the vias to the sink
+        vias.writer.error ? error = 1 : 0;
+        unitView(&gen, &vias, &view);
+        !error && sink->write(sink->context, &view) ? error = 2 : 0;
+    }
+
+    // Stop the threads (also when the sink stopped the generation)
+    pthread_mutex_lock(&pool.lock);
+    pool.next = pool.total;
+    pthread_cond_broadcast(&pool.changed);
+    pthread_mutex_unlock(&pool.lock);
+    for (int t = 0; t < started; t++) {
+        pthread_join(workers[t], NULL);
+    }
+
+    (int)outerRadius == 0 ? outerRadius = extent : outerRadius;
+    stats->outerRadius = outerRadius;
+    stats->motorRadius = motorRadius;
+    /* --- End of GENERATE COIL --- */
+
+    free(workers);
+    free(vias.items);
+    free(vias.writer.buffer);
+    pthread_mutex_destroy(&pool.lock);
+    pthread_cond_destroy(&pool.changed);
+    free(gen.plan);
+    free(gen.outer);
+    free(gen.coilX);
+    free(gen.coilY);
+    free(gen.coilRotate);
+    free(gen.coilDirection);
+    for (int i = 0; i < layers && gen.templates != NULL; i++) {
+        free(gen.templates[i].points);
+        free(gen.templates[i].isArc);
+    }
+    free(gen.templates);
+
+    // Free the work units and counters only needed for this generation
+    if (buffers == &localBuffers) coilBuffersFree(&localBuffers);
+    if (stats == &localStats) coilStatsFree(&localStats);
+
+    return error;
+}
+
+/* coilStatsFree
+ * Frees the counters of a generation.
+ *
+ * Parameters:
+ *  -   stats:      Counters to free (coilGenerate)
+ */
+void coilStatsFree(CoilStats *stats) {
+    free(stats->layerPoints);
+    free(stats->layerSegments);
+    free(stats->layerArcs);
+    free(stats->tracks);
+    free(stats->coilVias);
+    free(stats->coilLinks);
+}
+
+/* coilBuffersFree
+ * Frees the work units kept between generations.
+ *
+ * Parameters:
+ *  -   buffers:    Work units to free
+ */
+void coilBuffersFree(CoilBuffers *buffers) {
+    Unit *units = buffers->units;
+    for (int u = 0; u < buffers->window; u++) {
+        free(units[u].items);
+        free(units[u].writer.buffer);
+    }
+    free(units);
+    buffers->units = NULL;
+    buffers->window = 0;
+}
+/* --- End of GENERATE --- */
+
+/* --- SINKS --- */
+
+/* coilListWrite
+ * Sink collecting the items of every unit into a list (CoilList as the context of the sink),
+ * for callers that want the whole coil in memory.
+ * Returns 1 when the list could not grow.
+ *
+ * Parameters:
+ *  -   context:    List to add the items to
+ *  -   unit:       Items of the unit
+ */
+int coilListWrite(void *context, const CoilUnit *unit) {
+    CoilList *list = context;
+
+    if (list->count + unit->count > list->capacity) {
+        size_t capacity = list->capacity ? 2*list->capacity : 1024;
+        while (capacity < list->count + unit->count) {
+            capacity *= 2;
+        }
+        CoilItem *items = realloc(list->items, capacity * sizeof(CoilItem));
+        if (items == NULL) {
+            return 1;
+        }
+        list->items = items;
+        list->capacity = capacity;
+    }
+
+    memcpy(list->items + list->count, unit->items, unit->count * sizeof(CoilItem));
+    list->count += unit->count;
+
+    return 0;
+}
+
+/* copperLayer
+ * Writes the KiCAD name of a copper layer: F.Cu for the first, B.Cu for the last and the inner
+ * layers in between. Returns the name.
+ *
+ * Parameters:
+ *  -   name:       Returned name (16 characters)
+ *  -   layer:      Index of the copper layer
+ *  -   layers:     Number of copper layers
+ */
+static char *copperLayer(char *name, int layer, int layers) {
+    if (layer == 0) {
+        strcpy(name, "F.Cu");
+    } else if (layer == layers-1) {
+        strcpy(name, "B.Cu");
+    } else {
+        sprintf(name, "In%d.Cu", layer);
+    }
+    return name;
+}
+
+/* coilKicadFormat
+ * Sink formatter writing the items as KiCAD footprint records, ready to be pasted below the
+ * '(net 0 "")' line of a kicad_pcb file. The uuids start with the hash of the tag (coilUuid).
+ *
+ * Parameters:
+ *  -   context:    Context of the sink (not used)
+ *  -   params:     Parameters of the coils (layers, netID and tag)
+ *  -   unit:       Items of the unit
+ *  -   out:        In-memory writer of the records
+ */
+void coilKicadFormat(void *context, const CoilParams *params, const CoilUnit *unit, CoilWriter *out) {
+    unsigned long long tag = coilTagHash(params->tag);
+    char layerName[16], uuid[40];
+    (void)context;
+
+    // Name of the copper layer of the tracks
+    copperLayer(layerName, unit->layer, params->layers);
+
+    for (int n = 0; n < unit->count; n++) {
+        const CoilItem *item = &unit->items[n];
+
+        // Print out the items according to KiCAD Footprint File.
+        if (item->kind == COIL_SEGMENT) {
+            coilWriterPrintf(out, "(segment (start %f %f) (end %f %f) (width %f) (layer \"%s\") (net %d) (uuid %s))\n", item->start[0], item->start[1], item->end[0], item->end[1], item->width, layerName, params->netID, coilUuid(uuid, tag, item->coil, item->layer, 0, item->index));
+        } else if (item->kind == COIL_ARC) {
+            coilWriterPrintf(out, "(arc (start %f %f) (mid %f %f) (end %f %f) (width %f) (layer \"%s\") (net %d) (uuid %s))\n", item->start[0], item->start[1], item->mid[0], item->mid[1], item->end[0], item->end[1], item->width, layerName, params->netID, coilUuid(uuid, tag, item->coil, item->layer, 0, item->index));
+        } else if (item->kind == COIL_VIA) {
+            coilWriterPrintf(out, "(via (at %f %f) (size %.1f) (drill 0.4) (layers \"F.Cu\" \"B.Cu\") (free) (net %d) (tstamp %s))\n", item->start[0], item->start[1], item->width, params->netID, coilUuid(uuid, tag, item->coil, 0, 1, item->index));
+        } else {
+            coilWriterPrintf(out, "(segment (start %f %f) (end %f %f) (width %f) (layer \"In%d.Cu\") (net %d) (tstamp %s))\n", item->start[0], item->start[1], item->end[0], item->end[1], item->width, item->layer, params->netID, coilUuid(uuid, tag, item->coil, 0, 2, item->index));
+        }
+    }
+}
+
+/* coilFanoutFormat
+ * Formatter of the fan-out sink, calls the formatter of the sink of the caller.
+ */
+void coilFanoutFormat(void *context, const CoilParams *params, const CoilUnit *unit, CoilWriter *out) {
+    CoilFanout *fanout = context;
+    fanout->sink->format(fanout->sink->context, params, unit, out);
+}
+
+/* coilFanoutWrite
+ * Sink handing the items of every unit to several formats in a single generation: each output
+ * formats the unit into its own writer (in the order of the file), then the unit is handed on to
+ * the sink of the caller. Returns 1 when an output could not be written, otherwise the result of
+ * the sink of the caller.
+ *
+ * Parameters:
+ *  -   context:    Fan-out of the outputs (CoilFanout)
+ *  -   unit:       Items of the unit
+ */
+int coilFanoutWrite(void *context, const CoilUnit *unit) {
+    CoilFanout *fanout = context;
+    int error = 0;
+
+    for (int n = 0; n < fanout->count; n++) {
+        CoilOutput *output = &fanout->outputs[n];
+        output->format(output->context, fanout->params, unit, output->writer);
+        output->writer->error ? error = 1 : 0;
+    }
+
+    return error ? 1 : (fanout->sink != NULL ? fanout->sink->write(fanout->sink->context, unit) : 0);
+}
+/* --- End of SINKS --- */
+
+/* --- CACHE --- */
+
+/* cachePlacement
+ * Splits the parameters into the geometry kept in the cache and the placement applied to it.
+ * Moving the coils of the linear and grid layouts (startX, startY) and rotating a single coil of one
+ * or two layers move every item the same way, so they are taken out of the parameters and returned
+ * as a transform instead. Any other rotation changes the coils themselves (the outer vias stay in
+ * place and the coils of a motor turn every other way), so it stays part of the geometry.
+ * Returns 1 when the transform moves the items, 0 when it keeps them in place.
+ *
+ * Parameters:
+ *  -   params:     Parameters of the coils
+ *  -   base:       Returned parameters of the geometry kept in the cache
+ *  -   transform:  Returned matrix {xx, xy, yx, yy} followed by the offset {x, y} (coilTransform)
+ */
+static int cachePlacement(const CoilParams *params, CoilParams *base, double transform[6]) {
+    *base = *params;
+
+    transform[0] = 1;
+    transform[1] = 0;
+    transform[2] = 0;
+    transform[3] = 1;
+
+    // Moved coordinates are no longer whole nanometers, so the nanometer engine keeps the placement in the geometry
+    if (params->nanometers) {
+        transform[4] = 0;
+        transform[5] = 0;
+        return 0;
+    }
+
+    base->startX = 0.00;
+    base->startY = 0.00;
+
+    // The circle layout does not use the start coordinates
+    transform[4] = params->layout != 0 ? (float)params->startX : 0;
+    transform[5] = params->layout != 0 ? (float)params->startY : 0;
+
+    // A single coil without outer vias turns around its center (the other way when clockwise)
+    if (params->count <= 1 && params->layers <= 2 && params->rotate != 0) {
+        float rotate = params->rotate;
+        int direction = params->direction < 0 ? -1 : 1;
+        base->rotate = 0.00;
+        transform[0] = cos(rotate);
+        transform[1] = direction * sin(rotate);
+        transform[2] = -direction * sin(rotate);
+        transform[3] = cos(rotate);
+    }
+
+    return transform[0] != 1 || transform[1] != 0 || transform[4] != 0 || transform[5] != 0;
+}
+
+/* keyHash
+ * Adds numbers to a hash (FNV-1a).
+ *
+ * Parameters:
+ *  -   hash:       Hash to continue
+ *  -   fields:     Numbers to add
+ *  -   count:      Number of numbers
+ */
+static unsigned long long keyHash(unsigned long long hash, const double *fields, size_t count) {
+    for (size_t f = 0; f < count; f++) {
+        double value = fields[f] + 0.0;     // Same key for -0 and 0
+        const unsigned char *bytes = (const unsigned char *)&value;
+        for (size_t b = 0; b < sizeof(value); b++) {
+            hash ^= bytes[b];
+            hash *= 1099511628211ULL;
+        }
+    }
+    return hash;
+}
+
+/* coilCacheKey
+ * Hashes the parameters of the geometry kept in the cache (FNV-1a): everything changing the items
+ * besides their placement (cachePlacement). The parameters are taken in the precision of the
+ * calculations and the ones without an effect on the items (threads, netID, tag and the digits of
+ * the text) are left out, so the same coils always get the same key.
+ *
+ * Parameters:
+ *  -   params:     Parameters of the coils
+ */
+unsigned long long coilCacheKey(const CoilParams *params) {
+    CoilParams base;
+    double transform[6];
+    cachePlacement(params, &base, transform);
+
+    // The layout only matters for more than one coil, the columns and rows only for a grid
+    int count = base.count < 1 ? 1 : base.count;
+    int layout = count > 1 ? base.layout : 0;
+    int sides = base.mode == 1 ? (base.sides < 3 ? 3 : base.sides) : 0;
+    double fields[] = {base.mode, sides, sides ? (float)fmax(base.chamfer, 0) : 0, sides ? (float)fmax(base.fillet, 0) : 0, count, (float)base.turns, (float)base.innerRadius, (float)base.spacing,
+                       base.layers < 1 ? 1 : base.layers, base.direction, (float)base.rotate, (float)base.width,
+                       (float)base.viaSize, (float)base.resolution, (float)base.tolerance, (float)base.arcTolerance,
+                       layout, layout == 2 ? base.columns : 0, layout != 0 ? (float)base.pitchX : 0,
+                       layout == 2 ? (float)base.pitchY : 0, count > 1 ? base.alternate : 0};
+
+    unsigned long long hash = keyHash(coilTagHash(CACHE_MAGIC), fields, sizeof(fields)/sizeof(fields[0]));
+
+    // The nanometer engine calculates with the parameters in double precision and keeps the placement
+    if (base.nanometers) {
+        double exact[] = {base.nanometers, base.turns, base.innerRadius, base.spacing, base.rotate, base.width, base.viaSize,
+                          base.resolution, base.pitchX, base.pitchY, base.startX, base.startY};
+        hash = keyHash(hash, exact, sizeof(exact)/sizeof(exact[0]));
+    }
+    return hash;
+}
+
+/* cacheOpen
+ * Maps the cache entry of a key into memory and checks that it is complete.
+ * Returns 0 when the entry can be used and 1 when there is none (a miss).
+ *
+ * Parameters:
+ *  -   dir:        Cache directory
+ *  -   key:        Key of the geometry (coilCacheKey)
+ *  -   entry:      Returned entry, unmapped by the caller (munmap)
+ */
+static int cacheOpen(const char *dir, unsigned long long key, CacheEntry *entry) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%016llx.coil", dir, key);
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return 1;
+    }
+
+    struct stat info;
+    void *data = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && (size_t)info.st_size >= sizeof(CacheHeader)) {
+        data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (data == MAP_FAILED) {
+        return 1;
+    }
+
+    // Entries of another version or key are not used
+    const CacheHeader *header = data;
+    if (memcmp(header->magic, CACHE_MAGIC, 8) || header->key != key || header->count < 1 || header->layers < 1 || header->items < 0) {
+        munmap(data, info.st_size);
+        return 1;
+    }
+
+    // Arrays following the header
+    entry->header = header;
+    entry->size = info.st_size;
+    entry->layerPoints = (const long *)(header + 1);
+    entry->layerSegments = entry->layerPoints + header->layers;
+    entry->layerArcs = entry->layerSegments + header->layers;
+    entry->tracks = entry->layerArcs + header->layers;
+    entry->coilVias = (const int *)(entry->tracks + (size_t)header->count * header->layers);
+    entry->coilLinks = entry->coilVias + header->count;
+    entry->items = (const CoilItem *)(entry->coilLinks + header->count);
+
+    // Incomplete entries are not used either
+    if ((const char *)(entry->items + header->items) != (const char *)data + entry->size) {
+        munmap(data, entry->size);
+        return 1;
+    }
+
+    return 0;
+}
+
+/* cacheStats
+ * Fills the counters of a generation from a cache entry.
+ * Returns 1 when the counters could not be allocated.
+ *
+ * Parameters:
+ *  -   entry:      Cache entry (cacheOpen)
+ *  -   stats:      Returned counters (freed by coilStatsFree)
+ */
+static int cacheStats(const CacheEntry *entry, CoilStats *stats) {
+    const CacheHeader *header = entry->header;
+    size_t layers = header->layers, tracks = (size_t)header->count * header->layers;
+
+    stats->segments = header->segments;
+    stats->arcs = header->arcs;
+    stats->vias = header->vias;
+    stats->deviation = header->deviation;
+    stats->outerRadius = header->outerRadius;
+    stats->motorRadius = header->motorRadius;
+    stats->timeGenerate = 0;
+    stats->timeVias = 0;
+    stats->cached = 1;
+
+    stats->layerPoints = malloc(layers * sizeof(long));
+    stats->layerSegments = malloc(layers * sizeof(long));
+    stats->layerArcs = malloc(layers * sizeof(long));
+    stats->tracks = malloc(tracks * sizeof(long));
+    stats->coilVias = malloc(header->count * sizeof(int));
+    stats->coilLinks = malloc(header->count * sizeof(int));
+    if (stats->layerPoints == NULL || stats->layerSegments == NULL || stats->layerArcs == NULL || stats->tracks == NULL || stats->coilVias == NULL || stats->coilLinks == NULL) {
+        return 1;
+    }
+
+    memcpy(stats->layerPoints, entry->layerPoints, layers * sizeof(long));
+    memcpy(stats->layerSegments, entry->layerSegments, layers * sizeof(long));
+    memcpy(stats->layerArcs, entry->layerArcs, layers * sizeof(long));
+    memcpy(stats->tracks, entry->tracks, tracks * sizeof(long));
+    memcpy(stats->coilVias, entry->coilVias, header->count * sizeof(int));
+    memcpy(stats->coilLinks, entry->coilLinks, header->count * sizeof(int));
+
+    return 0;
+}
+
+/* cacheSave
+ * Adds the geometry of a generation to the cache. The entry is written into a temporary file
+ * and renamed at the end, so other runs (or the jobs of a batch) never read a partial entry.
+ * The cache is only an optimization, an entry that cannot be written is left out.
+ *
+ * Parameters:
+ *  -   dir:        Cache directory (created when missing)
+ *  -   key:        Key of the geometry (coilCacheKey)
+ *  -   count:      Number of coils
+ *  -   layers:     Number of layers
+ *  -   stats:      Counters of the generation
+ *  -   list:       Items of the generation
+ */
+static void cacheSave(const char *dir, unsigned long long key, int count, int layers, const CoilStats *stats, const CoilList *list) {
+    char path[4096], temp[4096];
+    snprintf(path, sizeof(path), "%s/%016llx.coil", dir, key);
+    snprintf(temp, sizeof(temp), "%s/%016llx.XXXXXX", dir, key);
+
+    mkdir(dir, 0777);
+    int fd = mkstemp(temp);
+    if (fd < 0) {
+        return;
+    }
+    FILE *fp = fdopen(fd, "wb");
+    if (fp == NULL) {
+        close(fd);
+        remove(temp);
+        return;
+    }
+
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, 8);
+    header.key = key;
+    header.count = count;
+    header.layers = layers;
+    header.segments = stats->segments;
+    header.arcs = stats->arcs;
+    header.vias = stats->vias;
+    header.deviation = stats->deviation;
+    header.outerRadius = stats->outerRadius;
+    header.motorRadius = stats->motorRadius;
+    header.items = list->count;
+
+    size_t tracks = (size_t)count * layers;
+    int error = fwrite(&header, sizeof(header), 1, fp) != 1;
+    error |= fwrite(stats->layerPoints, sizeof(long), layers, fp) != (size_t)layers;
+    error |= fwrite(stats->layerSegments, sizeof(long), layers, fp) != (size_t)layers;
+    error |= fwrite(stats->layerArcs, sizeof(long), layers, fp) != (size_t)layers;
+    error |= fwrite(stats->tracks, sizeof(long), tracks, fp) != tracks;
+    error |= fwrite(stats->coilVias, sizeof(int), count, fp) != (size_t)count;
+    error |= fwrite(stats->coilLinks, sizeof(int), count, fp) != (size_t)count;
+    error |= fwrite(list->items, sizeof(CoilItem), list->count, fp) != list->count;
+    error |= fclose(fp) != 0;
+
+    error ? remove(temp) : rename(temp, path);
+}
+
+/* cacheReplay
+ * Hands items of the cache to the sink in the units of a generation: each layer of each coil in
+ * chunks of UNIT_SIZE items and the vias of each coil. The items are moved to their place and
+ * formatted on the calling thread.
+ * Returns 0 when everything is written, 1 when the unit could not be allocated and 2 when the
+ * sink stopped.
+ *
+ * Parameters:
+ *  -   params:     Parameters of the coils (formatter)
+ *  -   sink:       Receiver of the items
+ *  -   items:      Items in the order of the file
+ *  -   count:      Number of items
+ *  -   transform:  Placement of the items (cachePlacement, NULL keeps them in place)
+ */
+static int cacheReplay(const CoilParams *params, const CoilSink *sink, const CoilItem *items, size_t count, const double transform[6]) {
+    CoilItem *moved = malloc(UNIT_SIZE * sizeof(CoilItem));
+    CoilWriter text = {NULL, NULL, WRITER_SIZE, 0, 0, params->precision, params->trimZeros, 0, 0};
+    sink->format != NULL ? text.buffer = malloc(WRITER_SIZE) : 0;
+    int error = moved == NULL || (sink->format != NULL && text.buffer == NULL);
+
+    for (size_t group = 0, end = 0; group < count && !error; group = end) {
+
+        // Items of one layer of a coil, or the vias and via connections of the coil
+        int layer = items[group].kind >= COIL_VIA ? -1 : items[group].layer;
+        end = group;
+        while (end < count && items[end].coil == items[group].coil && (items[end].kind >= COIL_VIA ? -1 : items[end].layer) == layer) {
+            end++;
+        }
+
+        int chunks = (int)((end - group + UNIT_SIZE - 1) / UNIT_SIZE);
+        for (int c = 0; c < chunks && !error; c++) {
+            size_t first = group + (size_t)c * UNIT_SIZE;
+            size_t last = first + UNIT_SIZE < end ? first + UNIT_SIZE : end;
+
+            // Move the items to their place
+            memcpy(moved, items + first, (last - first) * sizeof(CoilItem));
+            for (size_t n = 0; n < last - first && transform != NULL; n++) {
+                coilTransform(items[first+n].start[0], items[first+n].start[1], transform, &moved[n].start[0], &moved[n].start[1]);
+                coilTransform(items[first+n].mid[0], items[first+n].mid[1], transform, &moved[n].mid[0], &moved[n].mid[1]);
+                coilTransform(items[first+n].end[0], items[first+n].end[1], transform, &moved[n].end[0], &moved[n].end[1]);
+            }
+
+            CoilUnit view = {items[group].coil, layer, layer < 0 ? 0 : c, layer < 0 ? 1 : chunks, (long)(first - group), moved, (int)(last - first), sink->format != NULL ? &text : NULL};
+            if (sink->format != NULL) {
+                text.length = 0;
+                sink->format(sink->context, params, &view, &text);
+                text.error ? error = 1 : 0;
+            }
+            !error && sink->write(sink->context, &view) ? error = 2 : 0;
+        }
+    }
+
+    free(moved);
+    free(text.buffer);
+    return error;
+}
+
+/* cacheTeeFormat
+ * Formatter of the sink of a cache miss, calls the formatter of the caller.
+ */
+static void cacheTeeFormat(void *context, const CoilParams *params, const CoilUnit *unit, CoilWriter *out) {
+    CacheTee *tee = context;
+    tee->sink->format(tee->sink->context, params, unit, out);
+}
+
+/* cacheTeeWrite
+ * Sink of a cache miss: collects the items for the cache and hands the unit on to the sink of the
+ * caller. Returns the result of the sink of the caller.
+ */
+static int cacheTeeWrite(void *context, const CoilUnit *unit) {
+    CacheTee *tee = context;
+
+    // Without memory for the list the coils are still written, but not cached
+    if (!tee->failed && coilListWrite(&tee->list, unit)) {
+        tee->failed = 1;
+    }
+
+    return tee->sink->write(tee->sink->context, unit);
+}
+
+/* coilCacheGenerate
+ * Generates the coils into the sink through a cache directory of generated geometry. The cache is
+ * addressed by the parameters of the geometry (coilCacheKey): a hit maps the items of the entry
+ * into memory and only moves them to their place (cachePlacement), a miss generates the geometry
+ * (coilGenerate) and adds it to the cache. Coils in place are the same as without the cache, moved
+ * ones can differ from a direct generation in the last digit. stats->cached tells a hit from a miss.
+ * Returns the same as coilGenerate.
+ *
+ * Parameters:
+ *  -   dir:        Cache directory (created when missing)
+ *  -   params:     Parameters of the coils
+ *  -   sink:       Receiver of the items
+ *  -   buffers:    Work units, reused between generations (NULL allocates them for this generation)
+ *  -   stats:      Returned counters of the generation (NULL if not needed, else freed by coilStatsFree)
+ */
+int coilCacheGenerate(const char *dir, const CoilParams *params, const CoilSink *sink, CoilBuffers *buffers, CoilStats *stats) {
+    CoilParams base;
+    double transform[6];
+    int moved = cachePlacement(params, &base, transform);
+    unsigned long long key = coilCacheKey(params);
+    int error;
+
+    // Counters of this generation only
+    CoilStats localStats;
+    stats == NULL ? stats = &localStats : stats;
+
+    CacheEntry entry;
+    if (!cacheOpen(dir, key, &entry)) {
+        // Hit: move the items of the entry to their place
+        error = cacheStats(&entry, stats);
+        !error ? error = cacheReplay(params, sink, entry.items, entry.header->items, moved ? transform : NULL) : 0;
+        munmap((void *)entry.header, entry.size);
+    } else {
+        // Miss: generate the geometry in place and keep its items for the cache
+        CacheTee tee = {{NULL, 0, 0}, sink, 0};
+        if (moved) {
+            CoilSink list = {&tee.list, NULL, coilListWrite};
+            error = coilGenerate(&base, &list, buffers, stats) ? 1 : cacheReplay(params, sink, tee.list.items, tee.list.count, transform);
+        } else {
+            CoilSink teeSink = {&tee, sink->format != NULL ? cacheTeeFormat : NULL, cacheTeeWrite};
+            error = coilGenerate(&base, &teeSink, buffers, stats);
+        }
+
+        if (!error && !tee.failed) cacheSave(dir, key, base.count < 1 ? 1 : base.count, base.layers < 1 ? 1 : base.layers, stats, &tee.list);
+        free(tee.list.items);
+    }
+
+    if (stats == &localStats) coilStatsFree(&localStats);
+    return error;
+}
+
+/* coilCacheStats
+ * Reads the counters of a generation from the cache without generating the coils, for callers
+ * keeping the output of the coils themselves.
+ * Returns 0 when the geometry is in the cache, 1 when it is not (stats are not filled).
+ *
+ * Parameters:
+ *  -   dir:        Cache directory
+ *  -   params:     Parameters of the coils
+ *  -   stats:      Returned counters (freed by coilStatsFree)
+ */
+int coilCacheStats(const char *dir, const CoilParams *params, CoilStats *stats) {
+    CacheEntry entry;
+    if (cacheOpen(dir, coilCacheKey(params), &entry)) {
+        return 1;
+    }
+
+    int error = cacheStats(&entry, stats);
+    munmap((void *)entry.header, entry.size);
+
+    if (error) coilStatsFree(stats);
+    return error;
+}
+/* --- End of CACHE --- */
+
+/* --- ANALYSIS --- */
+
+/* filamentSelf
+ * Returns the partial self inductance of a straight filament over MU_0_4PI: the Neumann
+ * integral of the filament with itself, with the distances kept at least the geometric mean
+ * distance of the cross section, so short pieces of a long track add up to the track.
+ *
+ * Parameters:
+ *  -   length:     Length of the filament
+ *  -   gmd:        Geometric mean distance of the cross section
+ */
+static double filamentSelf(double length, double gmd) {
+    return 2*(length*asinh(length/gmd) - sqrt(length*length + gmd*gmd) + gmd);
+}
+
+/* filamentMutual
+ * Returns the partial mutual inductance of two filaments over MU_0_4PI (Neumann formula).
+ * Far filaments only take the distance of their middle points, near ones are split into pieces
+ * no longer than their distance and integrated with a two point Gauss rule on each piece.
+ *
+ * Parameters:
+ *  -   a:          First filament
+ *  -   b:          Second filament
+ */
+static double filamentMutual(const Filament *a, const Filament *b) {
+    double dot = a->current[0]*b->current[0] + a->current[1]*b->current[1] + a->current[2]*b->current[2];
+    if (dot == 0) {
+        return 0;
+    }
+
+    // Distance between the middle points of the filaments
+    double d[3];
+    for (int c = 0; c < 3; c++) {
+        d[c] = (b->start[c] + b->current[c]/2) - (a->start[c] + a->current[c]/2);
+    }
+    double distance = sqrt(d[0]*d[0] + d[1]*d[1] + d[2]*d[2]);
+
+    // Far field
+    if (distance > FAR_FIELD*(a->length + b->length)/2) {
+        return dot/distance;
+    }
+
+    // Pieces of the filaments no longer than their distance (at least the geometric mean distance)
+    double gmd = (a->gmd + b->gmd)/2;
+    double piece = fmax(gmd, distance - (a->length + b->length)/2);
+    int na = a->length/piece < 16 ? 1 + (int)(a->length/piece) : 16;
+    int nb = b->length/piece < 16 ? 1 + (int)(b->length/piece) : 16;
+
+    // Two point Gauss rule on every piece (positions along the filaments)
+    const double gauss[2] = {0.5 - 0.5/sqrt(3), 0.5 + 0.5/sqrt(3)};
+    double sum = 0;
+    for (int i = 0; i < 2*na; i++) {
+        double s = (i/2 + gauss[i%2])/na;
+        for (int j = 0; j < 2*nb; j++) {
+            double t = (j/2 + gauss[j%2])/nb;
+            double r[3];
+            for (int c = 0; c < 3; c++) {
+                r[c] = b->start[c] + t*b->current[c] - a->start[c] - s*a->current[c];
+            }
+            sum += 1/sqrt(r[0]*r[0] + r[1]*r[1] + r[2]*r[2] + gmd*gmd);
+        }
+    }
+
+    return dot*sum/(4*na*nb);
+}
+
+/* clusterShape
+ * Calculates the center and the current of the filaments of a cluster, the distance of their
+ * farthest end from the center and the moments of their currents about the center (clusterFar).
+ *
+ * Parameters:
+ *  -   cluster:    Cluster with its filaments set
+ *  -   filaments:  Filaments of the analysis
+ */
+static void clusterShape(Cluster *cluster, const Filament *filaments) {
+    int end = cluster->first + cluster->count;
+    for (int c = 0; c < 3; c++) {
+        cluster->center[c] = 0;
+        cluster->current[c] = 0;
+        for (int f = cluster->first; f < end; f++) {
+            cluster->center[c] += (filaments[f].start[c] + filaments[f].current[c]/2)/cluster->count;
+            cluster->current[c] += filaments[f].current[c];
+        }
+    }
+
+    cluster->radius = 0;
+    memset(cluster->moment, 0, sizeof(cluster->moment));
+    memset(cluster->spread, 0, sizeof(cluster->spread));
+    for (int f = cluster->first; f < end; f++) {
+        const double *a = filaments[f].current;
+        for (int e = 0; e < 2; e++) {
+            double dx = filaments[f].start[0] + e*a[0] - cluster->center[0];
+            double dy = filaments[f].start[1] + e*a[1] - cluster->center[1];
+            cluster->radius = fmax(cluster->radius, hypot(dx, dy));
+        }
+
+        // Moments of the current spread evenly along the filament about its middle point
+        double offset[2] = {filaments[f].start[0] + a[0]/2 - cluster->center[0], filaments[f].start[1] + a[1]/2 - cluster->center[1]};
+        for (int p = 0; p < 2; p++) {
+            for (int q = 0; q < 2; q++) {
+                cluster->moment[p][q] += a[p]*offset[q];
+                for (int t = 0; t < 2; t++) {
+                    cluster->spread[p][q][t] += a[p]*(offset[q]*offset[t] + a[q]*a[t]/12);
+                }
+            }
+        }
+    }
+}
+
+/* clusterFar
+ * Returns the mutual inductance of two far clusters over MU_0_4PI: the Neumann formula expanded
+ * about the centers of the clusters up to the second order of their offsets, so a cluster with
+ * little current of its own (a turn of a spiral) still adds the field of its loop.
+ *
+ * Parameters:
+ *  -   a:          First cluster
+ *  -   b:          Second cluster
+ *  -   d:          Distance from the center of the first to the center of the second cluster
+ *  -   distance:   Length of the distance
+ */
+static double clusterFar(const Cluster *a, const Cluster *b, const double d[3], double distance) {
+    double r2 = distance*distance, r3 = r2*distance, r5 = r3*r2;
+
+    // Single filaments, then the offsets of either cluster along the distance
+    double value = (a->current[0]*b->current[0] + a->current[1]*b->current[1])/distance;
+    for (int p = 0; p < 2; p++) {
+        double alongA = a->moment[p][0]*d[0] + a->moment[p][1]*d[1];
+        double alongB = b->moment[p][0]*d[0] + b->moment[p][1]*d[1];
+        value += (b->current[p]*alongA - a->current[p]*alongB)/r3;
+    }
+
+    // Second order: the offsets of both clusters together and of each cluster twice
+    for (int q = 0; q < 2; q++) {
+        for (int t = 0; t < 2; t++) {
+            double kernel = (3*d[q]*d[t] - (q == t ? r2 : 0))/r5;
+            for (int p = 0; p < 2; p++) {
+                value -= a->moment[p][q]*b->moment[p][t]*kernel;
+                value += (b->current[p]*a->spread[p][q][t] + a->current[p]*b->spread[p][q][t])*kernel/2;
+            }
+        }
+    }
+
+    return value;
+}
+
+/* clusterPair
+ * Adds the mutual inductances of the filaments of a smallest cluster with the filaments of a
+ * cluster of the tree (or the self and mutual inductances of the filaments of one cluster) to the
+ * inductances of their layers. Far clusters are taken together (clusterFar), near clusters of the
+ * tree are split into the clusters they join, so only the near smallest clusters are taken
+ * filament by filament. The filaments before the row were paired by their own rows.
+ *
+ * Parameters:
+ *  -   job:        Filaments and clusters of the analysis
+ *  -   a:          Index of the smallest cluster (row)
+ *  -   b:          Index of the cluster of the tree
+ *  -   inductance: Inductances of the layers the pair is added to (layers x layers, over MU_0_4PI)
+ */
+static void clusterPair(const Analysis *job, int a, int b, double *inductance) {
+    const Cluster *ca = &job->clusters[a], *cb = &job->clusters[b];
+    double value = 0;
+
+    if (cb->first + cb->count <= ca->first) {
+        return;
+    }
+
+    if (a == b) {
+        // Self inductance of the filaments and their mutual inductances within the cluster
+        for (int i = ca->first; i < ca->first + ca->count; i++) {
+            value += filamentSelf(job->filaments[i].length, job->filaments[i].gmd);
+            for (int j = i+1; j < ca->first + ca->count; j++) {
+                value += 2*filamentMutual(&job->filaments[i], &job->filaments[j]);
+            }
+        }
+        inductance[ca->layer*job->layers + ca->layer] += value;
+        return;
+    }
+
+    double d[3] = {cb->center[0] - ca->center[0], cb->center[1] - ca->center[1], cb->center[2] - ca->center[2]};
+    double distance = sqrt(d[0]*d[0] + d[1]*d[1] + d[2]*d[2]);
+
+    if (cb->first >= ca->first && distance > CLUSTER_FAR*(ca->radius + cb->radius)) {
+        // Far field of the clusters (a cluster holding the row is always split)
+        value = clusterFar(ca, cb, d, distance);
+    } else if (cb->children[0] >= 0) {
+        // Near cluster of the tree, taken cluster by cluster
+        clusterPair(job, a, cb->children[0], inductance);
+        clusterPair(job, a, cb->children[1], inductance);
+        return;
+    } else {
+        for (int i = ca->first; i < ca->first + ca->count; i++) {
+            for (int j = cb->first; j < cb->first + cb->count; j++) {
+                value += filamentMutual(&job->filaments[i], &job->filaments[j]);
+            }
+        }
+    }
+
+    // The pair is counted for both clusters
+    inductance[ca->layer*job->layers + cb->layer] += value;
+    inductance[cb->layer*job->layers + ca->layer] += value;
+}
+
+/* analysisWorker
+ * Thread of the inductance calculation: takes the rows of smallest clusters in order and adds the
+ * pairs of each row with the clusters of the tree after it to its own inductances.
+ *
+ * Parameters:
+ *  -   arg:        Analysis shared by the threads
+ */
+static void *analysisWorker(void *arg) {
+    Analysis *job = arg;
+    double *inductance = calloc(job->layers * job->layers, sizeof(double));
+    if (inductance == NULL) {
+        return job;
+    }
+
+    pthread_mutex_lock(&job->lock);
+    while (job->next < job->total) {
+        int a = job->next++;
+        pthread_mutex_unlock(&job->lock);
+
+        for (int r = 0; r < job->runs; r++) {
+            clusterPair(job, a, job->roots[r], inductance);
+        }
+
+        pthread_mutex_lock(&job->lock);
+    }
+
+    // Add the inductances of the thread
+    for (int i = 0; i < job->layers * job->layers; i++) {
+        job->inductance[i] += inductance[i];
+    }
+    pthread_mutex_unlock(&job->lock);
+
+    free(inductance);
+    return NULL;
+}
+
+/* filamentAdd
+ * Adds a straight piece of a track to the filaments of the analysis.
+ *
+ * Parameters:
+ *  -   filament:   Returned filament
+ *  -   start:      Start point of the piece
+ *  -   end:        End point of the piece
+ *  -   height:     Height of the copper layer
+ *  -   sign:       Direction of the current of the layer (±1)
+ *  -   gmd:        Geometric mean distance of the cross section of the track
+ *  -   layer:      Index of the copper layer
+ */
+static void filamentAdd(Filament *filament, const double start[2], const double end[2], double height, int sign, double gmd, int layer) {
+    filament->start[0] = sign > 0 ? start[0] : end[0];
+    filament->start[1] = sign > 0 ? start[1] : end[1];
+    filament->start[2] = height;
+    filament->current[0] = sign*(end[0] - start[0]);
+    filament->current[1] = sign*(end[1] - start[1]);
+    filament->current[2] = 0;
+    filament->length = hypot(end[0] - start[0], end[1] - start[1]);
+    filament->gmd = gmd;
+    filament->layer = layer;
+}
+
+/* arcShape
+ * Calculates the center, radius and sweep of an arc through its start, middle and end point.
+ * Returns 1 when the points are on a line (a straight segment).
+ *
+ * Parameters:
+ *  -   item:       Arc
+ *  -   center:     Returned center of the arc
+ *  -   radius:     Returned radius of the arc
+ *  -   start:      Returned angle of the start point
+ *  -   sweep:      Returned angle from the start to the end point (through the middle point)
+ */
+static int arcShape(const CoilItem *item, double center[2], double *radius, double *start, double *sweep) {
+    double ax = item->start[0], ay = item->start[1];
+    double bx = item->mid[0] - ax, by = item->mid[1] - ay;
+    double cx = item->end[0] - ax, cy = item->end[1] - ay;
+    double det = 2*(bx*cy - by*cx);
+    if (fabs(det) < 1e-12) {
+        return 1;
+    }
+
+    // Circle through the three points
+    center[0] = ax + (cy*(bx*bx + by*by) - by*(cx*cx + cy*cy))/det;
+    center[1] = ay + (bx*(cx*cx + cy*cy) - cx*(bx*bx + by*by))/det;
+    *radius = hypot(ax - center[0], ay - center[1]);
+
+    // Both halves of the arc turn the same way and are less than half a turn
+    double angles[3] = {atan2(ay - center[1], ax - center[0]), atan2(item->mid[1] - center[1], item->mid[0] - center[0]), atan2(item->end[1] - center[1], item->end[0] - center[0])};
+    double first = remainder(angles[1] - angles[0], 2*M_PI), second = remainder(angles[2] - angles[1], 2*M_PI);
+    *start = angles[0];
+    *sweep = first + second;
+    return 0;
+}
+
+/* coilAnalyze
+ * Calculates the length, DC resistance and inductance of the tracks of a single coil: the wire
+ * segments, arcs and via connections of the first coil of the items (all coils are instances
+ * of the same coil). The layers are connected in series by the vias with the current turning the
+ * same way on every layer, so the inductance of the coil is the sum of the self and mutual
+ * inductances of its layers. The inductances are calculated from the Neumann formula over the
+ * straight pieces of the tracks (arcs are split into pieces), with the far pieces taken together
+ * in a tree of clusters: the farther the pieces, the larger the clusters taken as one.
+ * The vias are left out. Returns 1 when the memory could not be allocated.
+ *
+ * Parameters:
+ *  -   items:      Items of the coils (coilListWrite)
+ *  -   count:      Number of items
+ *  -   layers:     Number of copper layers
+ *  -   copper:     Thickness of the copper (system units)
+ *  -   board:      Thickness of the board, the layers are evenly spaced (system units)
+ *  -   threads:    Threads calculating the inductance
+ *  -   analysis:   Returned results (freed by coilAnalysisFree)
+ */
+int coilAnalyze(const CoilItem *items, size_t count, int layers, double copper, double board, int threads, CoilAnalysis *analysis) {
+    double timeBegin = coilNow();
+    layers < 1 ? layers = 1 : layers;
+    threads < 1 ? threads = 1 : threads;
+    copper <= 0 ? copper = 0.035 : copper;      // Failsafe for the callers of the library (1 oz copper)
+
+    analysis->layers = layers;
+    analysis->length = calloc(layers, sizeof(double));
+    analysis->resistance = calloc(layers, sizeof(double));
+    analysis->inductance = calloc(layers * layers, sizeof(double));
+    analysis->totalLength = 0;
+    analysis->totalResistance = 0;
+    analysis->totalInductance = 0;
+    analysis->filaments = 0;
+    analysis->clusters = 0;
+
+    // Filaments of the tracks, arcs split into pieces
+    size_t capacity = 0;
+    for (size_t n = 0; n < count; n++) {
+        const CoilItem *item = &items[n];
+        double center[2], radius, start, sweep;
+        if (item->coil == 0 && item->kind != COIL_VIA) {
+            capacity += item->kind == COIL_ARC && !arcShape(item, center, &radius, &start, &sweep) ? 1 + (size_t)(fabs(sweep)/ARC_PIECE) : 1;
+        }
+    }
+    Filament *filaments = malloc((capacity ? capacity : 1) * sizeof(Filament));
+    Cluster *clusters = malloc((capacity ? 2*capacity : 1) * sizeof(Cluster));
+    int *order = malloc((capacity ? 2*capacity : 2) * sizeof(int));
+    int *roots = order != NULL ? order + (capacity ? capacity : 1) : NULL;
+
+    int error = analysis->length == NULL || analysis->resistance == NULL || analysis->inductance == NULL || filaments == NULL || clusters == NULL || order == NULL;
+    int total = 0, groups = 0;
+
+    for (size_t n = 0; n < count && !error; n++) {
+        const CoilItem *item = &items[n];
+        if (item->coil != 0 || item->kind == COIL_VIA || item->layer < 0 || item->layer >= layers) {
+            continue;
+        }
+
+        // Layers are evenly spaced through the board, every other layer is run through the other way
+        int layer = item->layer;
+        double height = layers > 1 ? board*layer/(layers-1) : 0;
+        int sign = layer % 2 ? 1 : -1;
+        double gmd = 0.2235*(item->width + copper);     // Geometric mean distance of a rectangle
+        double length;
+        double center[2], radius, start, sweep;
+
+        if (item->kind == COIL_ARC && !arcShape(item, center, &radius, &start, &sweep)) {
+            // Arc split into straight pieces of at most ARC_PIECE
+            int pieces = 1 + (int)(fabs(sweep)/ARC_PIECE);
+            double prev[2] = {item->start[0], item->start[1]}, next[2];
+            for (int p = 1; p <= pieces; p++) {
+                next[0] = p < pieces ? center[0] + radius*cos(start + sweep*p/pieces) : item->end[0];
+                next[1] = p < pieces ? center[1] + radius*sin(start + sweep*p/pieces) : item->end[1];
+                filamentAdd(&filaments[total++], prev, next, height, sign, gmd, layer);
+                prev[0] = next[0];
+                prev[1] = next[1];
+            }
+            length = radius*fabs(sweep);
+        } else {
+            filamentAdd(&filaments[total++], item->start, item->end, height, sign, gmd, layer);
+            length = filaments[total-1].length;
+        }
+
+        analysis->length[layer] += length;
+        analysis->resistance[layer] += item->width > 0 ? COPPER_RESISTIVITY*length/(item->width*copper) : 0;
+    }
+
+    // Consecutive filaments of a layer make up the smallest clusters of the far field
+    for (int i = 0; i < total && !error; ) {
+        Cluster *cluster = &clusters[groups++];
+        cluster->first = i;
+        cluster->layer = filaments[i].layer;
+        cluster->count = 0;
+        cluster->children[0] = -1;
+        cluster->children[1] = -1;
+        while (i < total && cluster->count < CLUSTER_SIZE && filaments[i].layer == cluster->layer) {
+            cluster->count++;
+            i++;
+        }
+        clusterShape(cluster, filaments);
+    }
+
+    // Tree of the clusters: the consecutive clusters of each run of a layer are joined in pairs,
+    // level by level, up to the top cluster of the run
+    int smallest = groups, runs = 0;
+    for (int c = 0; c < smallest && !error; ) {
+        int level = 0;
+        while (c < smallest && (level == 0 || clusters[c].layer == clusters[order[0]].layer)) {
+            order[level++] = c++;
+        }
+        while (level > 1) {
+            int joined = 0;
+            for (int k = 0; k < level; k += 2) {
+                if (k+1 < level) {
+                    Cluster *cluster = &clusters[groups];
+                    cluster->first = clusters[order[k]].first;
+                    cluster->count = clusters[order[k]].count + clusters[order[k+1]].count;
+                    cluster->layer = clusters[order[k]].layer;
+                    cluster->children[0] = order[k];
+                    cluster->children[1] = order[k+1];
+                    clusterShape(cluster, filaments);
+                    order[joined++] = groups++;
+                } else {
+                    order[joined++] = order[k];
+                }
+            }
+            level = joined;
+        }
+        roots[runs++] = order[0];
+    }
+
+    // Inductances of the layers, the rows of clusters shared by the threads
+    Analysis job = {filaments, clusters, roots, smallest, runs, 0, layers, analysis->inductance, PTHREAD_MUTEX_INITIALIZER};
+    if (!error) {
+        pthread_t *workers = malloc(threads * sizeof(pthread_t));
+        int started = 0;
+        for (int t = 1; t < threads && workers != NULL && groups > 1; t++) {
+            pthread_create(&workers[started], NULL, analysisWorker, &job) ? 0 : started++;
+        }
+        analysisWorker(&job);
+        for (int t = 0; t < started; t++) {
+            pthread_join(workers[t], NULL);
+        }
+        free(workers);
+
+        // Rows left when no thread had the memory for its inductances
+        job.next < job.total ? error = 1 : 0;
+    }
+
+    // Results in ohm and henry, the layers in series
+    for (int i = 0; i < layers && !error; i++) {
+        analysis->totalLength += analysis->length[i];
+        analysis->totalResistance += analysis->resistance[i];
+        for (int j = 0; j < layers; j++) {
+            analysis->inductance[i*layers + j] *= MU_0_4PI;
+            analysis->totalInductance += analysis->inductance[i*layers + j];
+        }
+    }
+    analysis->filaments = total;
+    analysis->clusters = groups;
+    analysis->time = coilNow() - timeBegin;
+
+    free(filaments);
+    free(clusters);
+    free(order);
+    if (error) coilAnalysisFree(analysis);
+    return error;
+}
+
+/* coilAnalysisFree
+ * Frees the results of coilAnalyze.
+ *
+ * Parameters:
+ *  -   analysis:   Results to free
+ */
+void coilAnalysisFree(CoilAnalysis *analysis) {
+    free(analysis->length);
+    free(analysis->resistance);
+    free(analysis->inductance);
+    analysis->length = NULL;
+    analysis->resistance = NULL;
+    analysis->inductance = NULL;
+}
+/* --- End of ANALYSIS --- */
+
+/* --- CLEARANCE --- */
+
+/* segmentDistance
+ * Returns the distance between two line segments (points when both ends are the same)
+ * and their closest points.
+ *
+ * Parameters:
+ *  -   p0, p1:     Ends of the first segment
+ *  -   q0, q1:     Ends of the second segment
+ *  -   cp, cq:     Returned closest points of the segments
+ */
+static double segmentDistance(const double p0[2], const double p1[2], const double q0[2], const double q1[2], double cp[2], double cq[2]) {
+    double d1[2] = {p1[0] - p0[0], p1[1] - p0[1]}, d2[2] = {q1[0] - q0[0], q1[1] - q0[1]}, r[2] = {p0[0] - q0[0], p0[1] - q0[1]};
+    double a = d1[0]*d1[0] + d1[1]*d1[1], e = d2[0]*d2[0] + d2[1]*d2[1], f = d2[0]*r[0] + d2[1]*r[1];
+    double s = 0, t = 0;
+
+    if (a <= 1e-18 && e <= 1e-18) {
+        // Both are points
+    } else if (a <= 1e-18) {
+        t = fmin(1, fmax(0, f/e));
+    } else {
+        double c = d1[0]*r[0] + d1[1]*r[1];
+        if (e <= 1e-18) {
+            s = fmin(1, fmax(0, -c/a));
+        } else {
+            // Closest points of the lines, clamped to the segments
+            double b = d1[0]*d2[0] + d1[1]*d2[1], denom = a*e - b*b;
+            s = denom > 1e-18 ? fmin(1, fmax(0, (b*f - c*e)/denom)) : 0;
+            t = (b*s + f)/e;
+            if (t < 0) {
+                t = 0;
+                s = fmin(1, fmax(0, -c/a));
+            } else if (t > 1) {
+                t = 1;
+                s = fmin(1, fmax(0, (b - c)/a));
+            }
+        }
+    }
+
+    cp[0] = p0[0] + s*d1[0];
+    cp[1] = p0[1] + s*d1[1];
+    cq[0] = q0[0] + t*d2[0];
+    cq[1] = q0[1] + t*d2[1];
+    return hypot(cp[0] - cq[0], cp[1] - cq[1]);
+}
+
+/* trackDistance
+ * Returns the distance between two pieces of the same track, only comparing the points of both
+ * pieces at least the given length apart along the track: the copper closer along the track is
+ * connected. The points of a piece are spread evenly over its positions along the track, so the
+ * result does not depend on how the track was split into pieces. The pairs of points apart form
+ * two corners of the square of the positions on both pieces (one piece ahead of the other), and
+ * the closest pair is the closest one of both pieces when it lies in a corner, or else on the edge
+ * of a corner. Returns INFINITY when every pair of points is connected.
+ *
+ * Parameters:
+ *  -   p, q:       Pieces of the track
+ *  -   apart:      Length along the track the copper is connected within
+ *  -   cp, cq:     Returned closest points apart
+ */
+static double trackDistance(const Shape *p, const Shape *q, double apart, double cp[2], double cq[2]) {
+    double dp[2] = {p->b[0] - p->a[0], p->b[1] - p->a[1]}, dq[2] = {q->b[0] - q->a[0], q->b[1] - q->a[1]};
+    double lp = dp[0]*dp[0] + dp[1]*dp[1], lq = dq[0]*dq[0] + dq[1]*dq[1];
+
+    // Closest points of both pieces and their fractions u and v along the pieces
+    double distance = segmentDistance(p->a, p->b, q->a, q->b, cp, cq);
+    double u = lp > 0 ? ((cp[0] - p->a[0])*dp[0] + (cp[1] - p->a[1])*dp[1])/lp : 0;
+    double v = lq > 0 ? ((cq[0] - q->a[0])*dq[0] + (cq[1] - q->a[1])*dq[1])/lq : 0;
+
+    // How far p is ahead of q along the track: f(u, v) = ahead + u*lengthP - v*lengthQ
+    double ahead = p->from - q->from, lengthP = p->to - p->from, lengthQ = q->to - q->from;
+    double f = ahead + u*lengthP - v*lengthQ;
+    if (fabs(f) >= apart) {
+        return distance;
+    }
+
+    double best = INFINITY;
+    for (int side = -1; side <= 1; side += 2) {
+        // Corner of the square where side*f >= apart (the square clipped by a line)
+        double corner[6][2], square[4][2] = {{0, 0}, {1, 0}, {1, 1}, {0, 1}};
+        int vertices = 0;
+        for (int k = 0; k < 4; k++) {
+            const double *s0 = square[k], *s1 = square[(k+1) % 4];
+            double g0 = side*(ahead + s0[0]*lengthP - s0[1]*lengthQ) - apart;
+            double g1 = side*(ahead + s1[0]*lengthP - s1[1]*lengthQ) - apart;
+            if (g0 >= 0) {
+                corner[vertices][0] = s0[0];
+                corner[vertices++][1] = s0[1];
+            }
+            if ((g0 >= 0) != (g1 >= 0)) {
+                double t = g0/(g0 - g1);
+                corner[vertices][0] = s0[0] + t*(s1[0] - s0[0]);
+                corner[vertices++][1] = s0[1] + t*(s1[1] - s0[1]);
+            }
+        }
+
+        // Closest pair on the edges of the corner: the difference of the points moves along a line
+        for (int k = 0; k < vertices; k++) {
+            const double *e0 = corner[k], *e1 = corner[(k+1) % vertices];
+            double x0[2] = {p->a[0] + e0[0]*dp[0], p->a[1] + e0[0]*dp[1]}, y0[2] = {q->a[0] + e0[1]*dq[0], q->a[1] + e0[1]*dq[1]};
+            double x1[2] = {p->a[0] + e1[0]*dp[0], p->a[1] + e1[0]*dp[1]}, y1[2] = {q->a[0] + e1[1]*dq[0], q->a[1] + e1[1]*dq[1]};
+            double d0[2] = {x0[0] - y0[0], x0[1] - y0[1]}, step[2] = {x1[0] - y1[0] - d0[0], x1[1] - y1[1] - d0[1]};
+            double length = step[0]*step[0] + step[1]*step[1];
+            double t = length > 0 ? fmin(1, fmax(0, -(d0[0]*step[0] + d0[1]*step[1])/length)) : 0;
+            double gap = hypot(d0[0] + t*step[0], d0[1] + t*step[1]);
+            if (gap < best) {
+                best = gap;
+                cp[0] = x0[0] + t*(x1[0] - x0[0]);
+                cp[1] = x0[1] + t*(x1[1] - x0[1]);
+                cq[0] = y0[0] + t*(y1[0] - y0[0]);
+                cq[1] = y0[1] + t*(y1[1] - y0[1]);
+            }
+        }
+    }
+
+    return best;
+}
+
+/* shapeAdd
+ * Adds a straight piece of a track or a via to the shapes of the clearance check.
+ *
+ * Parameters:
+ *  -   shape:      Returned shape
+ *  -   item:       Item of the shape
+ *  -   a:          Start of the piece (center of a via)
+ *  -   b:          End of the piece (center of a via)
+ *  -   from:       Position of the start along the track of its layer
+ *  -   via:        Index of the via (-1 for tracks)
+ */
+static void shapeAdd(Shape *shape, const CoilItem *item, const double a[2], const double b[2], double from, int via) {
+    shape->a[0] = a[0];
+    shape->a[1] = a[1];
+    shape->b[0] = b[0];
+    shape->b[1] = b[1];
+    shape->radius = item->width/2;
+    shape->from = from;
+    shape->to = from + hypot(b[0] - a[0], b[1] - a[1]);
+    shape->layer = item->kind == COIL_VIA ? -1 : item->layer;
+    shape->coil = item->coil;
+    shape->kind = item->kind;
+    shape->via = via;
+}
+
+/* runAdd
+ * Adds a straight piece of a track to the shapes of the clearance check. The short pieces of
+ * the uniform steps are joined into one shape as long as the shape deviates less than the
+ * tolerance from them, and every shape of a track is made wider by the tolerance, so the
+ * number of shapes around each shape does not grow with the resolution.
+ *
+ * Parameters:
+ *  -   run:        Points of the pieces joined into the last shape
+ *  -   shapes:     Shapes of the check
+ *  -   total:      Number of shapes (updated)
+ *  -   item:       Item of the piece
+ *  -   layer:      Index of the copper layer
+ *  -   a:          Start of the piece
+ *  -   b:          End of the piece
+ *  -   position:   Position along the track of each layer (updated)
+ *  -   tolerance:  Largest deviation of a shape from its pieces
+ */
+static void runAdd(Run *run, Shape *shapes, int *total, const CoilItem *item, int layer, const double a[2], const double b[2], double *position, double tolerance) {
+    Shape *last = *total > 0 ? &shapes[*total-1] : NULL;
+
+    // Continues the track of the last shape
+    if (last != NULL && run->length > 0 && run->length <= RUN_SIZE && last->via < 0 && last->coil == item->coil && last->layer == layer && last->radius == item->width/2 + tolerance && last->b[0] == a[0] && last->b[1] == a[1]) {
+        const double *start = run->points[0];
+        double chord[2] = {b[0] - start[0], b[1] - start[1]}, length = hypot(chord[0], chord[1]);
+        int joined = length > 0;
+        for (int k = 1; k < run->length && joined; k++) {
+            double offset[2] = {run->points[k][0] - start[0], run->points[k][1] - start[1]};
+            joined = fabs(offset[0]*chord[1] - offset[1]*chord[0])/length <= tolerance;
+        }
+
+        if (joined) {
+            last->b[0] = b[0];
+            last->b[1] = b[1];
+            last->to += hypot(b[0] - a[0], b[1] - a[1]);
+            position[layer] = last->to;
+            run->points[run->length][0] = b[0];
+            run->points[run->length][1] = b[1];
+            run->length++;
+            return;
+        }
+    }
+
+    shapeAdd(&shapes[(*total)++], item, a, b, position[layer], -1);
+    shapes[*total-1].layer = layer;
+    shapes[*total-1].radius += tolerance;
+    position[layer] = shapes[*total-1].to;
+    run->points[0][0] = a[0];
+    run->points[0][1] = a[1];
+    run->points[1][0] = b[0];
+    run->points[1][1] = b[1];
+    run->length = 2;
+}
+
+/* arcPieces
+ * Returns the number of straight pieces an arc is split into for the clearance check, so that
+ * the pieces deviate less than the tolerance from the arc.
+ *
+ * Parameters:
+ *  -   radius:     Radius of the arc
+ *  -   sweep:      Angle of the arc
+ *  -   tolerance:  Largest deviation of the pieces from the arc
+ */
+static int arcPieces(double radius, double sweep, double tolerance) {
+    double angle = tolerance < radius ? 2*acos(1 - tolerance/radius) : M_PI;
+    return 1 + (int)(fabs(sweep)/fmin(angle, ARC_PIECE));
+}
+
+/* gridBuild
+ * Sorts the shapes into a uniform grid. Each shape is added to every cell its copper, grown by
+ * half the clearance, covers, so two shapes closer than the clearance always share a cell.
+ * The cells are about the size of the shapes, limited to a few cells per shape.
+ * Returns 1 when the grid could not be allocated.
+ *
+ * Parameters:
+ *  -   grid:       Returned grid
+ *  -   shapes:     Shapes of the check
+ *  -   total:      Number of shapes
+ *  -   clearance:  Minimum clearance
+ */
+static int gridBuild(Grid *grid, Shape *shapes, int total, double clearance) {
+    double low[2] = {INFINITY, INFINITY}, high[2] = {-INFINITY, -INFINITY}, reach = 0, length = 0;
+    for (int i = 0; i < total; i++) {
+        for (int c = 0; c < 2; c++) {
+            low[c] = fmin(low[c], fmin(shapes[i].a[c], shapes[i].b[c]) - shapes[i].radius);
+            high[c] = fmax(high[c], fmax(shapes[i].a[c], shapes[i].b[c]) + shapes[i].radius);
+        }
+        reach = fmax(reach, 2*shapes[i].radius + clearance);
+        length += (shapes[i].to - shapes[i].from)/total;
+    }
+
+    // Cells about the size of the shapes, at most four cells per shape
+    grid->size = fmax(fmax(reach, length), 1e-6);
+    while ((high[0] - low[0])/grid->size * (high[1] - low[1])/grid->size > 4.0*total + 1024) {
+        grid->size *= 2;
+    }
+    grid->origin[0] = low[0] - clearance;
+    grid->origin[1] = low[1] - clearance;
+    grid->columns = (int)((high[0] - low[0] + 2*clearance)/grid->size) + 1;
+    grid->rows = (int)((high[1] - low[1] + 2*clearance)/grid->size) + 1;
+
+    // Cells covered by each shape
+    int cells = grid->columns * grid->rows;
+    grid->first = calloc(cells + 1, sizeof(int));
+    if (grid->first == NULL) {
+        return 1;
+    }
+    long entries = 0;
+    for (int i = 0; i < total; i++) {
+        Shape *shape = &shapes[i];
+        double grow = shape->radius + clearance/2;
+        shape->cell[0] = (int)((fmin(shape->a[0], shape->b[0]) - grow - grid->origin[0])/grid->size);
+        shape->cell[1] = (int)((fmin(shape->a[1], shape->b[1]) - grow - grid->origin[1])/grid->size);
+        shape->cell[2] = (int)((fmax(shape->a[0], shape->b[0]) + grow - grid->origin[0])/grid->size);
+        shape->cell[3] = (int)((fmax(shape->a[1], shape->b[1]) + grow - grid->origin[1])/grid->size);
+        shape->cell[2] >= grid->columns ? shape->cell[2] = grid->columns-1 : 0;
+        shape->cell[3] >= grid->rows ? shape->cell[3] = grid->rows-1 : 0;
+        for (int y = shape->cell[1]; y <= shape->cell[3]; y++) {
+            for (int x = shape->cell[0]; x <= shape->cell[2]; x++) {
+                grid->first[y*grid->columns + x + 1]++;
+                entries++;
+            }
+        }
+    }
+    for (int c = 0; c < cells; c++) {
+        grid->first[c+1] += grid->first[c];
+    }
+
+    // Shapes of each cell
+    grid->shapes = malloc((entries ? entries : 1) * sizeof(int));
+    int *fill = malloc(cells * sizeof(int));
+    if (grid->shapes == NULL || fill == NULL) {
+        free(fill);
+        return 1;
+    }
+    memcpy(fill, grid->first, cells * sizeof(int));
+    for (int i = 0; i < total; i++) {
+        for (int y = shapes[i].cell[1]; y <= shapes[i].cell[3]; y++) {
+            for (int x = shapes[i].cell[0]; x <= shapes[i].cell[2]; x++) {
+                grid->shapes[fill[y*grid->columns + x]++] = i;
+            }
+        }
+    }
+    free(fill);
+
+    return 0;
+}
+
+/* clearanceRecord
+ * Adds a violation to the check, keeping the smallest clearances in the list.
+ *
+ * Parameters:
+ *  -   check:      Results of the check
+ *  -   max:        Number of violations kept in the list
+ *  -   p, q:       Shapes of the violation
+ *  -   clearance:  Clearance between the shapes
+ *  -   cp, cq:     Closest points of the shapes
+ */
+static void clearanceRecord(CoilClearance *check, int max, const Shape *p, const Shape *q, double clearance, const double cp[2], const double cq[2]) {
+    check->violations++;
+    check->smallest = fmin(check->smallest, clearance);
+
+    // Replace the largest clearance of a full list
+    int slot = check->listed;
+    if (slot == max) {
+        slot = 0;
+        for (int v = 1; v < max; v++) {
+            check->list[v].clearance > check->list[slot].clearance ? slot = v : 0;
+        }
+        if (max == 0 || check->list[slot].clearance <= clearance) {
+            return;
+        }
+    } else {
+        check->listed++;
+    }
+
+    CoilViolation *violation = &check->list[slot];
+    violation->at[0] = (cp[0] + cq[0])/2;
+    violation->at[1] = (cp[1] + cq[1])/2;
+    violation->clearance = clearance;
+    violation->layer = p->layer >= 0 ? p->layer : q->layer;
+    violation->kind[0] = p->kind;
+    violation->kind[1] = q->kind;
+    violation->coil[0] = p->coil;
+    violation->coil[1] = q->coil;
+}
+
+/* violationCompare
+ * Orders the violations by their clearance (qsort).
+ */
+static int violationCompare(const void *a, const void *b) {
+    double ca = ((const CoilViolation *)a)->clearance, cb = ((const CoilViolation *)b)->clearance;
+    return (ca > cb) - (ca < cb);
+}
+
+/* coilClearance
+ * Checks the clearance between the copper of the items: the tracks of each layer (wire segments,
+ * arcs split into pieces and via connections) and the vias, which are on every layer. The copper
+ * a piece is connected to is left out: the points of the same track closer along the track than
+ * twice their width and the clearance, and the tracks a via sits on, which are the same copper as
+ * the via (a via is only checked against the tracks of its coil on the layers it does not connect).
+ * Only the points are left out along a track, not the whole pieces, so the check gives the same
+ * clearances however finely the track is split (trackDistance).
+ * So the check finds the turns of a layer, the vias and the coils too close to each other, while
+ * every item is only compared with the items of the cells of a uniform grid around it.
+ * Returns 1 when the memory could not be allocated.
+ *
+ * Parameters:
+ *  -   items:      Items of the coils (coilListWrite)
+ *  -   count:      Number of items
+ *  -   layers:     Number of copper layers
+ *  -   clearance:  Minimum clearance between the copper
+ *  -   max:        Number of violations kept in the list (the smallest clearances)
+ *  -   check:      Returned results (freed by coilClearanceFree)
+ */
+int coilClearance(const CoilItem *items, size_t count, int layers, double clearance, int max, CoilClearance *check) {
+    double timeBegin = coilNow();
+    layers < 1 ? layers = 1 : layers;
+    clearance < 0 ? clearance = 0 : clearance;
+    max < 0 ? max = 0 : max;
+
+    check->violations = 0;
+    check->smallest = INFINITY;
+    check->pairs = 0;
+    check->listed = 0;
+    check->list = malloc((max ? max : 1) * sizeof(CoilViolation));
+
+    // Deviation of the joined pieces and arcs, added to the width of the tracks
+    double tolerance = fmax(clearance, 1e-3)/100;
+
+    // Shapes of the items, arcs split into pieces
+    int total = 0, vias = 0;
+    size_t capacity = 0;
+    for (size_t n = 0; n < count; n++) {
+        double center[2], radius, start, sweep;
+        capacity += items[n].kind == COIL_ARC && !arcShape(&items[n], center, &radius, &start, &sweep) ? arcPieces(radius, sweep, tolerance) : 1;
+        vias += items[n].kind == COIL_VIA;
+    }
+    Shape *shapes = malloc((capacity ? capacity : 1) * sizeof(Shape));
+    double *position = calloc(layers, sizeof(double));
+    char *touch = calloc((vias ? vias : 1) * layers, 1);
+    Grid grid = {{0, 0}, 0, 0, 0, NULL, NULL};
+
+    int error = check->list == NULL || shapes == NULL || position == NULL || touch == NULL;
+    vias = 0;
+    Run run = {{{0, 0}}, 0};
+
+    for (size_t n = 0; n < count && !error; n++) {
+        const CoilItem *item = &items[n];
+        int layer = item->layer < 0 ? 0 : (item->layer >= layers ? layers-1 : item->layer);
+        double center[2], radius, start, sweep;
+
+        // Positions along the tracks start again with every coil (its items follow each other)
+        if (n > 0 && item->coil != items[n-1].coil) {
+            memset(position, 0, layers * sizeof(double));
+        }
+
+        if (item->kind == COIL_VIA) {
+            shapeAdd(&shapes[total++], item, item->start, item->start, 0, vias);
+            vias++;
+        } else if (item->kind == COIL_ARC && !arcShape(item, center, &radius, &start, &sweep)) {
+            int pieces = arcPieces(radius, sweep, tolerance);
+            double prev[2] = {item->start[0], item->start[1]}, next[2];
+            for (int p = 1; p <= pieces; p++) {
+                next[0] = p < pieces ? center[0] + radius*cos(start + sweep*p/pieces) : item->end[0];
+                next[1] = p < pieces ? center[1] + radius*sin(start + sweep*p/pieces) : item->end[1];
+                runAdd(&run, shapes, &total, item, layer, prev, next, position, tolerance);
+                prev[0] = next[0];
+                prev[1] = next[1];
+            }
+        } else {
+            runAdd(&run, shapes, &total, item, layer, item->start, item->end, position, tolerance);
+        }
+    }
+
+    error = error || gridBuild(&grid, shapes, total, clearance);
+
+    // Pass 0 finds the tracks each via sits on, pass 1 checks the clearance
+    for (int pass = 0; pass < 2 && !error; pass++) {
+        for (int c = 0; c < grid.columns * grid.rows; c++) {
+            int cx = c % grid.columns, cy = c / grid.columns;
+            for (int i = grid.first[c]; i < grid.first[c+1]; i++) {
+                for (int j = i+1; j < grid.first[c+1]; j++) {
+                    const Shape *p = &shapes[grid.shapes[i]], *q = &shapes[grid.shapes[j]];
+
+                    // Only on the same layer (vias are on every layer)
+                    if (p->layer >= 0 && q->layer >= 0 && p->layer != q->layer) {
+                        continue;
+                    }
+
+                    // Every pair is only taken in the first cell both shapes cover
+                    int x0 = p->cell[0] > q->cell[0] ? p->cell[0] : q->cell[0];
+                    int y0 = p->cell[1] > q->cell[1] ? p->cell[1] : q->cell[1];
+                    if (x0 != cx || y0 != cy || p->cell[0] > q->cell[2] || q->cell[0] > p->cell[2] || p->cell[1] > q->cell[3] || q->cell[1] > p->cell[3]) {
+                        continue;
+                    }
+
+                    // Via first
+                    if (q->via >= 0 && p->via < 0) {
+                        const Shape *swap = p;
+                        p = q;
+                        q = swap;
+                    }
+
+                    double cp[2], cq[2];
+                    double distance = segmentDistance(p->a, p->b, q->a, q->b, cp, cq);
+
+                    if (pass == 0) {
+                        // Track crossing the via of the same coil
+                        if (p->via >= 0 && q->via < 0 && p->coil == q->coil && distance <= p->radius + q->radius) {
+                            touch[p->via*layers + q->layer] = 1;
+                        }
+                        continue;
+                    }
+
+                    // Copper connected to each other along a track or through a via is left out
+                    if (p->coil == q->coil && p->via < 0) {
+                        distance = trackDistance(p, q, 2*(p->radius + q->radius + clearance), cp, cq);
+                    } else if (p->coil == q->coil && q->via < 0 && touch[p->via*layers + q->layer]) {
+                        continue;
+                    }
+                    if (distance == INFINITY) {
+                        continue;
+                    }
+
+                    check->pairs++;
+                    double edge = distance - p->radius - q->radius;
+                    if (edge < clearance) clearanceRecord(check, max, p, q, edge, cp, cq);
+                }
+            }
+        }
+    }
+
+    if (check->listed > 1) qsort(check->list, check->listed, sizeof(CoilViolation), violationCompare);
+    check->shapes = total;
+    check->time = coilNow() - timeBegin;
+
+    free(shapes);
+    free(position);
+    free(touch);
+    free(grid.first);
+    free(grid.shapes);
+    if (error) coilClearanceFree(check);
+    return error;
+}
+
+/* coilClearanceFree
+ * Frees the results of coilClearance.
+ *
+ * Parameters:
+ *  -   check:      Results to free
+ */
+void coilClearanceFree(CoilClearance *check) {
+    free(check->list);
+    check->list = NULL;
+    check->listed = 0;
+}
+/* --- End of CLEARANCE --- */
+
+/* --- ESTIMATE --- */
+
+/* ringMutual
+ * Returns the mutual inductance of two coaxial circular rings over MU_0_4PI (Maxwell's formula),
+ * the elliptic integrals are calculated with the arithmetic-geometric mean.
+ *
+ * Parameters:
+ *  -   a, b:       Radius of the rings
+ *  -   height:     Distance between the planes of the rings (the geometric mean distance of the
+ *                  cross section for a ring with itself)
+ */
+static double ringMutual(double a, double b, double height) {
+    double k2 = 4*a*b / ((a+b)*(a+b) + height*height);
+    double k = sqrt(k2);
+    if (k == 0) {
+        return 0;
+    }
+
+    // Complete elliptic integrals of the first (K) and second kind (E)
+    double an = 1, bn = sqrt(1 - k2), sum = k2/2, power = 1;
+    for (int n = 0; n < 32 && an - bn > 1e-15*an; n++) {
+        double c = (an - bn)/2, next = sqrt(an*bn);
+        an = (an + bn)/2;
+        bn = next;
+        power *= 2;
+        sum += power*c*c/2;
+    }
+    double K = M_PI/(2*an), E = K*(1 - sum);
+
+    return 4*M_PI*sqrt(a*b) * ((2/k - k)*K - 2/k*E);
+}
+
+/* coilEstimate
+ * Estimates the radius, length, resistance and inductance of one coil from its parameters alone,
+ * without generating its items. Each turn of a layer is taken as a circular ring, the rings of a
+ * polygon coil have the same area as its turns. The inductance is the sum of the mutual inductances
+ * of all the rings (Maxwell's formula), within a few percent of coilAnalyze for the circular coils.
+ * Used to rank the candidates of a sweep before generating the best ones.
+ *
+ * Parameters:
+ *  -   params:     Parameters of the coil (the count and layout only move the inner radius)
+ *  -   copper:     Thickness of the copper (system units, 0 for no resistance)
+ *  -   board:      Thickness of the board the layers are spread over
+ *  -   estimate:   Returned estimate
+ */
+void coilEstimate(const CoilParams *params, double copper, double board, CoilEstimate *estimate) {
+    int layers = params->layers < 1 ? 1 : params->layers;
+    int sides = params->mode == 1 ? (params->sides < 3 ? 3 : params->sides) : 0;
+    double turns = params->turns, width = params->width, viaSize = params->viaSize;
+    double spacing = params->spacing + width;   // Spacing between each curl (including the width)
+
+    // Start and end of the spiral as coilGenerate lays them out
+    int innerVias = layers > 2 ? ceil((layers-0.5)/2) : 1;
+    double viaGap = layers > 2 ? 2.0/3 : 0.5;
+    double innerRadius = params->count > 1 && params->layout == 0 ? 0 : params->innerRadius;
+    double start = innerRadius + viaSize * innerVias * viaGap;
+    double end = turns * spacing + start;
+
+    // Radius of the corners of a polygon and the outer vias of more than 2 layers
+    double extent = sides > 0 ? end/cos(M_PI/sides) : end;
+    estimate->outerRadius = layers > 2 ? extent + viaSize + 1.0/3 + viaSize/2 : extent;
+    estimate->gap = params->spacing;
+
+    // Perimeter and area of a polygon over the circle of its inner radius
+    double perimeter = sides > 0 ? sides*tan(M_PI/sides)/M_PI : 1;
+    double area = sqrt(perimeter);
+
+    // One ring per turn, the last one as long as the rest of the turns
+    int rings = ceil(turns);
+    double gmd = 0.2235*(width + copper);       // Geometric mean distance of a rectangle
+    double length = 0, self = 0, inductance = 0;
+    for (int i = 0; i < rings; i++) {
+        double wi = i < rings-1 ? 1 : turns - (rings-1);
+        double ri = start + (i + wi/2)*spacing;
+        length += wi * 2*M_PI*ri*perimeter;
+
+        for (int j = 0; j < rings; j++) {
+            double wj = j < rings-1 ? 1 : turns - (rings-1);
+            double rj = start + (j + wj/2)*spacing;
+            self += wi*wj * ringMutual(ri*area, rj*area, i == j ? gmd : 0);
+
+            // Layers further apart, each distance taken by every pair of layers that far apart
+            for (int d = 1; d < layers; d++) {
+                inductance += 2*(layers-d) * wi*wj * ringMutual(ri*area, rj*area, board*d/(layers-1));
+            }
+        }
+    }
+
+    estimate->length = layers*length;
+    estimate->resistance = width > 0 && copper > 0 ? COPPER_RESISTIVITY*estimate->length/(width*copper) : 0;
+    estimate->inductance = (layers*self + inductance) * MU_0_4PI;
+}
+/* --- End of ESTIMATE --- */
+
+/* --- FIELD --- */
+
+/* fieldTile
+ * Adds the flux density of every current element to a tile of points (Biot-Savart law of a
+ * straight filament, over MU_0_4PI). The elements are taken FIELD_LANES at a time, each lane
+ * summing its own elements, and the sums of a block of FIELD_BLOCK elements are added to the
+ * points in double precision.
+ *
+ * Parameters:
+ *  -   elements:   Current elements of the tracks
+ *  -   point:      Points of the tile (y mirrored to point up)
+ *  -   n:          Number of points
+ *  -   sum:        Flux density of each point the elements are added to
+ */
+static void fieldTile(const Elements *elements, const float point[][3], int n, double sum[][3]) {
+    const float *restrict ax = elements->ax, *restrict ay = elements->ay, *restrict az = elements->az;
+    const float *restrict lx = elements->lx, *restrict ly = elements->ly, *restrict lz = elements->lz;
+    const float *restrict core = elements->core, *restrict current = elements->current;
+
+    for (long first = 0; first < elements->count; first += FIELD_BLOCK) {
+        long last = first + FIELD_BLOCK < elements->count ? first + FIELD_BLOCK : elements->count;
+
+        for (int p = 0; p < n; p++) {
+            float px = point[p][0], py = point[p][1], pz = point[p][2];
+            float bx[FIELD_LANES] = {0}, by[FIELD_LANES] = {0}, bz[FIELD_LANES] = {0};
+
+            for (long e = first; e < last; e += FIELD_LANES) {
+                for (int l = 0; l < FIELD_LANES; l++) {
+                    // Vectors from both ends of the element to the point
+                    float r1x = px - ax[e+l], r1y = py - ay[e+l], r1z = pz - az[e+l];
+                    float r2x = r1x - lx[e+l], r2y = r1y - ly[e+l], r2z = r1z - lz[e+l];
+                    float d1 = sqrtf(r1x*r1x + r1y*r1y + r1z*r1z);
+                    float d2 = sqrtf(r2x*r2x + r2y*r2y + r2z*r2z);
+
+                    // B = I (d1 + d2) / (d1 d2 (d1 d2 + r1.r2)) (L x r1), the core keeps it finite on the track
+                    float product = d1*d2;
+                    float denominator = product*(product + r1x*r2x + r1y*r2y + r1z*r2z + core[e+l]);
+                    float factor = current[e+l]*(d1 + d2)/(denominator > FLT_MIN ? denominator : FLT_MIN);
+                    bx[l] += factor*(ly[e+l]*r1z - lz[e+l]*r1y);
+                    by[l] += factor*(lz[e+l]*r1x - lx[e+l]*r1z);
+                    bz[l] += factor*(lx[e+l]*r1y - ly[e+l]*r1x);
+                }
+            }
+
+            for (int l = 0; l < FIELD_LANES; l++) {
+                sum[p][0] += bx[l];
+                sum[p][1] += by[l];
+                sum[p][2] += bz[l];
+            }
+        }
+    }
+}
+
+/* fieldWorker
+ * Thread of the field map: takes the tiles of FIELD_TILE points in order and calculates the
+ * flux density of their points.
+ *
+ * Parameters:
+ *  -   arg:        Field map shared by the threads
+ */
+static void *fieldWorker(void *arg) {
+    FieldJob *job = arg;
+    const CoilGrid *grid = job->grid;
+    float point[FIELD_TILE][3];
+    double sum[FIELD_TILE][3];
+
+    for (;;) {
+        pthread_mutex_lock(&job->lock);
+        long first = job->next;
+        job->next += FIELD_TILE;
+        pthread_mutex_unlock(&job->lock);
+
+        if (first >= job->points) {
+            break;
+        }
+
+        // Points of the tile, x first, then y, then z
+        int n = job->points - first < FIELD_TILE ? job->points - first : FIELD_TILE;
+        for (int p = 0; p < n; p++) {
+            long index = first + p;
+            int i = index % grid->points[0], j = index / grid->points[0] % grid->points[1], k = index / grid->points[0] / grid->points[1];
+            point[p][0] = grid->min[0] + i*grid->step[0];
+            point[p][1] = -(grid->min[1] + j*grid->step[1]);
+            point[p][2] = grid->min[2] + k*grid->step[2];
+            sum[p][0] = sum[p][1] = sum[p][2] = 0;
+        }
+
+        fieldTile(job->elements, (const float (*)[3])point, n, sum);
+
+        // Flux density along the axes of the board (y pointing down again)
+        for (int p = 0; p < n; p++) {
+            job->b[3*(first + p)] = FIELD_UNIT*sum[p][0];
+            job->b[3*(first + p) + 1] = -FIELD_UNIT*sum[p][1];
+            job->b[3*(first + p) + 2] = FIELD_UNIT*sum[p][2];
+        }
+    }
+
+    return NULL;
+}
+
+/* elementAdd
+ * Adds a straight current element to the elements of the field map.
+ *
+ * Parameters:
+ *  -   elements:   Current elements
+ *  -   start:      Start point of the element
+ *  -   end:        End point of the element
+ *  -   height:     Height of the copper layer
+ *  -   current:    Current from the start to the end point (ampere)
+ *  -   width:      Width of the track
+ */
+static void elementAdd(Elements *elements, const double start[2], const double end[2], double height, double current, double width) {
+    long e = elements->count++;
+    elements->ax[e] = start[0];
+    elements->ay[e] = -start[1];
+    elements->az[e] = height;
+    elements->lx[e] = end[0] - start[0];
+    elements->ly[e] = -(end[1] - start[1]);
+    elements->lz[e] = 0;
+    // A core of w/(2 pi) tops the field at the surface field of a thin strip, mu_0 I / 2w
+    elements->core[e] = 2*(width/(2*M_PI))*(width/(2*M_PI));
+    elements->current[e] = current;
+}
+
+/* coilField
+ * Calculates the magnetic flux density of the tracks of the coils on every point of a grid
+ * (Biot-Savart law). The wire segments, arcs (split into straight pieces) and via connections
+ * of every coil carry the current of their coil, turning the same way on every layer like in
+ * coilAnalyze, and the vias are left out. The layers are evenly spaced below the front copper
+ * layer, at 0, through the thickness of the board. The flux density is given along the axes of the
+ * board (y pointing down, z up from the front side), inside the tracks it is reduced by the
+ * width of the track. The points are shared by the threads, every point sums all the elements,
+ * so the time grows with the points times the elements.
+ * Returns 1 when the memory could not be allocated.
+ *
+ * Parameters:
+ *  -   items:      Items of the coils (coilListWrite)
+ *  -   count:      Number of items
+ *  -   layers:     Number of copper layers
+ *  -   board:      Thickness of the board (system units, mm)
+ *  -   currents:   Current of each coil (ampere, a positive current runs inwards on the front layer)
+ *  -   coils:      Number of coils with a current, the items of the other coils are left out
+ *  -   grid:       Points of the field map
+ *  -   threads:    Threads calculating the points
+ *  -   field:      Returned flux density (freed by coilFieldFree)
+ */
+int coilField(const CoilItem *items, size_t count, int layers, double board, const double *currents, int coils, const CoilGrid *grid, int threads, CoilField *field) {
+    double timeBegin = coilNow();
+    layers < 1 ? layers = 1 : layers;
+    threads < 1 ? threads = 1 : threads;
+
+    field->points = (long)grid->points[0] * grid->points[1] * grid->points[2];
+    field->points < 0 ? field->points = 0 : 0;
+    field->b = malloc((field->points ? field->points : 1) * 3 * sizeof(float));
+    field->elements = 0;
+
+    // Elements of the tracks, arcs split into pieces, padded to whole lanes
+    long capacity = 0;
+    for (size_t n = 0; n < count; n++) {
+        const CoilItem *item = &items[n];
+        double center[2], radius, start, sweep;
+        if (item->coil >= 0 && item->coil < coils && item->kind != COIL_VIA) {
+            capacity += item->kind == COIL_ARC && !arcShape(item, center, &radius, &start, &sweep) ? 1 + (long)(fabs(sweep)/ARC_PIECE) : 1;
+        }
+    }
+    capacity = (capacity + FIELD_LANES - 1) / FIELD_LANES * FIELD_LANES;
+
+    Elements elements;
+    float *data = malloc((capacity ? capacity : 1) * 8 * sizeof(float));
+    float **arrays[8] = {&elements.ax, &elements.ay, &elements.az, &elements.lx, &elements.ly, &elements.lz, &elements.core, &elements.current};
+    for (int a = 0; a < 8; a++) {
+        *arrays[a] = data + a*capacity;
+    }
+    elements.count = 0;
+
+    int error = field->b == NULL || data == NULL;
+
+    for (size_t n = 0; n < count && !error; n++) {
+        const CoilItem *item = &items[n];
+        if (item->coil < 0 || item->coil >= coils || item->kind == COIL_VIA || item->layer < 0 || item->layer >= layers) {
+            continue;
+        }
+
+        // Layers are evenly spaced below the front layer, every other layer is run through the other way
+        double height = layers > 1 ? -board*item->layer/(layers-1) : 0;
+        double current = (item->layer % 2 ? 1 : -1) * currents[item->coil];
+        double center[2], radius, start, sweep;
+
+        if (item->kind == COIL_ARC && !arcShape(item, center, &radius, &start, &sweep)) {
+            // Arc split into straight pieces of at most ARC_PIECE
+            int pieces = 1 + (int)(fabs(sweep)/ARC_PIECE);
+            double prev[2] = {item->start[0], item->start[1]}, next[2];
+            for (int p = 1; p <= pieces; p++) {
+                next[0] = p < pieces ? center[0] + radius*cos(start + sweep*p/pieces) : item->end[0];
+                next[1] = p < pieces ? center[1] + radius*sin(start + sweep*p/pieces) : item->end[1];
+                elementAdd(&elements, prev, next, height, current, item->width);
+                prev[0] = next[0];
+                prev[1] = next[1];
+            }
+        } else {
+            elementAdd(&elements, item->start, item->end, height, current, item->width);
+        }
+    }
+    field->elements = elements.count;
+
+    // Elements without current fill the last lanes
+    double none[2] = {0, 0};
+    while (elements.count % FIELD_LANES && !error) {
+        elementAdd(&elements, none, none, 0, 0, 1);
+    }
+
+    // Points of the grid, the tiles shared by the threads
+    FieldJob job = {&elements, grid, field->b, field->points, 0, PTHREAD_MUTEX_INITIALIZER};
+    if (!error) {
+        pthread_t *workers = malloc(threads * sizeof(pthread_t));
+        int started = 0;
+        for (int t = 1; t < threads && workers != NULL && field->points > FIELD_TILE; t++) {
+            pthread_create(&workers[started], NULL, fieldWorker, &job) ? 0 : started++;
+        }
+        fieldWorker(&job);
+        for (int t = 0; t < started; t++) {
+            pthread_join(workers[t], NULL);
+        }
+        free(workers);
+    }
+    field->time = coilNow() - timeBegin;
+
+    free(data);
+    if (error) coilFieldFree(field);
+    return error;
+}
+
+/* coilFieldFree
+ * Frees the flux density of coilField.
+ *
+ * Parameters:
+ *  -   field:      Flux density to free
+ */
+void coilFieldFree(CoilField *field) {
+    free(field->b);
+    field->b = NULL;
+}
+
+/* coilFieldFormat
+ * Writes the field map as CSV: a header line, then the coordinates and the flux density of every
+ * point (microtesla), in the order of the grid.
+ *
+ * Parameters:
+ *  -   out:        Writer of the file
+ *  -   grid:       Points of the field map
+ *  -   field:      Flux density of the points (coilField)
+ */
+void coilFieldFormat(CoilWriter *out, const CoilGrid *grid, const CoilField *field) {
+    coilWriterPrintf(out, "x,y,z,bx_uT,by_uT,bz_uT\n");
+    for (long index = 0; index < field->points; index++) {
+        int i = index % grid->points[0], j = index / grid->points[0] % grid->points[1], k = index / grid->points[0] / grid->points[1];
+        const float *b = &field->b[3*index];
+        coilWriterPrintf(out, "%f,%f,%f,%f,%f,%f\n", grid->min[0] + i*grid->step[0], grid->min[1] + j*grid->step[1], grid->min[2] + k*grid->step[2], (double)b[0], (double)b[1], (double)b[2]);
+    }
+}
+/* --- End of FIELD --- */
+
+/* --- OUTLINE --- */
+
+/* outlinePoint
+ * Adds a point to the outline, leaving out points on top of the last one.
+ * Returns 1 when the outline could not grow.
+ *
+ * Parameters:
+ *  -   outline:    Outline sink with the points of the polygon
+ *  -   x, y:       Point to add
+ */
+static int outlinePoint(CoilOutline *outline, double x, double y) {
+    long n = outline->vertices;
+    if (n > 0 && fabs(outline->polygon[2*n-2] - x) < 1e-9 && fabs(outline->polygon[2*n-1] - y) < 1e-9) {
+        return 0;
+    }
+
+    if (n + 1 > outline->polygonCapacity) {
+        long capacity = outline->polygonCapacity ? 2*outline->polygonCapacity : 1024;
+        double *polygon = realloc(outline->polygon, capacity * 2 * sizeof(double));
+        if (polygon == NULL) {
+            return 1;
+        }
+        outline->polygon = polygon;
+        outline->polygonCapacity = capacity;
+    }
+
+    outline->polygon[2*n] = x;
+    outline->polygon[2*n+1] = y;
+    outline->vertices++;
+    return 0;
+}
+
+/* outlineRound
+ * Adds the points of a round corner or end cap of the outline: an arc of half the width around
+ * a point of the centre line, in pieces deviating at most OUTLINE_TOLERANCE from the circle.
+ *
+ * Parameters:
+ *  -   outline:    Outline sink with the points of the polygon
+ *  -   center:     Point of the centre line
+ *  -   half:       Half the width of the track
+ *  -   from:       Angle of the first point of the arc
+ *  -   sweep:      Angle of the arc (negative turns clockwise)
+ */
+static int outlineRound(CoilOutline *outline, const double center[2], double half, double from, double sweep) {
+    int pieces = arcPieces(half, sweep, OUTLINE_TOLERANCE);
+    int error = 0;
+    for (int p = 0; p <= pieces; p++) {
+        double angle = from + sweep*p/pieces;
+        error |= outlinePoint(outline, center[0] + half*cos(angle), center[1] + half*sin(angle));
+    }
+    return error;
+}
+
+/* outlineSide
+ * Adds the left side of the centre line, walked forward (step 1) or backward (step -1), to the
+ * outline, offset by half the width: each joint of two pieces becomes a round corner on the outer
+ * side of a turn and the crossing of the offset pieces (miter) on the inner side. Small turns take
+ * the miter on both sides, it deviates less than OUTLINE_TOLERANCE from the round corner. Inner
+ * miters further than the neighbouring pieces are long, where the centre line turns tighter than
+ * half the width, are left out, so the outline does not cross itself.
+ * Then the round end cap of the last point is added.
+ *
+ * Parameters:
+ *  -   outline:    Outline sink with the centre line and the points of the polygon
+ *  -   step:       Walking direction of the centre line
+ *  -   half:       Half the width of the track
+ */
+static int outlineSide(CoilOutline *outline, int step, double half) {
+    const double *points = outline->points;
+    long count = outline->count;
+    long first = step > 0 ? 0 : count - 1;
+    double small = half > OUTLINE_TOLERANCE ? 2*acos(1 - OUTLINE_TOLERANCE/half) : M_PI;
+    int error = 0;
+
+    // Direction, length and left normal of the first piece
+    const double *a = &points[2*first], *b = &points[2*(first + step)];
+    double length = hypot(b[0] - a[0], b[1] - a[1]);
+    double d[2] = {(b[0] - a[0])/length, (b[1] - a[1])/length};
+    error |= outlinePoint(outline, a[0] - half*d[1], a[1] + half*d[0]);
+
+    for (long k = 1; k + 1 < count; k++) {
+        const double *p = &points[2*(first + step*k)], *q = &points[2*(first + step*(k+1))];
+        double nextLength = hypot(q[0] - p[0], q[1] - p[1]);
+        double e[2] = {(q[0] - p[0])/nextLength, (q[1] - p[1])/nextLength};
+
+        // Turn of the joint (positive to the left, the left side is inside)
+        double turn = atan2(d[0]*e[1] - d[1]*e[0], d[0]*e[0] + d[1]*e[1]);
+        if (fabs(turn) <= small || turn > 0) {
+            double scale = half / (1 + d[0]*e[0] + d[1]*e[1]);
+            double along = half*tan(fabs(turn)/2);
+            along <= length && along <= nextLength ? error |= outlinePoint(outline, p[0] - scale*(d[1] + e[1]), p[1] + scale*(d[0] + e[0])) : 0;
+        } else {
+            error |= outlineRound(outline, p, half, atan2(d[0], -d[1]), turn);
+        }
+
+        d[0] = e[0];
+        d[1] = e[1];
+        length = nextLength;
+    }
+
+    // Round end cap around the last point, from the left to the right side
+    const double *last = &points[2*(first + step*(count-1))];
+    error |= outlineRound(outline, last, half, atan2(d[0], -d[1]), -M_PI);
+    return error;
+}
+
+/* outlineCollect
+ * Adds the centre line of the tracks of a unit to the centre line of its layer: the start of the
+ * first track and the end of every track, arcs split into pieces deviating at most
+ * OUTLINE_TOLERANCE from the arc.
+ * Returns 1 when the centre line could not grow.
+ *
+ * Parameters:
+ *  -   outline:    Outline sink with the centre line of the layer
+ *  -   unit:       Items of the unit
+ */
+static int outlineCollect(CoilOutline *outline, const CoilUnit *unit) {
+    for (int n = 0; n < unit->count; n++) {
+        const CoilItem *item = &unit->items[n];
+        double center[2], radius, start, sweep;
+        int arc = item->kind == COIL_ARC && !arcShape(item, center, &radius, &start, &sweep);
+        int pieces = arc ? arcPieces(radius + item->width/2, sweep, OUTLINE_TOLERANCE) : 1;
+
+        // Room for the points of the item
+        if (outline->count + pieces + 1 > outline->capacity) {
+            long capacity = outline->capacity ? 2*outline->capacity : 4096;
+            while (capacity < outline->count + pieces + 1) {
+                capacity *= 2;
+            }
+            double *points = realloc(outline->points, capacity * 2 * sizeof(double));
+            if (points == NULL) {
+                return 1;
+            }
+            outline->points = points;
+            outline->capacity = capacity;
+        }
+
+        double *out = outline->points;
+        long c = outline->count;
+        if (c == 0 || fabs(out[2*c-2] - item->start[0]) > 1e-9 || fabs(out[2*c-1] - item->start[1]) > 1e-9) {
+            out[2*c] = item->start[0];
+            out[2*c+1] = item->start[1];
+            c++;
+        }
+        for (int p = 1; p < pieces; p++) {
+            out[2*c] = center[0] + radius*cos(start + sweep*p/pieces);
+            out[2*c+1] = center[1] + radius*sin(start + sweep*p/pieces);
+            c++;
+        }
+        if (fabs(out[2*c-2] - item->end[0]) > 1e-9 || fabs(out[2*c-1] - item->end[1]) > 1e-9) {
+            out[2*c] = item->end[0];
+            out[2*c+1] = item->end[1];
+            c++;
+        }
+        outline->count = c;
+        outline->width = item->width;
+    }
+
+    return 0;
+}
+
+/* outlineFormat
+ * Writes the outline of the collected centre line as the KiCAD record of a filled copper polygon
+ * on the layer, in the net of the coils: the left side forward, the round cap of the end, the
+ * right side backward and the round cap of the start.
+ * Returns 1 when the outline could not be allocated.
+ *
+ * Parameters:
+ *  -   outline:    Outline sink with the centre line of the layer
+ *  -   coil:       Index of the coil
+ *  -   layer:      Index of the copper layer
+ */
+static int outlineFormat(CoilOutline *outline, int coil, int layer) {
+    const CoilParams *params = outline->params;
+    CoilWriter *out = &outline->text;
+    char layerName[16], uuid[40];
+    outline->vertices = 0;
+
+    if (outline->count < 2) {
+        return 0;
+    }
+
+    double half = outline->width/2;
+    int error = outlineSide(outline, 1, half) || outlineSide(outline, -1, half);
+    long vertices = outline->vertices;
+    vertices > 1 && fabs(outline->polygon[0] - outline->polygon[2*vertices-2]) < 1e-9 && fabs(outline->polygon[1] - outline->polygon[2*vertices-1]) < 1e-9 ? vertices-- : 0;
+
+    coilWriterPrintf(out, "(gr_poly\n  (pts");
+    for (long n = 0; n < vertices && !error; n++) {
+        coilWriterPrintf(out, n % 4 ? " (xy %f %f)" : "\n    (xy %f %f)", outline->polygon[2*n], outline->polygon[2*n+1]);
+    }
+    coilWriterPrintf(out, "\n  ) (width 0) (fill solid) (layer \"%s\") (net %d) (uuid %s))\n", copperLayer(layerName, layer, params->layers), params->netID, coilUuid(uuid, coilTagHash(params->tag), coil, layer, 4, 0));
+
+    outline->polygons++;
+    outline->total += vertices;
+    return error || out->error;
+}
+
+/* coilOutlineFormat
+ * Formatter of the outline sink: the vias and via connections are formatted by the formatter of
+ * the sink of the caller, the tracks of the layers are left to coilOutlineWrite.
+ */
+void coilOutlineFormat(void *context, const CoilParams *params, const CoilUnit *unit, CoilWriter *out) {
+    CoilOutline *outline = context;
+    if (unit->layer < 0 && outline->sink->format != NULL) outline->sink->format(outline->sink->context, params, unit, out);
+}
+
+/* coilOutlineWrite
+ * Sink writing each layer of a coil as a single copper polygon instead of its tracks: the centre
+ * line of the layer is collected from its units, and the last unit of the layer is handed on to the
+ * sink of the caller with the record of the polygon (outlineFormat) as its text. The other units
+ * of the layer are handed on without text, the vias and via connections with their records.
+ * The polygon follows the tracks at half their width with round corners and end caps, so it covers
+ * the same copper as the tracks. Returns 1 when the polygon could not be written (the error of
+ * its text is set), otherwise the result of the sink of the caller.
+ *
+ * Parameters:
+ *  -   context:    Outline sink (CoilOutline)
+ *  -   unit:       Items of the unit
+ */
+int coilOutlineWrite(void *context, const CoilUnit *unit) {
+    CoilOutline *outline = context;
+    CoilUnit view = *unit;
+    int error = 0;
+
+    if (unit->layer >= 0) {
+        unit->chunk == 0 ? outline->count = 0 : 0;
+        error = outlineCollect(outline, unit);
+
+        // The whole layer is collected, write its polygon
+        if (!error && unit->chunk == unit->chunks - 1) {
+            if (outline->text.buffer == NULL) {
+                outline->text.buffer = malloc(16*WRITER_RECORD);
+                outline->text.size = 16*WRITER_RECORD;
+            }
+            outline->text.length = 0;
+            outline->text.digits = outline->params->precision;
+            outline->text.trim = outline->params->trimZeros;
+            error = outline->text.buffer == NULL || outlineFormat(outline, unit->coil, unit->layer);
+            view.text = &outline->text;
+        }
+    }
+
+    error ? outline->text.error = 1 : 0;
+    return error ? 1 : outline->sink->write(outline->sink->context, &view);
+}
+
+/* coilOutlineFree
+ * Frees the centre line, the polygon and the records of the outline sink.
+ *
+ * Parameters:
+ *  -   outline:    Outline sink to free
+ */
+void coilOutlineFree(CoilOutline *outline) {
+    free(outline->points);
+    free(outline->polygon);
+    free(outline->text.buffer);
+    outline->points = outline->polygon = NULL;
+    outline->text.buffer = NULL;
+}
+/* --- End of OUTLINE --- */
+
+/* --- FORMATS --- */
+
+/* coilFootprintBegin
+ * Writes the start of a self-contained KiCAD footprint (.kicad_mod) named after the tag.
+ *
+ * Parameters:
+ *  -   out:        Writer of the footprint
+ *  -   params:     Parameters of the coils (tag)
+ */
+void coilFootprintBegin(CoilWriter *out, const CoilParams *params) {
+    coilWriterPrintf(out, "(footprint \"%s\" (version 20221018) (generator coil) (layer \"F.Cu\")\n", params->tag);
+    coilWriterPrintf(out, "  (descr \"Coil of %d layers generated by coil\")\n", params->layers);
+    coilWriterPrintf(out, "  (fp_text reference \"REF**\" (at 0 0) (layer \"F.SilkS\") hide (effects (font (size 1 1) (thickness 0.15))))\n");
+    coilWriterPrintf(out, "  (fp_text value \"%s\" (at 0 0) (layer \"F.Fab\") hide (effects (font (size 1 1) (thickness 0.15))))\n", params->tag);
+}
+
+/* coilFootprintFormat
+ * Sink formatter writing the items as the graphics and pads of a KiCAD footprint: the tracks as
+ * copper lines and arcs, the vias as unnamed through hole pads and a pad at each terminal of a
+ * coil, numbered 1 and 2 for the first coil, 3 and 4 for the second and so on. The first terminal is
+ * the outer end of the first layer, the second one is on the last layer: its outer end with an even
+ * number of layers, its inner end with an odd number.
+ *
+ * Parameters:
+ *  -   context:    Context of the output (not used)
+ *  -   params:     Parameters of the coils (layers)
+ *  -   unit:       Items of the unit
+ *  -   out:        Writer of the footprint
+ */
+void coilFootprintFormat(void *context, const CoilParams *params, const CoilUnit *unit, CoilWriter *out) {
+    int layers = params->layers < 1 ? 1 : params->layers;
+    char layerName[16];
+    (void)context;
+
+    for (int n = 0; n < unit->count; n++) {
+        const CoilItem *item = &unit->items[n];
+        copperLayer(layerName, item->layer, layers);
+
+        if (item->kind == COIL_ARC) {
+            coilWriterPrintf(out, "  (fp_arc (start %f %f) (mid %f %f) (end %f %f) (stroke (width %f) (type solid)) (layer \"%s\"))\n", item->start[0], item->start[1], item->mid[0], item->mid[1], item->end[0], item->end[1], item->width, layerName);
+        } else if (item->kind == COIL_VIA) {
+            coilWriterPrintf(out, "  (pad \"\" thru_hole circle (at %f %f) (size %.1f %.1f) (drill 0.4) (layers \"*.Cu\"))\n", item->start[0], item->start[1], item->width, item->width);
+        } else {
+            coilWriterPrintf(out, "  (fp_line (start %f %f) (end %f %f) (stroke (width %f) (type solid)) (layer \"%s\"))\n", item->start[0], item->start[1], item->end[0], item->end[1], item->width, layerName);
+        }
+    }
+
+    // Terminals at the ends of the first and the last layer
+    if (unit->layer >= 0 && unit->count > 0) {
+        const CoilItem *first = &unit->items[0], *last = &unit->items[unit->count-1];
+        copperLayer(layerName, unit->layer, layers);
+        if (unit->layer == 0 && unit->chunk == unit->chunks-1) {
+            coilWriterPrintf(out, "  (pad \"%d\" smd circle (at %f %f) (size %f %f) (layers \"%s\"))\n", 2*unit->coil + 1, last->end[0], last->end[1], last->width, last->width, layerName);
+        }
+        if (unit->layer == layers-1 && layers % 2 == 1 && unit->chunk == 0) {
+            coilWriterPrintf(out, "  (pad \"%d\" smd circle (at %f %f) (size %f %f) (layers \"%s\"))\n", 2*unit->coil + 2, first->start[0], first->start[1], first->width, first->width, layerName);
+        } else if (unit->layer == layers-1 && layers % 2 == 0 && unit->chunk == unit->chunks-1) {
+            coilWriterPrintf(out, "  (pad \"%d\" smd circle (at %f %f) (size %f %f) (layers \"%s\"))\n", 2*unit->coil + 2, last->end[0], last->end[1], last->width, last->width, layerName);
+        }
+    }
+}
+
+/* coilFootprintEnd
+ * Writes the end of the footprint.
+ *
+ * Parameters:
+ *  -   out:        Writer of the footprint
+ */
+void coilFootprintEnd(CoilWriter *out) {
+    coilWriterPrintf(out, ")\n");
+}
+
+/* coilSvgBegin
+ * Writes the start of an SVG preview of the coils, one color per copper layer. The size of the
+ * drawing is only known at the end, so room is left for it and filled in by coilSvgEnd.
+ *
+ * Parameters:
+ *  -   out:        Writer of the preview
+ *  -   params:     Parameters of the coils (layers)
+ *  -   bounds:     Returned empty bounds, grown by coilSvgFormat
+ */
+void coilSvgBegin(CoilWriter *out, const CoilParams *params, CoilBounds *bounds) {
+    const char *colors[4] = {"#c2c200", "#c200c2", "#00c2c2", "#c28000"};     // Inner layers
+    int layers = params->layers < 1 ? 1 : params->layers;
+
+    bounds->min[0] = bounds->min[1] = INFINITY;
+    bounds->max[0] = bounds->max[1] = -INFINITY;
+
+    // Room for the size of the drawing
+    char room[SVG_ROOM + 1];
+    memset(room, ' ', SVG_ROOM);
+    room[SVG_ROOM] = '\0';
+
+    coilWriterPrintf(out, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<svg xmlns=\"http://www.w3.org/2000/svg\" ");
+    bounds->position = out->written + out->length;
+    coilWriterPrintf(out, "%s>\n", room);
+    coilWriterPrintf(out, "<style>line,path{fill:none;stroke-linecap:round;stroke-opacity:0.8}circle{fill:#c8c8c8;fill-opacity:0.8}");
+    for (int i = 0; i < layers; i++) {
+        coilWriterPrintf(out, ".l%d{stroke:%s}", i, i == 0 ? "#c83434" : (i == layers-1 ? "#4d7fc4" : colors[(i-1) % 4]));
+    }
+    coilWriterPrintf(out, "</style>\n");
+}
+
+/* svgGrow
+ * Grows the bounds of the preview by a point and the width around it.
+ */
+static void svgGrow(CoilBounds *bounds, const double point[2], double width) {
+    for (int a = 0; a < 2; a++) {
+        bounds->min[a] = fmin(bounds->min[a], point[a] - width/2);
+        bounds->max[a] = fmax(bounds->max[a], point[a] + width/2);
+    }
+}
+
+/* coilSvgFormat
+ * Sink formatter writing the items as SVG elements: the tracks as lines and arcs with the width of
+ * the copper, the vias as circles. The coordinates are the ones of the board (y down).
+ *
+ * Parameters:
+ *  -   context:    Bounds of the preview (CoilBounds of coilSvgBegin)
+ *  -   params:     Parameters of the coils (not used)
+ *  -   unit:       Items of the unit
+ *  -   out:        Writer of the preview
+ */
+void coilSvgFormat(void *context, const CoilParams *params, const CoilUnit *unit, CoilWriter *out) {
+    CoilBounds *bounds = context;
+    (void)params;
+
+    for (int n = 0; n < unit->count; n++) {
+        const CoilItem *item = &unit->items[n];
+        double center[2], radius, start, sweep;
+
+        if (item->kind == COIL_VIA) {
+            coilWriterPrintf(out, "<circle cx=\"%f\" cy=\"%f\" r=\"%f\"/>\n", item->start[0], item->start[1], item->width/2);
+            svgGrow(bounds, item->start, item->width);
+            continue;
+        }
+
+        if (item->kind == COIL_ARC && !arcShape(item, center, &radius, &start, &sweep)) {
+            coilWriterPrintf(out, "<path d=\"M%f %fA%f %f 0 %d %d %f %f\" stroke-width=\"%f\" class=\"l%d\"/>\n", item->start[0], item->start[1], radius, radius, fabs(sweep) > M_PI, sweep > 0, item->end[0], item->end[1], item->width, item->layer);
+            svgGrow(bounds, item->mid, item->width);
+        } else {
+            coilWriterPrintf(out, "<line x1=\"%f\" y1=\"%f\" x2=\"%f\" y2=\"%f\" stroke-width=\"%f\" class=\"l%d\"/>\n", item->start[0], item->start[1], item->end[0], item->end[1], item->width, item->layer);
+        }
+        svgGrow(bounds, item->start, item->width);
+        svgGrow(bounds, item->end, item->width);
+    }
+}
+
+/* coilSvgEnd
+ * Writes the end of the preview and fills in its size from the bounds of the items, with a margin.
+ * The size is written into the output buffer, or into the file when the buffer was flushed already.
+ *
+ * Parameters:
+ *  -   out:        Writer of the preview
+ *  -   bounds:     Bounds of the items (coilSvgFormat)
+ */
+void coilSvgEnd(CoilWriter *out, const CoilBounds *bounds) {
+    coilWriterPrintf(out, "</svg>\n");
+
+    // Drawing without items
+    double min[2] = {0, 0}, size[2] = {1, 1};
+    if (bounds->min[0] <= bounds->max[0]) {
+        double margin = fmax(bounds->max[0] - bounds->min[0], bounds->max[1] - bounds->min[1])/20;
+        for (int a = 0; a < 2; a++) {
+            min[a] = bounds->min[a] - margin;
+            size[a] = bounds->max[a] - bounds->min[a] + 2*margin;
+        }
+    }
+
+    // Size in the units of the board (mm), padded to the room left for it
+    char text[2*SVG_ROOM], *end = text;
+    const double values[6] = {min[0], min[1], size[0], size[1], size[0], size[1]};
+    const char *names[6] = {"viewBox=\"", " ", " ", " ", "\" width=\"", "mm\" height=\""};
+    for (int v = 0; v < 6; v++) {
+        end += strlen(strcpy(end, names[v]));
+        end = fixedFormat(end, values[v], out->digits, 1);
+    }
+    strcpy(end, "mm\"");
+    size_t length = strlen(text);
+    length < SVG_ROOM ? memset(text + length, ' ', SVG_ROOM - length) : 0;
+
+    if (bounds->position >= out->written) {
+        memcpy(out->buffer + (bounds->position - out->written), text, SVG_ROOM);
+    } else if (out->fp != NULL) {
+        coilWriterFlush(out);
+        long here = ftell(out->fp);
+        int error = fseek(out->fp, bounds->position, SEEK_SET) || fwrite(text, 1, SVG_ROOM, out->fp) != SVG_ROOM || fseek(out->fp, here, SEEK_SET);
+        error ? out->error = 1 : 0;
+    }
+}
+
+/* dxfLayer
+ * Returns the DXF layer of an item: the KiCAD name of its copper layer, Vias for the vias.
+ */
+static char *dxfLayer(char *name, const CoilItem *item, int layers) {
+    return item->kind == COIL_VIA ? strcpy(name, "Vias") : copperLayer(name, item->layer, layers);
+}
+
+/* coilDxfBegin
+ * Writes the start of a DXF drawing (AutoCAD R12, millimeters).
+ *
+ * Parameters:
+ *  -   out:        Writer of the drawing
+ */
+void coilDxfBegin(CoilWriter *out) {
+    coilWriterPrintf(out, "0\nSECTION\n2\nHEADER\n9\n$ACADVER\n1\nAC1009\n9\n$INSUNITS\n70\n4\n0\nENDSEC\n");
+    coilWriterPrintf(out, "0\nSECTION\n2\nENTITIES\n");
+}
+
+/* coilDxfFormat
+ * Sink formatter writing the items as DXF entities on layers named after the copper layers: the
+ * connected tracks of a unit as one polyline with the width of the copper (arcs as bulges) and
+ * the vias as circles. The y axis points up in DXF, so the coordinates are mirrored.
+ *
+ * Parameters:
+ *  -   context:    Context of the output (not used)
+ *  -   params:     Parameters of the coils (layers)
+ *  -   unit:       Items of the unit
+ *  -   out:        Writer of the drawing
+ */
+void coilDxfFormat(void *context, const CoilParams *params, const CoilUnit *unit, CoilWriter *out) {
+    int layers = params->layers < 1 ? 1 : params->layers;
+    char layerName[16];
+    (void)context;
+
+    for (int n = 0; n < unit->count; n++) {
+        const CoilItem *item = &unit->items[n];
+        dxfLayer(layerName, item, layers);
+
+        if (item->kind == COIL_VIA) {
+            coilWriterPrintf(out, "0\nCIRCLE\n8\n%s\n10\n%f\n20\n%f\n40\n%f\n", layerName, item->start[0], -item->start[1], item->width/2);
+            continue;
+        }
+
+        // Start a polyline unless the item goes on from the one before
+        const CoilItem *prev = n > 0 ? &unit->items[n-1] : NULL;
+        if (prev == NULL || prev->kind == COIL_VIA || prev->layer != item->layer || prev->width != item->width || prev->end[0] != item->start[0] || prev->end[1] != item->start[1]) {
+            coilWriterPrintf(out, "0\nPOLYLINE\n8\n%s\n66\n1\n10\n0\n20\n0\n40\n%f\n41\n%f\n", layerName, item->width, item->width);
+        }
+
+        // The bulge of an arc turns the other way in the mirrored coordinates
+        double center[2], radius, start, sweep = 0;
+        item->kind == COIL_ARC ? arcShape(item, center, &radius, &start, &sweep) : 0;
+        coilWriterPrintf(out, "0\nVERTEX\n8\n%s\n10\n%f\n20\n%f\n42\n%f\n", layerName, item->start[0], -item->start[1], -tan(sweep/4));
+
+        // End the polyline unless the next item goes on from this one
+        const CoilItem *next = n+1 < unit->count ? &unit->items[n+1] : NULL;
+        if (next == NULL || next->kind == COIL_VIA || next->layer != item->layer || next->width != item->width || next->start[0] != item->end[0] || next->start[1] != item->end[1]) {
+            coilWriterPrintf(out, "0\nVERTEX\n8\n%s\n10\n%f\n20\n%f\n0\nSEQEND\n8\n%s\n", layerName, item->end[0], -item->end[1], layerName);
+        }
+    }
+}
+
+/* coilDxfEnd
+ * Writes the end of the drawing.
+ *
+ * Parameters:
+ *  -   out:        Writer of the drawing
+ */
+void coilDxfEnd(CoilWriter *out) {
+    coilWriterPrintf(out, "0\nENDSEC\n0\nEOF\n");
+}
+/* --- End of FORMATS --- */
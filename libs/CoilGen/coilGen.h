@@ -0,0 +1,323 @@
+/* coilGen.h
+ *
+ * Description:
+ * Coil generator library used by coil.c. The coils are described by a parameter struct (CoilParams)
+ * and generated into a caller supplied sink (CoilSink): the wire segments, arcs, vias and via
+ * connections are handed over as geometry (CoilItem) in the order of the footprint file, so other
+ * programs can generate coils in-process without writing and parsing a file. The KiCAD footprint
+ * records are only one formatter of the sink (coilKicadFormat).
+ *
+ * Usage:
+ *  -   coilDefaults:   Fills the parameters with the defaults of coil.c
+ *  -   coilGenerate:   Generates the coils into the sink
+ *  -   coilListWrite:  Sink collecting all the items into a list (CoilList)
+ *  -   coilKicadFormat: Sink formatter writing the KiCAD footprint records
+ *  -   coilFanoutWrite: Sink handing the items to several formats in a single generation
+ *  -   coilOutlineWrite: Sink writing each layer of a coil as one copper polygon instead of its tracks
+ *  -   coilFootprintFormat, coilSvgFormat, coilDxfFormat: Sink formatters of a .kicad_mod footprint
+ *                      with pads at the terminals, an SVG preview and a DXF drawing
+ *  -   coilCacheGenerate: Generates the coils through a cache directory of generated geometry
+ *  -   coilAnalyze:    Calculates the length, resistance and inductance of a generated coil
+ *  -   coilClearance:  Checks the clearance between the tracks and vias of generated coils
+ *  -   coilEstimate:   Estimates the radius, length, resistance and inductance without generating the coil
+ *  -   coilField:      Calculates the magnetic field of generated coils on a grid of points (Biot-Savart)
+ */
+
+#ifndef COILGEN_H
+#define COILGEN_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+/* --- DEFINITIONS --- */
+#define COIL_SEGMENT 0      // Straight wire segment of a layer
+#define COIL_ARC 1          // Arc of a layer (arcTolerance)
+#define COIL_VIA 2          // Via connecting the layers
+#define COIL_LINK 3         // Wire segment connecting the end of an inner layer to an outer via
+
+/* CoilParams
+ * Parameters of the coils (see coilDefaults for the defaults).
+ */
+typedef struct {
+    int mode;               // Coil mode (0 circular, 1 rectangular or polygon)
+    int sides;              // Sides of the polygon coils (mode 1, 4 for rectangular)
+    double chamfer;         // Length of the sides cut off at each corner (mode 1, 0 sharp corners)
+    double fillet;          // Radius of the rounded corners (mode 1, 0 sharp corners)
+    int count;              // Number of coils
+    double turns;           // Amount of turns around the center
+    double innerRadius;     // Inner radius of the spiral (motor radius of a circle of coils)
+    double spacing;         // Spacing between each curl (without the width)
+    double startX, startY;  // Center of the coil (start of the linear and grid layouts)
+    int layers;             // Amount of copper layers
+    int direction;          // Direction of rotation (1 CounterClockWise, -1 ClockWise)
+    double rotate;          // Rotation in radians (counterclockwise)
+    double width;           // Width of the copper trace
+    int netID;              // netID of the kicad_pcb file
+    double viaSize;         // Via size
+    double resolution;      // Resolution of the uniform steps (lower is better, but slower)
+    double tolerance;       // Maximum deviation of the wire segments from the spiral (0 uniform steps)
+    double arcTolerance;    // Maximum deviation of the arcs from the spiral (0 wire segments)
+    int precision;          // Decimal digits of the coordinates (text formatters)
+    int trimZeros;          // Remove the trailing zeros of the coordinates (1) or not (0)
+    int nanometers;         // Calculate in double and snap the coordinates to whole nanometers (1) or not (0)
+    int outline;            // Write each layer of a coil as one copper polygon (1, coilOutlineWrite) or its tracks (0)
+    int threads;            // Threads generating the layers
+    const char *tag;        // Tag of the generated items (start of their uuids)
+    int layout;             // Layout of the coils (0 circle, 1 linear, 2 grid)
+    int columns;            // Columns of the grid layout (0 square grid)
+    double pitchX, pitchY;  // Distance between the columns and rows (0 coils next to each other)
+    int alternate;          // Every other coil turns the other way (1) or not (0)
+} CoilParams;
+
+/* CoilItem
+ * A single generated item. Vias only use the start point, the middle point is only used by arcs.
+ */
+typedef struct {
+    int kind;               // COIL_SEGMENT, COIL_ARC, COIL_VIA or COIL_LINK
+    int coil;               // Index of the coil
+    int layer;              // Index of the copper layer (0 for vias)
+    long index;             // Index of the item within its coil, layer and kind (uuid)
+    double start[2];        // Start point (center of a via)
+    double mid[2];          // Middle point of an arc
+    double end[2];          // End point
+    double width;           // Width of the track (size of a via)
+} CoilItem;
+
+/* CoilWriter
+ * Output buffer of a text formatter. The records are formatted straight into the buffer
+ * by coilWriterPrintf and the buffer is written into the file in large blocks.
+ */
+typedef struct {
+    FILE *fp;               // File the buffer is flushed into (NULL keeps everything in memory)
+    char *buffer;           // Reusable output buffer
+    size_t size;            // Size of the buffer
+    size_t length;          // Number of bytes in the buffer
+    size_t written;         // Number of bytes written into the file
+    int digits;             // Decimal digits of the coordinates
+    int trim;               // Remove the trailing zeros of the coordinates (1) or not (0)
+    int error;              // Set when the file could not be written
+    double time;            // Time spent writing into the file (seconds)
+} CoilWriter;
+
+/* CoilUnit
+ * Items of a work unit handed to the sink: a chunk of one layer of a coil, or the vias of a coil.
+ */
+typedef struct {
+    int coil;               // Index of the coil
+    int layer;              // Index of the copper layer (-1 for the vias and via connections)
+    int chunk, chunks;      // Chunk of the layer and number of chunks of the layer
+    long first;             // Index of the first item of the unit in the layer
+    const CoilItem *items;  // Items of the unit
+    int count;              // Number of items
+    const CoilWriter *text; // Items formatted by the sink (NULL without a formatter)
+} CoilUnit;
+
+/* CoilSink
+ * Receiver of the generated items. The units are written in the order of the footprint file,
+ * independent of the number of threads. The optional formatter turns the items of a unit into
+ * text on the generating threads, so it may run on several units at the same time.
+ */
+typedef struct {
+    void *context;          // Passed to the callbacks
+    void (*format)(void *context, const CoilParams *params, const CoilUnit *unit, CoilWriter *out);
+    int (*write)(void *context, const CoilUnit *unit);     // Nonzero stops the generation
+} CoilSink;
+
+/* CoilOutput
+ * One more format of the items (coilFanoutWrite): its formatter and the writer of its file.
+ */
+typedef struct {
+    void (*format)(void *context, const CoilParams *params, const CoilUnit *unit, CoilWriter *out);
+    void *context;          // Passed to the formatter
+    CoilWriter *writer;     // Output buffer of the file of the format
+} CoilOutput;
+
+/* CoilFanout
+ * Context of the fan-out sink (coilFanoutWrite): every unit is formatted into each output and
+ * handed on to the sink of the caller, so several formats come out of a single generation.
+ */
+typedef struct {
+    const CoilParams *params;   // Parameters of the coils, passed to the formatters
+    const CoilSink *sink;   // Sink of the caller (NULL for none)
+    CoilOutput *outputs;    // Outputs of the other formats
+    int count;              // Number of outputs
+} CoilFanout;
+
+/* CoilOutline
+ * Context of the outline sink (coilOutlineWrite): the centre line of each layer of a coil is
+ * collected from its units and written as a single copper polygon around the tracks, freed by
+ * coilOutlineFree. Start it with the parameters and the sink of the caller, everything else 0.
+ */
+typedef struct {
+    const CoilParams *params;   // Parameters of the coils (layers, netID, tag and the digits)
+    const CoilSink *sink;   // Sink of the caller, gets the units with the records of the polygons
+    double *points;         // Centre line of the layer collected so far (x, y)
+    long count, capacity;   // Points of the centre line and points allocated
+    double width;           // Width of the tracks of the layer
+    double *polygon;        // Outline of the layer (x, y)
+    long vertices, polygonCapacity;     // Points of the outline and points allocated
+    CoilWriter text;        // Record of the polygon (in memory)
+    int polygons;           // Number of polygons written
+    long total;             // Points of all the polygons written
+} CoilOutline;
+
+/* CoilBounds
+ * Bounds of the items of an SVG preview (coilSvgFormat), its size is written at the end (coilSvgEnd).
+ */
+typedef struct {
+    double min[2], max[2];  // Smallest and largest coordinates of the copper
+    size_t position;        // Position of the size in the file
+} CoilBounds;
+
+/* CoilStats
+ * Counters of a generation, freed by coilStatsFree.
+ */
+typedef struct {
+    int segments, arcs, vias;       // Number of items generated
+    long *layerPoints;      // Points of each copper layer (all coils)
+    long *layerSegments;    // Wire segments of each copper layer (all coils)
+    long *layerArcs;        // Arcs of each copper layer (all coils)
+    long *tracks;           // Tracks of each coil and layer (count x layers)
+    int *coilVias;          // Vias of each coil
+    int *coilLinks;         // Via connections of each coil
+    double deviation;       // Largest deviation from the spiral
+    double outerRadius;     // Total radius of the coil
+    double motorRadius;     // Total radius of the motor
+    double timeGenerate;    // Time spent generating the layers (seconds, without the sink)
+    double timeVias;        // Time spent laying out the vias (seconds, without the sink)
+    int cached;             // Items read from the cache (1) or generated (0)
+} CoilStats;
+
+/* CoilBuffers
+ * Work units of the generator. Kept between generations to allocate them only once.
+ */
+typedef struct {
+    void *units;            // Work units with their items and text
+    int window;             // Number of work units allocated
+} CoilBuffers;
+
+/* CoilList
+ * Items collected by coilListWrite, freed by the caller.
+ */
+typedef struct {
+    CoilItem *items;        // Items in the order of the footprint file
+    size_t count;           // Number of items
+    size_t capacity;        // Number of items allocated
+} CoilList;
+
+/* CoilAnalysis
+ * Length, DC resistance and inductance of one coil (coilAnalyze), freed by coilAnalysisFree.
+ */
+typedef struct {
+    int layers;             // Number of copper layers
+    double *length;         // Length of the tracks of each layer (system units)
+    double *resistance;     // DC resistance of each layer (ohm)
+    double *inductance;     // Self (diagonal) and mutual inductances of the layers (layers x layers, henry)
+    double totalLength;     // Length of the tracks of the coil
+    double totalResistance; // DC resistance of the layers in series
+    double totalInductance; // Inductance of the layers in series
+    int filaments;          // Straight pieces of the tracks
+    int clusters;           // Groups of pieces taken together in the far field
+    double time;            // Time of the analysis (seconds)
+} CoilAnalysis;
+
+/* CoilViolation
+ * Copper of two items closer than the clearance (coilClearance).
+ */
+typedef struct {
+    double at[2];           // Middle of the closest points of the items
+    double clearance;       // Clearance between the items (negative when they overlap)
+    int layer;              // Index of the copper layer (-1 between two vias)
+    int kind[2];            // Kind of the items
+    int coil[2];            // Index of the coils of the items
+} CoilViolation;
+
+/* CoilClearance
+ * Results of the clearance check (coilClearance), freed by coilClearanceFree.
+ */
+typedef struct {
+    long violations;        // Number of pairs of items closer than the clearance
+    double smallest;        // Smallest clearance of the violations (infinity without violations)
+    CoilViolation *list;    // Violations with the smallest clearances, in order
+    int listed;             // Number of violations in the list
+    long pairs;             // Pairs of items compared
+    int shapes;             // Straight pieces of the tracks and vias
+    double time;            // Time of the check (seconds)
+} CoilClearance;
+
+/* CoilEstimate
+ * Radius, length, resistance and inductance of one coil estimated from its parameters (coilEstimate).
+ */
+typedef struct {
+    double outerRadius;     // Total radius of the coil around its center
+    double gap;             // Copper gap between the turns of a layer
+    double length;          // Length of the tracks of the coil
+    double resistance;      // DC resistance of the layers in series (ohm)
+    double inductance;      // Inductance of the layers in series (henry)
+} CoilEstimate;
+
+/* CoilGrid
+ * Regular grid of the points of a field map (coilField), x first, then y, then z.
+ */
+typedef struct {
+    double min[3];          // First point (x and y of the board, z the height above the front copper layer)
+    double step[3];         // Distance between the points along each axis
+    int points[3];          // Number of points along each axis
+} CoilGrid;
+
+/* CoilField
+ * Magnetic flux density of the coils on the points of a grid (coilField), freed by coilFieldFree.
+ */
+typedef struct {
+    long points;            // Number of points of the grid
+    float *b;               // Flux density at each point (x, y and z along the axes of the board, microtesla)
+    long elements;          // Straight current elements of the tracks
+    double time;            // Time of the calculation (seconds)
+} CoilField;
+/* --- End of DEFINITIONS --- */
+
+/* --- FUNCTIONS --- */
+void coilDefaults(CoilParams *params);
+int coilGenerate(const CoilParams *params, const CoilSink *sink, CoilBuffers *buffers, CoilStats *stats);
+void coilStatsFree(CoilStats *stats);
+void coilBuffersFree(CoilBuffers *buffers);
+int coilListWrite(void *context, const CoilUnit *unit);
+void coilKicadFormat(void *context, const CoilParams *params, const CoilUnit *unit, CoilWriter *out);
+void coilFanoutFormat(void *context, const CoilParams *params, const CoilUnit *unit, CoilWriter *out);
+int coilFanoutWrite(void *context, const CoilUnit *unit);
+void coilOutlineFormat(void *context, const CoilParams *params, const CoilUnit *unit, CoilWriter *out);
+int coilOutlineWrite(void *context, const CoilUnit *unit);
+void coilOutlineFree(CoilOutline *outline);
+
+void coilFootprintBegin(CoilWriter *out, const CoilParams *params);
+void coilFootprintFormat(void *context, const CoilParams *params, const CoilUnit *unit, CoilWriter *out);
+void coilFootprintEnd(CoilWriter *out);
+void coilSvgBegin(CoilWriter *out, const CoilParams *params, CoilBounds *bounds);
+void coilSvgFormat(void *context, const CoilParams *params, const CoilUnit *unit, CoilWriter *out);
+void coilSvgEnd(CoilWriter *out, const CoilBounds *bounds);
+void coilDxfBegin(CoilWriter *out);
+void coilDxfFormat(void *context, const CoilParams *params, const CoilUnit *unit, CoilWriter *out);
+void coilDxfEnd(CoilWriter *out);
+
+unsigned long long coilTagHash(const char *tag);
+char *coilUuid(char *out, unsigned long long tag, int coil, int layer, int kind, long index);
+void coilWriterFlush(CoilWriter *writer);
+void coilWriterPrintf(CoilWriter *writer, const char *format, ...);
+void coilWriterAppend(CoilWriter *writer, const CoilWriter *text);
+double coilNow(void);
+
+unsigned long long coilCacheKey(const CoilParams *params);
+int coilCacheGenerate(const char *dir, const CoilParams *params, const CoilSink *sink, CoilBuffers *buffers, CoilStats *stats);
+int coilCacheStats(const char *dir, const CoilParams *params, CoilStats *stats);
+
+int coilAnalyze(const CoilItem *items, size_t count, int layers, double copper, double board, int threads, CoilAnalysis *analysis);
+void coilAnalysisFree(CoilAnalysis *analysis);
+int coilClearance(const CoilItem *items, size_t count, int layers, double clearance, int max, CoilClearance *check);
+void coilClearanceFree(CoilClearance *check);
+void coilEstimate(const CoilParams *params, double copper, double board, CoilEstimate *estimate);
+int coilField(const CoilItem *items, size_t count, int layers, double board, const double *currents, int coils, const CoilGrid *grid, int threads, CoilField *field);
+void coilFieldFree(CoilField *field);
+void coilFieldFormat(CoilWriter *out, const CoilGrid *grid, const CoilField *field);
+/* --- End of FUNCTIONS --- */
+
+#endif